@@ -10,8 +10,11 @@ def configure(env):
 def get_doc_classes():
     return [
         "MeshMerger",
+        "DelaunayTetrahedralization",
         "MeshUtils",
         "FastQuadraticMeshSimplifier",
+        "IncrementalUVAtlas",
+        "UVUnwrapProgress",
     ]
 
 def get_doc_path():
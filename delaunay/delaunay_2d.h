@@ -0,0 +1,917 @@
+/*************************************************************************/
+/*  delaunay_2d.h                                                        */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+#ifndef DELAUNAY_2D_H
+#define DELAUNAY_2D_H
+
+#include "core/version.h"
+
+#if VERSION_MAJOR > 3
+#include "core/math/rect2.h"
+#include "core/math/vector2.h"
+#include "core/templates/hash_map.h"
+#include "core/templates/local_vector.h"
+#include "core/templates/sort_array.h"
+#include "core/templates/vector.h"
+#else
+#include "core/hash_map.h"
+#include "core/local_vector.h"
+#include "core/math/rect2.h"
+#include "core/math/vector2.h"
+#include "core/sort_array.h"
+#include "core/vector.h"
+#endif
+
+#include "predicates.h"
+
+// Same approach as Delaunay3D (Bowyer-Watson with filtered predicates, BRIO / Hilbert insertion order,
+// walking point location, spatial hash deduplication), with constraint edges inserted afterwards
+// by edge flips (Sloan: "A fast algorithm for generating constrained Delaunay triangulations").
+class Delaunay2D {
+	enum {
+		SUPER_VERTEX_COUNT = 3,
+		//Points are inserted in rounds of doubling size (BRIO), the first round has at most this many points
+		BRIO_FIRST_ROUND_SIZE = 64,
+		//Bits / axis of the Hilbert curve the points are sorted along in each round
+		HILBERT_BITS = 16,
+	};
+
+	struct Triangle {
+		//Always counterclockwise, so DelaunayPredicates::orient2d() is positive for them
+		uint32_t points[3];
+		//neighbors[i] is the triangle on the other side of the edge opposite to points[i], UINT32_MAX on the outer edges
+		uint32_t neighbors[3];
+		//The cavity_stamp of the last insertion this triangle was tested in
+		uint32_t visited;
+		//Bit i is set if the edge opposite to points[i] is a constraint
+		uint8_t constrained;
+		bool in_cavity;
+		bool alive;
+
+		_FORCE_INLINE_ Triangle() {
+			for (uint32_t i = 0; i < 3; i++) {
+				points[i] = 0;
+				neighbors[i] = UINT32_MAX;
+			}
+
+			visited = 0;
+			constrained = 0;
+			in_cavity = false;
+			alive = false;
+		}
+	};
+
+	struct CavityEdge {
+		uint32_t triangle;
+		uint32_t edge;
+	};
+
+	struct HilbertPoint {
+		uint64_t key;
+		uint32_t index;
+
+		_FORCE_INLINE_ bool operator<(const HilbertPoint &p_other) const {
+			return key < p_other.key;
+		}
+	};
+
+	struct Edge {
+		uint32_t a;
+		uint32_t b;
+
+		_FORCE_INLINE_ Edge() {}
+		_FORCE_INLINE_ Edge(uint32_t p_a, uint32_t p_b) {
+			a = p_a;
+			b = p_b;
+		}
+	};
+
+	_FORCE_INLINE_ static uint32_t random_next(uint64_t &r_state) {
+		r_state ^= r_state << 13;
+		r_state ^= r_state >> 7;
+		r_state ^= r_state << 17;
+		return static_cast<uint32_t>(r_state >> 32);
+	}
+
+	// Position along a 2D Hilbert curve. Expects normalized points.
+	static uint64_t hilbert_key(const Vector2 &p_point) {
+		const uint32_t side = 1 << HILBERT_BITS;
+		const real_t max_coord = static_cast<real_t>(side - 1);
+
+		uint32_t x = static_cast<uint32_t>(CLAMP(p_point.x, 0, 1) * max_coord);
+		uint32_t y = static_cast<uint32_t>(CLAMP(p_point.y, 0, 1) * max_coord);
+
+		uint64_t key = 0;
+		for (uint32_t s = side >> 1; s > 0; s >>= 1) {
+			uint32_t rx = (x & s) ? 1 : 0;
+			uint32_t ry = (y & s) ? 1 : 0;
+			key += static_cast<uint64_t>(s) * s * ((3 * rx) ^ ry);
+
+			//Rotate the quadrant, so the curve continues in the same orientation
+			if (ry == 0) {
+				if (rx == 1) {
+					x = side - 1 - x;
+					y = side - 1 - y;
+				}
+
+				SWAP(x, y);
+			}
+		}
+
+		return key;
+	}
+
+	// Biased randomized insertion order, see Delaunay3D::insertion_order_compute().
+	static void insertion_order_compute(const Vector2 *p_points, const LocalVector<uint32_t> &p_point_remap, LocalVector<uint32_t> &r_order) {
+		LocalVector<HilbertPoint> order;
+		order.reserve(p_point_remap.size());
+
+		for (uint32_t i = 0; i < p_point_remap.size(); i++) {
+			//Duplicates are not inserted
+			if (p_point_remap[i] != i) {
+				continue;
+			}
+
+			HilbertPoint hp;
+			hp.key = hilbert_key(p_points[i]);
+			hp.index = i;
+			order.push_back(hp);
+		}
+
+		//Fixed seed, so the output is deterministic
+		uint64_t random_state = 0x9E3779B97F4A7C15ULL;
+
+		for (uint32_t i = order.size(); i > 1; i--) {
+			uint32_t j = random_next(random_state) % i;
+			SWAP(order[i - 1], order[j]);
+		}
+
+		SortArray<HilbertPoint> sorter;
+
+		uint32_t round_end = order.size();
+		while (round_end > 0) {
+			uint32_t round_start = round_end > BRIO_FIRST_ROUND_SIZE ? round_end / 2 : 0;
+			sorter.sort(order.ptr() + round_start, round_end - round_start);
+			round_end = round_start;
+		}
+
+		r_order.resize(order.size());
+		for (uint32_t i = 0; i < order.size(); i++) {
+			r_order[i] = order[i].index;
+		}
+	}
+
+	_FORCE_INLINE_ static uint64_t duplicate_cell_key(const int p_x, const int p_y) {
+		//Offset by one, so the neighbours of the border cells have valid keys too
+		return static_cast<uint64_t>(p_x + 1) | (static_cast<uint64_t>(p_y + 1) << 32);
+	}
+
+	// Same as Delaunay3D::points_deduplicate(), with the 9 neighbouring cells.
+	static void points_deduplicate(const Vector2 *p_points, const uint32_t p_point_count, LocalVector<uint32_t> &r_remap) {
+		const int max_cell = static_cast<int>(1.0 / CMP_EPSILON) + 1;
+
+		r_remap.resize(p_point_count);
+
+		HashMap<uint64_t, uint32_t> cells;
+
+		for (uint32_t i = p_point_count; i-- > 0;) {
+			const Vector2 &point = p_points[i];
+
+			int x = CLAMP(static_cast<int>(point.x / CMP_EPSILON), 0, max_cell);
+			int y = CLAMP(static_cast<int>(point.y / CMP_EPSILON), 0, max_cell);
+
+			r_remap[i] = i;
+
+			for (int j = 0; j < 9 && r_remap[i] == i; j++) {
+				const uint32_t *representative = cells.getptr(duplicate_cell_key(x + j % 3 - 1, y + j / 3 - 1));
+
+				if (representative && point.is_equal_approx(p_points[*representative])) {
+					r_remap[i] = *representative;
+				}
+			}
+
+			if (r_remap[i] == i) {
+				cells[duplicate_cell_key(x, y)] = i;
+			}
+		}
+	}
+
+	// Normalized points, the first SUPER_VERTEX_COUNT are the vertices of the super triangle
+	LocalVector<Vector2> points;
+	//One triangle that has the point as a vertex, UINT32_MAX for points that are not in the triangulation
+	LocalVector<uint32_t> vertex_triangles;
+	//Triangles are pooled, removed ones are reused through the free list
+	LocalVector<Triangle> triangles;
+	LocalVector<uint32_t> free_triangles;
+	uint32_t last_triangle;
+	uint32_t cavity_stamp;
+	uint64_t random_state;
+
+	//Only used while inserting, kept to avoid reallocating them for every point
+	LocalVector<uint32_t> cavity;
+	LocalVector<CavityEdge> cavity_edges;
+	//The new triangle whose edge from the new point to the vertex is not connected yet, indexed by the vertex
+	LocalVector<CavityEdge> open_edges;
+
+	_FORCE_INLINE_ bool triangle_contains(const Triangle &p_triangle, uint32_t p_vertex) const {
+		return DelaunayPredicates::incircle(points[p_triangle.points[0]], points[p_triangle.points[1]], points[p_triangle.points[2]], points[p_vertex]) > 0;
+	}
+
+	_FORCE_INLINE_ bool triangle_is_super(const Triangle &p_triangle) const {
+		for (uint32_t i = 0; i < 3; i++) {
+			if (p_triangle.points[i] < SUPER_VERTEX_COUNT) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	_FORCE_INLINE_ static uint32_t triangle_find_neighbor(const Triangle &p_triangle, const uint32_t p_neighbor) {
+		for (uint32_t i = 0; i < 3; i++) {
+			if (p_triangle.neighbors[i] == p_neighbor) {
+				return i;
+			}
+		}
+
+		return UINT32_MAX;
+	}
+
+	uint32_t triangle_allocate() {
+		if (free_triangles.size() > 0) {
+			uint32_t index = free_triangles[free_triangles.size() - 1];
+			free_triangles.resize(free_triangles.size() - 1);
+			triangles[index] = Triangle();
+			return index;
+		}
+
+		triangles.push_back(Triangle());
+		return triangles.size() - 1;
+	}
+
+	void triangle_free(const uint32_t p_index) {
+		triangles[p_index].alive = false;
+		free_triangles.push_back(p_index);
+	}
+
+	// Visibility walk: step through any edge the point is on the other side of, until the triangle
+	// containing the point is reached. The edge checked first is random, so the walk can't cycle.
+	uint32_t triangle_locate(const uint32_t p_start, const Vector2 &p_point) {
+		uint32_t current = p_start;
+
+		while (true) {
+			const Triangle &triangle = triangles[current];
+			uint32_t first_edge = random_next(random_state) % 3;
+			uint32_t next = UINT32_MAX;
+
+			for (uint32_t i = 0; i < 3; i++) {
+				uint32_t edge = (first_edge + i) % 3;
+
+				if (triangle.neighbors[edge] == UINT32_MAX) {
+					continue;
+				}
+
+				const Vector2 *v[3] = {
+					&points[triangle.points[0]],
+					&points[triangle.points[1]],
+					&points[triangle.points[2]],
+				};
+				v[edge] = &p_point;
+
+				if (DelaunayPredicates::orient2d(*v[0], *v[1], *v[2]) < 0) {
+					next = triangle.neighbors[edge];
+					break;
+				}
+			}
+
+			if (next == UINT32_MAX) {
+				return current;
+			}
+
+			current = next;
+		}
+	}
+
+	// Bowyer-Watson step, p_start has to be the triangle that contains the point, and it can't be a duplicate
+	void point_insert(const uint32_t p_vertex, const uint32_t p_start) {
+		cavity_stamp++;
+
+		//The triangle containing the point is always in the cavity, the rest of it is connected to it
+		triangles[p_start].visited = cavity_stamp;
+		triangles[p_start].in_cavity = true;
+		cavity.push_back(p_start);
+
+		for (uint32_t j = 0; j < cavity.size(); j++) {
+			uint32_t index = cavity[j];
+
+			for (uint32_t k = 0; k < 3; k++) {
+				uint32_t neighbor_index = triangles[index].neighbors[k];
+
+				if (neighbor_index != UINT32_MAX) {
+					Triangle &neighbor = triangles[neighbor_index];
+
+					if (neighbor.visited != cavity_stamp) {
+						neighbor.visited = cavity_stamp;
+						neighbor.in_cavity = triangle_contains(neighbor, p_vertex);
+
+						if (neighbor.in_cavity) {
+							cavity.push_back(neighbor_index);
+						}
+					}
+
+					if (neighbor.in_cavity) {
+						continue;
+					}
+				}
+
+				CavityEdge edge;
+				edge.triangle = index;
+				edge.edge = k;
+				cavity_edges.push_back(edge);
+			}
+		}
+
+		//Connect every boundary edge of the cavity to the new point. The point is on the inner side of
+		//all of them, so replacing the vertex opposite to the edge keeps the orientation
+		for (uint32_t j = 0; j < cavity_edges.size(); j++) {
+			const CavityEdge &edge = cavity_edges[j];
+
+			uint32_t new_index = triangle_allocate();
+			const Triangle &old_triangle = triangles[edge.triangle];
+			Triangle &new_triangle = triangles[new_index];
+
+			for (uint32_t k = 0; k < 3; k++) {
+				new_triangle.points[k] = old_triangle.points[k];
+			}
+			new_triangle.points[edge.edge] = p_vertex;
+			new_triangle.alive = true;
+
+			uint32_t outside_index = old_triangle.neighbors[edge.edge];
+			new_triangle.neighbors[edge.edge] = outside_index;
+
+			if (outside_index != UINT32_MAX) {
+				Triangle &outside = triangles[outside_index];
+				outside.neighbors[triangle_find_neighbor(outside, edge.triangle)] = new_index;
+			}
+
+			//The other two edges go from the new point to a vertex of the cavity boundary,
+			//every such edge is shared by two new triangles
+			for (uint32_t k = 1; k < 3; k++) {
+				uint32_t local_edge = (edge.edge + k) % 3;
+				uint32_t vertex = new_triangle.points[(edge.edge + 3 - k) % 3];
+
+				CavityEdge &other = open_edges[vertex];
+
+				if (other.triangle != UINT32_MAX) {
+					new_triangle.neighbors[local_edge] = other.triangle;
+					triangles[other.triangle].neighbors[other.edge] = new_index;
+					other.triangle = UINT32_MAX;
+				} else {
+					other.triangle = new_index;
+					other.edge = local_edge;
+				}
+			}
+
+			for (uint32_t k = 0; k < 3; k++) {
+				vertex_triangles[new_triangle.points[k]] = new_index;
+			}
+
+			last_triangle = new_index;
+		}
+
+		for (uint32_t j = 0; j < cavity.size(); j++) {
+			triangle_free(cavity[j]);
+		}
+
+		cavity.clear();
+		cavity_edges.clear();
+	}
+
+	// Inserts the points with point_remap[i] == i (the offset of the super triangle is not included in the remap).
+	// The super triangle is placed around them.
+	void triangulate_points(const LocalVector<uint32_t> &p_point_remap) {
+		triangles.clear();
+		free_triangles.clear();
+		vertex_triangles.resize(points.size());
+		open_edges.resize(points.size());
+
+		for (uint32_t i = 0; i < points.size(); i++) {
+			vertex_triangles[i] = UINT32_MAX;
+			open_edges[i].triangle = UINT32_MAX;
+		}
+
+		{
+			Rect2 rect;
+			bool first = true;
+			for (uint32_t i = 0; i < p_point_remap.size(); i++) {
+				if (p_point_remap[i] != i) {
+					continue;
+				}
+
+				if (first) {
+					rect.position = points[SUPER_VERTEX_COUNT + i];
+					first = false;
+				} else {
+					rect.expand_to(points[SUPER_VERTEX_COUNT + i]);
+				}
+			}
+
+			real_t delta_max = 20.0 * MAX(MAX(rect.size.x, rect.size.y), (real_t)1.0);
+			Vector2 center = rect.position + rect.size * 0.5;
+
+			// any triangle that contains everything is good
+			points[0] = center + Vector2(-2, -1) * delta_max;
+			points[1] = center + Vector2(2, -1) * delta_max;
+			points[2] = center + Vector2(0, 2) * delta_max;
+		}
+
+		LocalVector<uint32_t> insertion_order;
+		insertion_order_compute(points.ptr() + SUPER_VERTEX_COUNT, p_point_remap, insertion_order);
+
+		triangles.reserve(insertion_order.size() * 2 + 1);
+
+		{
+			//create root triangle
+			last_triangle = triangle_allocate();
+			Triangle &root = triangles[last_triangle];
+			root.points[0] = 0;
+			root.points[1] = 1;
+			root.points[2] = 2;
+			root.alive = true;
+
+			for (uint32_t i = 0; i < SUPER_VERTEX_COUNT; i++) {
+				vertex_triangles[i] = last_triangle;
+			}
+		}
+
+		for (uint32_t i = 0; i < insertion_order.size(); i++) {
+			uint32_t vertex = SUPER_VERTEX_COUNT + insertion_order[i];
+			point_insert(vertex, triangle_locate(last_triangle, points[vertex]));
+		}
+	}
+
+	// Finds the triangle that has the edge, and the local index of the vertex opposite to it.
+	bool edge_find(uint32_t p_a, uint32_t p_b, uint32_t &r_triangle, uint32_t &r_edge) const {
+		//Rotate around the endpoint that is not a super vertex, it can't be on the outer boundary
+		if (p_a < p_b) {
+			SWAP(p_a, p_b);
+		}
+
+		uint32_t start = vertex_triangles[p_a];
+		uint32_t current = start;
+
+		do {
+			const Triangle &triangle = triangles[current];
+
+			uint32_t i = 0;
+			while (triangle.points[i] != p_a) {
+				i++;
+			}
+
+			if (triangle.points[(i + 1) % 3] == p_b) {
+				r_triangle = current;
+				r_edge = (i + 2) % 3;
+				return true;
+			}
+
+			if (triangle.points[(i + 2) % 3] == p_b) {
+				r_triangle = current;
+				r_edge = (i + 1) % 3;
+				return true;
+			}
+
+			current = triangle.neighbors[(i + 1) % 3];
+		} while (current != start && current != UINT32_MAX);
+
+		return false;
+	}
+
+	// Replaces the edge opposite to points[p_edge] with the other diagonal of the quad of the two triangles.
+	// The triangles become p0, p1, p3 and p0, p3, p2, the new edge is opposite to points[1] of the first one.
+	void triangle_flip(const uint32_t p_triangle, const uint32_t p_edge) {
+		Triangle &triangle = triangles[p_triangle];
+		uint32_t neighbor_index = triangle.neighbors[p_edge];
+		Triangle &neighbor = triangles[neighbor_index];
+		uint32_t neighbor_edge = triangle_find_neighbor(neighbor, p_triangle);
+
+		//The quad is p0, p1, p3, p2 counterclockwise, p1 - p2 is replaced by p0 - p3
+		uint32_t i1 = (p_edge + 1) % 3;
+		uint32_t i2 = (p_edge + 2) % 3;
+		uint32_t j1 = (neighbor_edge + 1) % 3;
+		uint32_t j2 = (neighbor_edge + 2) % 3;
+
+		uint32_t p0 = triangle.points[p_edge];
+		uint32_t p1 = triangle.points[i1];
+		uint32_t p2 = triangle.points[i2];
+		uint32_t p3 = neighbor.points[neighbor_edge];
+
+		uint32_t outer[4] = { triangle.neighbors[i2], neighbor.neighbors[j1], neighbor.neighbors[j2], triangle.neighbors[i1] };
+		bool outer_constrained[4] = {
+			(triangle.constrained & (1 << i2)) != 0,
+			(neighbor.constrained & (1 << j1)) != 0,
+			(neighbor.constrained & (1 << j2)) != 0,
+			(triangle.constrained & (1 << i1)) != 0,
+		};
+
+		triangle.points[0] = p0;
+		triangle.points[1] = p1;
+		triangle.points[2] = p3;
+		triangle.neighbors[0] = outer[1];
+		triangle.neighbors[1] = neighbor_index;
+		triangle.neighbors[2] = outer[0];
+		triangle.constrained = (outer_constrained[1] ? 1 : 0) | (outer_constrained[0] ? 4 : 0);
+
+		neighbor.points[0] = p0;
+		neighbor.points[1] = p3;
+		neighbor.points[2] = p2;
+		neighbor.neighbors[0] = outer[2];
+		neighbor.neighbors[1] = outer[3];
+		neighbor.neighbors[2] = p_triangle;
+		neighbor.constrained = (outer_constrained[2] ? 1 : 0) | (outer_constrained[3] ? 2 : 0);
+
+		if (outer[1] != UINT32_MAX) {
+			Triangle &outside = triangles[outer[1]];
+			outside.neighbors[triangle_find_neighbor(outside, neighbor_index)] = p_triangle;
+		}
+
+		if (outer[3] != UINT32_MAX) {
+			Triangle &outside = triangles[outer[3]];
+			outside.neighbors[triangle_find_neighbor(outside, p_triangle)] = neighbor_index;
+		}
+
+		vertex_triangles[p0] = p_triangle;
+		vertex_triangles[p1] = p_triangle;
+		vertex_triangles[p2] = neighbor_index;
+		vertex_triangles[p3] = neighbor_index;
+	}
+
+	void edge_constrain(const uint32_t p_a, const uint32_t p_b) {
+		uint32_t triangle_index;
+		uint32_t edge;
+		if (!edge_find(p_a, p_b, triangle_index, edge)) {
+			return;
+		}
+
+		Triangle &triangle = triangles[triangle_index];
+		triangle.constrained |= 1 << edge;
+
+		Triangle &neighbor = triangles[triangle.neighbors[edge]];
+		neighbor.constrained |= 1 << triangle_find_neighbor(neighbor, triangle_index);
+	}
+
+	// Collects the edges the segment from p_a towards p_b crosses, until it reaches p_b or a vertex
+	// that is exactly on the segment. Returns that vertex, or UINT32_MAX if it crosses a constraint.
+	uint32_t constraint_walk(const uint32_t p_a, const uint32_t p_b, LocalVector<Edge> &r_crossed) const {
+		const Vector2 &a = points[p_a];
+		const Vector2 &b = points[p_b];
+
+		//Find the triangle around p_a the segment leaves through
+		uint32_t start = vertex_triangles[p_a];
+		uint32_t current = start;
+		uint32_t edge = UINT32_MAX;
+		uint32_t right = 0;
+		uint32_t left = 0;
+
+		do {
+			const Triangle &triangle = triangles[current];
+
+			uint32_t i = 0;
+			while (triangle.points[i] != p_a) {
+				i++;
+			}
+
+			right = triangle.points[(i + 1) % 3];
+			left = triangle.points[(i + 2) % 3];
+
+			if (right == p_b || left == p_b) {
+				return p_b;
+			}
+
+			double orient_right = DelaunayPredicates::orient2d(a, b, points[right]);
+			double orient_left = DelaunayPredicates::orient2d(a, b, points[left]);
+
+			if (orient_right == 0 && segment_direction_dot(a, b, points[right]) > 0) {
+				return right;
+			}
+
+			if (orient_left == 0 && segment_direction_dot(a, b, points[left]) > 0) {
+				return left;
+			}
+
+			if (orient_right < 0 && orient_left > 0) {
+				edge = i;
+				break;
+			}
+
+			current = triangle.neighbors[(i + 1) % 3];
+		} while (current != start && current != UINT32_MAX);
+
+		ERR_FAIL_COND_V(edge == UINT32_MAX, UINT32_MAX);
+
+		while (true) {
+			const Triangle &triangle = triangles[current];
+
+			if (triangle.constrained & (1 << edge)) {
+				return UINT32_MAX;
+			}
+
+			r_crossed.push_back(Edge(right, left));
+
+			uint32_t next = triangle.neighbors[edge];
+			const Triangle &next_triangle = triangles[next];
+			uint32_t opposite = next_triangle.points[triangle_find_neighbor(next_triangle, current)];
+
+			if (opposite == p_b) {
+				return p_b;
+			}
+
+			double orient = DelaunayPredicates::orient2d(a, b, points[opposite]);
+
+			if (orient == 0) {
+				return opposite;
+			}
+
+			//Leave through the edge between the new vertex and the one on the other side of the segment
+			uint32_t replaced = orient < 0 ? right : left;
+
+			edge = 0;
+			while (next_triangle.points[edge] != replaced) {
+				edge++;
+			}
+
+			if (orient < 0) {
+				right = opposite;
+			} else {
+				left = opposite;
+			}
+
+			current = next;
+		}
+	}
+
+	_FORCE_INLINE_ static double segment_direction_dot(const Vector2 &p_a, const Vector2 &p_b, const Vector2 &p_point) {
+		return (double(p_point.x) - double(p_a.x)) * (double(p_b.x) - double(p_a.x)) + (double(p_point.y) - double(p_a.y)) * (double(p_b.y) - double(p_a.y));
+	}
+
+	_FORCE_INLINE_ bool segments_cross(const uint32_t p_a, const uint32_t p_b, const uint32_t p_c, const uint32_t p_d) const {
+		const Vector2 &a = points[p_a];
+		const Vector2 &b = points[p_b];
+		const Vector2 &c = points[p_c];
+		const Vector2 &d = points[p_d];
+
+		return DelaunayPredicates::orient2d(a, b, c) * DelaunayPredicates::orient2d(a, b, d) < 0 &&
+				DelaunayPredicates::orient2d(c, d, a) * DelaunayPredicates::orient2d(c, d, b) < 0;
+	}
+
+	// Inserts the edge p_a - p_b, the triangulation stays constrained Delaunay.
+	// Returns false if it crosses an other constraint. The parts up to the last vertex on the segment
+	// before the crossing are kept, the rest is dropped, it is not split at the intersection.
+	bool constraint_insert(uint32_t p_a, const uint32_t p_b) {
+		LocalVector<Edge> crossed;
+		LocalVector<Edge> new_edges;
+
+		while (p_a != p_b) {
+			crossed.clear();
+			uint32_t end = constraint_walk(p_a, p_b, crossed);
+
+			if (end == UINT32_MAX) {
+				return false;
+			}
+
+			//Flip the crossed edges away. The ones that are not in a convex quad are retried later,
+			//there is always one that can be flipped
+			new_edges.clear();
+
+			for (uint32_t i = 0; i < crossed.size(); i++) {
+				Edge crossed_edge = crossed[i];
+
+				uint32_t triangle_index;
+				uint32_t edge;
+				edge_find(crossed_edge.a, crossed_edge.b, triangle_index, edge);
+
+				const Triangle &triangle = triangles[triangle_index];
+				const Triangle &neighbor = triangles[triangle.neighbors[edge]];
+
+				uint32_t p0 = triangle.points[edge];
+				uint32_t p1 = triangle.points[(edge + 1) % 3];
+				uint32_t p2 = triangle.points[(edge + 2) % 3];
+				uint32_t p3 = neighbor.points[triangle_find_neighbor(neighbor, triangle_index)];
+
+				if (DelaunayPredicates::orient2d(points[p0], points[p1], points[p3]) <= 0 || DelaunayPredicates::orient2d(points[p0], points[p3], points[p2]) <= 0) {
+					crossed.push_back(crossed_edge);
+					continue;
+				}
+
+				triangle_flip(triangle_index, edge);
+
+				if (segments_cross(p_a, end, p0, p3)) {
+					crossed.push_back(Edge(p0, p3));
+				} else {
+					new_edges.push_back(Edge(p0, p3));
+				}
+			}
+
+			edge_constrain(p_a, end);
+
+			//Restore the Delaunay property around the new edges
+			bool flipped = true;
+
+			while (flipped) {
+				flipped = false;
+
+				for (uint32_t i = 0; i < new_edges.size(); i++) {
+					uint32_t triangle_index;
+					uint32_t edge;
+					edge_find(new_edges[i].a, new_edges[i].b, triangle_index, edge);
+
+					const Triangle &triangle = triangles[triangle_index];
+
+					if (triangle.constrained & (1 << edge)) {
+						continue;
+					}
+
+					const Triangle &neighbor = triangles[triangle.neighbors[edge]];
+					uint32_t p0 = triangle.points[edge];
+					uint32_t p3 = neighbor.points[triangle_find_neighbor(neighbor, triangle_index)];
+
+					if (DelaunayPredicates::incircle(points[triangle.points[0]], points[triangle.points[1]], points[triangle.points[2]], points[p3]) > 0) {
+						triangle_flip(triangle_index, edge);
+						new_edges[i] = Edge(p0, p3);
+						flipped = true;
+					}
+				}
+			}
+
+			p_a = end;
+		}
+
+		return true;
+	}
+
+public:
+	struct OutputTriangle {
+		//Counterclockwise, so DelaunayPredicates::orient2d() is positive for them
+		uint32_t points[3];
+		//neighbors[i] is the index of the output triangle on the other side of the edge opposite to points[i],
+		//UINT32_MAX if there is none
+		uint32_t neighbors[3];
+	};
+
+	// If r_point_remap is set, it will contain the index of the point that was used in the output
+	// for every input point. Duplicates point to their representative, every other point to itself.
+	// p_constraint_edges are pairs of point indices, the edges between them will be in the output.
+	// Constraints that cross an earlier one are only inserted up to the last point on them before the
+	// crossing, usually not at all. The intersection is not added as a point.
+	void build(const Vector<Vector2> &p_points, const Vector<int> &p_constraint_edges = Vector<int>(), Vector<uint32_t> *r_point_remap = nullptr) {
+		clear();
+
+		uint32_t point_count = p_points.size();
+		points.resize(point_count + SUPER_VERTEX_COUNT);
+
+		{
+			const Vector2 *src_points = p_points.ptr();
+			Rect2 rect;
+			for (uint32_t i = 0; i < point_count; i++) {
+				Vector2 point = src_points[i];
+				if (i == 0) {
+					rect.position = point;
+				} else {
+					rect.expand_to(point);
+				}
+			}
+
+			//Scaled the same on both axes, non uniform scaling would change which triangulation is Delaunay
+			real_t scale = MAX(rect.size.x, rect.size.y);
+			if (scale == 0) {
+				scale = 1;
+			}
+
+			for (uint32_t i = 0; i < point_count; i++) {
+				points[SUPER_VERTEX_COUNT + i] = (src_points[i] - rect.position) / scale;
+			}
+		}
+
+		LocalVector<uint32_t> point_remap;
+		points_deduplicate(points.ptr() + SUPER_VERTEX_COUNT, point_count, point_remap);
+
+		if (r_point_remap) {
+			r_point_remap->resize(point_count);
+			uint32_t *remapw = r_point_remap->ptrw();
+
+			for (uint32_t i = 0; i < point_count; i++) {
+				remapw[i] = point_remap[i];
+			}
+		}
+
+		triangulate_points(point_remap);
+
+		const int *constraint_edges = p_constraint_edges.ptr();
+
+		for (int i = 0; i + 1 < p_constraint_edges.size(); i += 2) {
+			int a = constraint_edges[i];
+			int b = constraint_edges[i + 1];
+
+			ERR_CONTINUE(a < 0 || a >= static_cast<int>(point_count) || b < 0 || b >= static_cast<int>(point_count));
+
+			uint32_t vertex_a = SUPER_VERTEX_COUNT + point_remap[a];
+			uint32_t vertex_b = SUPER_VERTEX_COUNT + point_remap[b];
+
+			if (vertex_a == vertex_b) {
+				continue;
+			}
+
+			ERR_CONTINUE_MSG(!constraint_insert(vertex_a, vertex_b), "Delaunay2D: Constraint edges can't cross each other.");
+		}
+	}
+
+	// The triangles that don't touch the super triangle
+	Vector<OutputTriangle> get_output() const {
+		LocalVector<uint32_t> output_indices;
+		output_indices.resize(triangles.size());
+
+		uint32_t output_count = 0;
+
+		for (uint32_t i = 0; i < triangles.size(); i++) {
+			const Triangle &triangle = triangles[i];
+
+			if (!triangle.alive || triangle_is_super(triangle)) {
+				output_indices[i] = UINT32_MAX;
+				continue;
+			}
+
+			output_indices[i] = output_count++;
+		}
+
+		Vector<OutputTriangle> ret_triangles;
+		ret_triangles.resize(output_count);
+		OutputTriangle *ret_trianglesw = ret_triangles.ptrw();
+
+		for (uint32_t i = 0; i < triangles.size(); i++) {
+			if (output_indices[i] == UINT32_MAX) {
+				continue;
+			}
+
+			const Triangle &triangle = triangles[i];
+			OutputTriangle &output = ret_trianglesw[output_indices[i]];
+
+			for (uint32_t j = 0; j < 3; j++) {
+				output.points[j] = triangle.points[j] - SUPER_VERTEX_COUNT;
+
+				uint32_t neighbor = triangle.neighbors[j];
+				output.neighbors[j] = neighbor != UINT32_MAX ? output_indices[neighbor] : UINT32_MAX;
+			}
+		}
+
+		return ret_triangles;
+	}
+
+	void clear() {
+		points.clear();
+		vertex_triangles.clear();
+		triangles.clear();
+		free_triangles.clear();
+		open_edges.clear();
+		last_triangle = 0;
+		cavity_stamp = 0;
+		random_state = 0x2545F4914F6CDD1DULL;
+	}
+
+	static Vector<OutputTriangle> triangulate(const Vector<Vector2> &p_points, const Vector<int> &p_constraint_edges = Vector<int>(), Vector<uint32_t> *r_point_remap = nullptr) {
+		Delaunay2D delaunay;
+		delaunay.build(p_points, p_constraint_edges, r_point_remap);
+		return delaunay.get_output();
+	}
+
+	Delaunay2D() {
+		clear();
+	}
+};
+
+#endif // DELAUNAY_2D_H
@@ -31,239 +31,1342 @@
 #ifndef DELAUNAY_3D_H
 #define DELAUNAY_3D_H
 
+#include "core/version.h"
+
+#if VERSION_MAJOR > 3
+#include "core/math/aabb.h"
+#include "core/math/plane.h"
+#include "core/math/vector3.h"
+#include "core/object/worker_thread_pool.h"
+#include "core/os/os.h"
+#include "core/templates/hash_map.h"
+#include "core/templates/local_vector.h"
+#include "core/templates/sort_array.h"
+#include "core/templates/vector.h"
+#else
+#include "core/hash_map.h"
+#include "core/local_vector.h"
 #include "core/math/aabb.h"
-#include "core/math/camera_matrix.h"
+#include "core/math/plane.h"
 #include "core/math/vector3.h"
+#include "core/os/os.h"
+#include "core/os/thread_work_pool.h"
+#include "core/sort_array.h"
+#include "core/vector.h"
+#endif
+
+#include "predicates.h"
+
+class Delaunay3D {
+	enum {
+		SUPER_VERTEX_COUNT = 4,
+		//Points are inserted in rounds of doubling size (BRIO), the first round has at most this many points
+		BRIO_FIRST_ROUND_SIZE = 64,
+		//Bits / axis of the Hilbert curve the points are sorted along in each round
+		HILBERT_BITS = 16,
+		//The parallel build doesn't split the points further than this, smaller partitions are mostly boundary
+		PARALLEL_MIN_PARTITION_SIZE = 16384,
+	};
+
+	struct Simplex {
+		//Always ordered so DelaunayPredicates::orient3d() is positive for them
+		uint32_t points[4];
+		//neighbors[i] is the simplex on the other side of the face opposite to points[i], UINT32_MAX on the outer faces
+		uint32_t neighbors[4];
+		//The cavity_stamp of the last insertion this simplex was tested in
+		uint32_t visited;
+		bool in_cavity;
+		bool alive;
+
+		_FORCE_INLINE_ Simplex() {
+			for (uint32_t i = 0; i < 4; i++) {
+				points[i] = 0;
+				neighbors[i] = UINT32_MAX;
+			}
+
+			visited = 0;
+			in_cavity = false;
+			alive = false;
+		}
+	};
+
+	struct CavityFace {
+		uint32_t simplex;
+		uint32_t face;
+	};
+
+	struct HilbertPoint {
+		uint64_t key;
+		uint32_t index;
+
+		_FORCE_INLINE_ bool operator<(const HilbertPoint &p_other) const {
+			return key < p_other.key;
+		}
+	};
+
+	struct Face {
+		uint32_t points[3];
+
+		_FORCE_INLINE_ bool operator==(const Face &p_face) const {
+			return points[0] == p_face.points[0] && points[1] == p_face.points[1] && points[2] == p_face.points[2];
+		}
+
+		_FORCE_INLINE_ Face() {}
+		_FORCE_INLINE_ Face(uint32_t p_a, uint32_t p_b, uint32_t p_c) {
+			if (p_a > p_b) {
+				SWAP(p_a, p_b);
+			}
+			if (p_b > p_c) {
+				SWAP(p_b, p_c);
+			}
+			if (p_a > p_b) {
+				SWAP(p_a, p_b);
+			}
+
+			points[0] = p_a;
+			points[1] = p_b;
+			points[2] = p_c;
+		}
+	};
+
+	struct FaceHasher {
+		_FORCE_INLINE_ static uint32_t hash(const Face &p_face) {
+			uint32_t h = hash_djb2_one_32(p_face.points[0]);
+			h = hash_djb2_one_32(p_face.points[1], h);
+			return hash_djb2_one_32(p_face.points[2], h);
+		}
+	};
+
+	// A boundary face of the hole left by a removed point
+	struct HoleFace {
+		uint32_t star_simplex;
+		uint32_t outside;
+		uint32_t local_simplex;
+		uint32_t local_face;
+	};
+
+	// A face between a final simplex of a partition and the rest
+	struct BoundaryFace {
+		uint32_t simplex;
+		//The simplex on the other side in the tetrahedralization of the boundary points
+		uint32_t outside;
+		uint32_t outside_face;
+	};
+
+	// A cell of the spatial partition of the parallel build
+	struct Partition {
+		AABB box;
+		//Global indices of the points in the cell
+		LocalVector<uint32_t> vertices;
+		//The simplices whose circumsphere is inside the box, other points can't be in them, so they are final.
+		//Points are global, neighbors are indices in this list, UINT32_MAX on the faces shared with the rest.
+		LocalVector<Simplex> simplices;
+		HashMap<Face, BoundaryFace, FaceHasher> boundary_faces;
+		//The simplices are placed after each other in the merged tetrahedralization, starting from this
+		uint32_t first_simplex;
+	};
+
+	struct BoundaryMatch {
+		BoundaryFace *boundary_face;
+		uint32_t simplex;
+		uint32_t face;
+	};
+
+	struct ParallelBuild {
+		LocalVector<Partition> partitions;
+		//Points of non final simplices, the tetrahedralization of these fills the rest of the space
+		LocalVector<bool> boundary;
+		//The partition of every point, UINT32_MAX for the ones that are not in any
+		LocalVector<uint32_t> point_partitions;
+
+		//Bit k is set if face k of the simplex is a boundary face
+		LocalVector<uint8_t> walls;
+		//The simplices are scanned for boundary faces in chunks, one / partition
+		uint32_t chunk_size;
+		LocalVector<LocalVector<BoundaryMatch>> chunk_matches;
+		LocalVector<bool> chunk_degenerate;
+	};
+
+	struct AxisComparator {
+		const Vector3 *points;
+		int axis;
+
+		_FORCE_INLINE_ bool operator()(const uint32_t p_a, const uint32_t p_b) const {
+			return points[p_a][axis] < points[p_b][axis];
+		}
+	};
+
+	_FORCE_INLINE_ static uint32_t random_next(uint64_t &r_state) {
+		r_state ^= r_state << 13;
+		r_state ^= r_state >> 7;
+		r_state ^= r_state << 17;
+		return static_cast<uint32_t>(r_state >> 32);
+	}
+
+	// Position along a 3D Hilbert curve, using Skilling's transpose algorithm. Expects normalized points.
+	static uint64_t hilbert_key(const Vector3 &p_point) {
+		const real_t max_coord = static_cast<real_t>((1 << HILBERT_BITS) - 1);
+
+		uint32_t x[3];
+		x[0] = static_cast<uint32_t>(CLAMP(p_point.x, 0, 1) * max_coord);
+		x[1] = static_cast<uint32_t>(CLAMP(p_point.y, 0, 1) * max_coord);
+		x[2] = static_cast<uint32_t>(CLAMP(p_point.z, 0, 1) * max_coord);
+
+		for (uint32_t q = 1 << (HILBERT_BITS - 1); q > 1; q >>= 1) {
+			uint32_t p = q - 1;
+
+			for (uint32_t i = 0; i < 3; i++) {
+				if (x[i] & q) {
+					x[0] ^= p;
+				} else {
+					uint32_t t = (x[0] ^ x[i]) & p;
+					x[0] ^= t;
+					x[i] ^= t;
+				}
+			}
+		}
+
+		x[1] ^= x[0];
+		x[2] ^= x[1];
+
+		uint32_t t = 0;
+		for (uint32_t q = 1 << (HILBERT_BITS - 1); q > 1; q >>= 1) {
+			if (x[2] & q) {
+				t ^= q - 1;
+			}
+		}
+
+		uint64_t key = 0;
+		for (int b = HILBERT_BITS - 1; b >= 0; b--) {
+			for (uint32_t i = 0; i < 3; i++) {
+				key = (key << 1) | (((x[i] ^ t) >> b) & 1);
+			}
+		}
+
+		return key;
+	}
+
+	// Biased randomized insertion order: the points are shuffled, then split into rounds where every round
+	// has twice as many points as the previous one, and every round is sorted along a Hilbert curve.
+	// The shuffle keeps the expected cavity sizes small, the sorting keeps consecutive points close to each other,
+	// so the walk from the previous point stays short.
+	static void insertion_order_compute(const Vector3 *p_points, const LocalVector<uint32_t> &p_point_remap, LocalVector<uint32_t> &r_order) {
+		LocalVector<HilbertPoint> order;
+		order.reserve(p_point_remap.size());
+
+		for (uint32_t i = 0; i < p_point_remap.size(); i++) {
+			//Duplicates are not inserted
+			if (p_point_remap[i] != i) {
+				continue;
+			}
+
+			HilbertPoint hp;
+			hp.key = hilbert_key(p_points[i]);
+			hp.index = i;
+			order.push_back(hp);
+		}
+
+		//Fixed seed, so the output is deterministic
+		uint64_t random_state = 0x9E3779B97F4A7C15ULL;
+
+		for (uint32_t i = order.size(); i > 1; i--) {
+			uint32_t j = random_next(random_state) % i;
+			SWAP(order[i - 1], order[j]);
+		}
+
+		SortArray<HilbertPoint> sorter;
+
+		uint32_t round_end = order.size();
+		while (round_end > 0) {
+			uint32_t round_start = round_end > BRIO_FIRST_ROUND_SIZE ? round_end / 2 : 0;
+			sorter.sort(order.ptr() + round_start, round_end - round_start);
+			round_end = round_start;
+		}
+
+		r_order.resize(order.size());
+		for (uint32_t i = 0; i < order.size(); i++) {
+			r_order[i] = order[i].index;
+		}
+	}
+
+	_FORCE_INLINE_ static uint64_t edge_key(uint32_t p_a, uint32_t p_b) {
+		if (p_a > p_b) {
+			SWAP(p_a, p_b);
+		}
+
+		return (static_cast<uint64_t>(p_a) << 32) | p_b;
+	}
+
+	_FORCE_INLINE_ static uint64_t duplicate_cell_key(const int p_x, const int p_y, const int p_z) {
+		//21 bits / axis, offset by one, so the neighbours of the border cells have valid keys too
+		return static_cast<uint64_t>(p_x + 1) | (static_cast<uint64_t>(p_y + 1) << 21) | (static_cast<uint64_t>(p_z + 1) << 42);
+	}
+
+	// Points are in the normalized [0, 1] space here, so is_equal_approx() means closer than CMP_EPSILON
+	// on every axis. With CMP_EPSILON sized cells an equal point can only be in one of the 27 neighbouring
+	// cells, and a cell can only hold one representative.
+	// The last occurrence of a point is kept. Points are only merged into a kept point, so chains of
+	// approximately equal points don't make every point in them disappear.
+	// Skipped points get UINT32_MAX in the remap.
+	static void points_deduplicate(const Vector3 *p_points, const uint32_t p_point_count, LocalVector<uint32_t> &r_remap, const bool *p_skip = nullptr) {
+		const int max_cell = static_cast<int>(1.0 / CMP_EPSILON) + 1;
+
+		r_remap.resize(p_point_count);
+
+		HashMap<uint64_t, uint32_t> cells;
+
+		for (uint32_t i = p_point_count; i-- > 0;) {
+			if (p_skip && p_skip[i]) {
+				r_remap[i] = UINT32_MAX;
+				continue;
+			}
+
+			const Vector3 &point = p_points[i];
+
+			int x = CLAMP(static_cast<int>(point.x / CMP_EPSILON), 0, max_cell);
+			int y = CLAMP(static_cast<int>(point.y / CMP_EPSILON), 0, max_cell);
+			int z = CLAMP(static_cast<int>(point.z / CMP_EPSILON), 0, max_cell);
+
+			r_remap[i] = i;
+
+			for (int j = 0; j < 27 && r_remap[i] == i; j++) {
+				const uint32_t *representative = cells.getptr(duplicate_cell_key(x + j % 3 - 1, y + (j / 3) % 3 - 1, z + j / 9 - 1));
+
+				if (representative && point.is_equal_approx(p_points[*representative])) {
+					r_remap[i] = *representative;
+				}
+			}
+
+			if (r_remap[i] == i) {
+				cells[duplicate_cell_key(x, y, z)] = i;
+			}
+		}
+	}
+
+	// Normalized points, the first SUPER_VERTEX_COUNT are the vertices of the super simplex
+	LocalVector<Vector3> points;
+	//Maps the input space into the normalized one
+	AABB normalization;
+	//One simplex that has the point as a vertex, UINT32_MAX for points that are not in the tetrahedralization
+	LocalVector<uint32_t> vertex_simplices;
+	//Simplices are pooled, removed ones are reused through the free list
+	LocalVector<Simplex> simplices;
+	LocalVector<uint32_t> free_simplices;
+	uint32_t last_simplex;
+	uint32_t cavity_stamp;
+	uint64_t random_state;
+
+	//Only used while inserting, kept to avoid reallocating them for every point
+	LocalVector<uint32_t> cavity;
+	LocalVector<CavityFace> cavity_faces;
+	HashMap<uint64_t, CavityFace> open_faces;
+
+	// Cospherical points are resolved by their indices, so the result doesn't depend on the insertion order
+	_FORCE_INLINE_ bool simplex_contains(const Simplex &p_simplex, uint32_t p_vertex) const {
+		return DelaunayPredicates::insphere_perturbed(points[p_simplex.points[0]], points[p_simplex.points[1]], points[p_simplex.points[2]], points[p_simplex.points[3]], points[p_vertex],
+					   p_simplex.points[0], p_simplex.points[1], p_simplex.points[2], p_simplex.points[3], p_vertex) > 0;
+	}
+
+	// Exact, thin slivers of nearly coplanar points have a volume, and are needed to fill the hull
+	bool simplex_is_coplanar(const Simplex &p_simplex) const {
+		return DelaunayPredicates::orient3d(points[p_simplex.points[0]], points[p_simplex.points[1]], points[p_simplex.points[2]], points[p_simplex.points[3]]) == 0;
+	}
+
+	void simplex_orient(Simplex &p_simplex) const {
+		if (DelaunayPredicates::orient3d(points[p_simplex.points[0]], points[p_simplex.points[1]], points[p_simplex.points[2]], points[p_simplex.points[3]]) < 0) {
+			SWAP(p_simplex.points[0], p_simplex.points[1]);
+		}
+	}
+
+	_FORCE_INLINE_ bool simplex_is_super(const Simplex &p_simplex) const {
+		for (uint32_t i = 0; i < 4; i++) {
+			if (p_simplex.points[i] < SUPER_VERTEX_COUNT) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	uint32_t simplex_allocate() {
+		if (free_simplices.size() > 0) {
+			uint32_t index = free_simplices[free_simplices.size() - 1];
+			free_simplices.resize(free_simplices.size() - 1);
+			simplices[index] = Simplex();
+			return index;
+		}
+
+		simplices.push_back(Simplex());
+		return simplices.size() - 1;
+	}
+
+	void simplex_free(const uint32_t p_index) {
+		simplices[p_index].alive = false;
+		free_simplices.push_back(p_index);
+	}
+
+	// Visibility walk: step through any face the point is on the other side of, until the simplex
+	// containing the point is reached. The face checked first is random, so the walk can't cycle.
+	uint32_t simplex_locate(const uint32_t p_start, const Vector3 &p_point) {
+		uint32_t current = p_start;
+
+		while (true) {
+			const Simplex &simplex = simplices[current];
+			uint32_t first_face = random_next(random_state) & 3;
+			uint32_t next = UINT32_MAX;
+
+			for (uint32_t i = 0; i < 4; i++) {
+				uint32_t face = (first_face + i) & 3;
+
+				if (simplex.neighbors[face] == UINT32_MAX) {
+					continue;
+				}
+
+				const Vector3 *v[4] = {
+					&points[simplex.points[0]],
+					&points[simplex.points[1]],
+					&points[simplex.points[2]],
+					&points[simplex.points[3]],
+				};
+				v[face] = &p_point;
+
+				if (DelaunayPredicates::orient3d(*v[0], *v[1], *v[2], *v[3]) < 0) {
+					next = simplex.neighbors[face];
+					break;
+				}
+			}
+
+			if (next == UINT32_MAX) {
+				return current;
+			}
+
+			current = next;
+		}
+	}
+
+	// Bowyer-Watson step, p_start has to be the simplex that contains the point, and it can't be a duplicate
+	void point_insert(const uint32_t p_vertex, const uint32_t p_start) {
+		cavity_stamp++;
+
+		//The simplex containing the point is always in the cavity, the rest of it is connected to it
+		uint32_t start = p_start;
+
+		simplices[start].visited = cavity_stamp;
+		simplices[start].in_cavity = true;
+		cavity.push_back(start);
+
+		for (uint32_t j = 0; j < cavity.size(); j++) {
+			uint32_t index = cavity[j];
+
+			for (uint32_t k = 0; k < 4; k++) {
+				uint32_t neighbor_index = simplices[index].neighbors[k];
+
+				if (neighbor_index != UINT32_MAX) {
+					Simplex &neighbor = simplices[neighbor_index];
+
+					if (neighbor.visited != cavity_stamp) {
+						neighbor.visited = cavity_stamp;
+						neighbor.in_cavity = simplex_contains(neighbor, p_vertex);
+
+						if (neighbor.in_cavity) {
+							cavity.push_back(neighbor_index);
+						}
+					}
+
+					if (neighbor.in_cavity) {
+						continue;
+					}
+				}
+
+				CavityFace face;
+				face.simplex = index;
+				face.face = k;
+				cavity_faces.push_back(face);
+			}
+		}
+
+		//Connect every boundary face of the cavity to the new point. The point is on the inner side of
+		//all of them, so replacing the vertex opposite to the face keeps the orientation
+		for (uint32_t j = 0; j < cavity_faces.size(); j++) {
+			const CavityFace &face = cavity_faces[j];
+
+			uint32_t new_index = simplex_allocate();
+			const Simplex &old_simplex = simplices[face.simplex];
+			Simplex &new_simplex = simplices[new_index];
+
+			for (uint32_t k = 0; k < 4; k++) {
+				new_simplex.points[k] = old_simplex.points[k];
+			}
+			new_simplex.points[face.face] = p_vertex;
+			new_simplex.alive = true;
+
+			uint32_t outside_index = old_simplex.neighbors[face.face];
+			new_simplex.neighbors[face.face] = outside_index;
+
+			if (outside_index != UINT32_MAX) {
+				Simplex &outside = simplices[outside_index];
+
+				for (uint32_t k = 0; k < 4; k++) {
+					if (outside.neighbors[k] == face.simplex) {
+						outside.neighbors[k] = new_index;
+						break;
+					}
+				}
+			}
+
+			//The other faces all contain the new point, and they are shared with other new simplices
+			for (uint32_t k = 0; k < 4; k++) {
+				if (k == face.face) {
+					continue;
+				}
+
+				uint32_t edge[2];
+				uint32_t edge_size = 0;
+				for (uint32_t l = 0; l < 4; l++) {
+					if (l != k && l != face.face) {
+						edge[edge_size++] = new_simplex.points[l];
+					}
+				}
+
+				uint64_t key = edge_key(edge[0], edge[1]);
+				CavityFace *other = open_faces.getptr(key);
+
+				if (other) {
+					new_simplex.neighbors[k] = other->simplex;
+					simplices[other->simplex].neighbors[other->face] = new_index;
+					open_faces.erase(key);
+				} else {
+					CavityFace open_face;
+					open_face.simplex = new_index;
+					open_face.face = k;
+					open_faces[key] = open_face;
+				}
+			}
+
+			for (uint32_t k = 0; k < 4; k++) {
+				vertex_simplices[new_simplex.points[k]] = new_index;
+			}
+
+			last_simplex = new_index;
+		}
+
+		for (uint32_t j = 0; j < cavity.size(); j++) {
+			simplex_free(cavity[j]);
+		}
+
+		cavity.clear();
+		cavity_faces.clear();
+		open_faces.clear();
+	}
+
+	// Inserts the points with point_remap[i] == i (the offset of the super simplex is not included in the remap).
+	// The super simplex is placed around them.
+	void triangulate(const LocalVector<uint32_t> &p_point_remap) {
+		simplices.clear();
+		free_simplices.clear();
+		vertex_simplices.resize(points.size());
+
+		for (uint32_t i = 0; i < vertex_simplices.size(); i++) {
+			vertex_simplices[i] = UINT32_MAX;
+		}
+
+		{
+			AABB rect;
+			bool first = true;
+			for (uint32_t i = 0; i < p_point_remap.size(); i++) {
+				if (p_point_remap[i] != i) {
+					continue;
+				}
+
+				if (first) {
+					rect.position = points[SUPER_VERTEX_COUNT + i];
+					first = false;
+				} else {
+					rect.expand_to(points[SUPER_VERTEX_COUNT + i]);
+				}
+			}
+
+			float delta_max = Math::sqrt(2.0) * 20.0 * MAX(rect.get_longest_axis_size(), (real_t)1.0);
+			Vector3 center = rect.position + rect.size * 0.5;
+
+			// any simplex that contains everything is good
+			points[0] = center + Vector3(0, 1, 0) * delta_max;
+			points[1] = center + Vector3(0, -1, 1) * delta_max;
+			points[2] = center + Vector3(1, -1, -1) * delta_max;
+			points[3] = center + Vector3(-1, -1, -1) * delta_max;
+		}
+
+		LocalVector<uint32_t> insertion_order;
+		insertion_order_compute(points.ptr() + SUPER_VERTEX_COUNT, p_point_remap, insertion_order);
+
+		simplices.reserve(insertion_order.size() * 7 + 1);
+
+		{
+			//create root simplex
+			last_simplex = simplex_allocate();
+			Simplex &root = simplices[last_simplex];
+			root.points[0] = 0;
+			root.points[1] = 1;
+			root.points[2] = 2;
+			root.points[3] = 3;
+			root.alive = true;
+
+			simplex_orient(root);
+
+			for (uint32_t i = 0; i < SUPER_VERTEX_COUNT; i++) {
+				vertex_simplices[i] = last_simplex;
+			}
+		}
+
+		for (uint32_t i = 0; i < insertion_order.size(); i++) {
+			uint32_t vertex = SUPER_VERTEX_COUNT + insertion_order[i];
+			point_insert(vertex, simplex_locate(last_simplex, points[vertex]));
+		}
+	}
+
+	// Re-inserts every point that is still in the tetrahedralization
+	void retriangulate() {
+		LocalVector<uint32_t> point_remap;
+		point_remap.resize(points.size() - SUPER_VERTEX_COUNT);
+
+		for (uint32_t i = 0; i < point_remap.size(); i++) {
+			point_remap[i] = vertex_simplices[SUPER_VERTEX_COUNT + i] != UINT32_MAX ? i : UINT32_MAX;
+		}
+
+		triangulate(point_remap);
+	}
+
+	bool point_is_inside_super(const Vector3 &p_point) const {
+		for (uint32_t i = 0; i < SUPER_VERTEX_COUNT; i++) {
+			const Vector3 *v[4] = { &points[0], &points[1], &points[2], &points[3] };
+			v[i] = &p_point;
+
+			if (DelaunayPredicates::orient3d(*v[0], *v[1], *v[2], *v[3]) * DelaunayPredicates::orient3d(points[0], points[1], points[2], points[3]) <= 0) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// Removes the simplices around the vertex, and fills the hole with the simplices of the delaunay
+	// tetrahedralization of its neighbours that are inside it. Returns false if they don't fit the hole,
+	// which can only happen with cospherical neighbours.
+	bool point_remove(const uint32_t p_vertex) {
+		cavity_stamp++;
+
+		//The simplices around the point, and the faces of the hole they leave behind
+		LocalVector<uint32_t> link;
+		HashMap<Face, HoleFace, FaceHasher> hole_faces;
+
+		uint32_t first = vertex_simplices[p_vertex];
+		simplices[first].visited = cavity_stamp;
+		cavity.push_back(first);
+
+		for (uint32_t j = 0; j < cavity.size(); j++) {
+			const Simplex &simplex = simplices[cavity[j]];
+
+			for (uint32_t k = 0; k < 4; k++) {
+				if (simplex.points[k] != p_vertex) {
+					link.push_back(simplex.points[k]);
+
+					//The face opposite to this point contains the removed point
+					Simplex &neighbor = simplices[simplex.neighbors[k]];
+
+					if (neighbor.visited != cavity_stamp) {
+						neighbor.visited = cavity_stamp;
+						cavity.push_back(simplex.neighbors[k]);
+					}
+
+					continue;
+				}
+
+				HoleFace hole_face;
+				hole_face.star_simplex = cavity[j];
+				hole_face.outside = simplex.neighbors[k];
+				hole_face.local_simplex = UINT32_MAX;
+				hole_face.local_face = 0;
+
+				hole_faces[Face(simplex.points[(k + 1) & 3], simplex.points[(k + 2) & 3], simplex.points[(k + 3) & 3])] = hole_face;
+			}
+		}
+
+		//Sorted, so the local indices resolve cospherical points the same way as the global ones
+		link.sort();
+
+		uint32_t link_count = 0;
+		for (uint32_t i = 0; i < link.size(); i++) {
+			if (i == 0 || link[i] != link[i - 1]) {
+				link[link_count++] = link[i];
+			}
+		}
+		link.resize(link_count);
+
+		Delaunay3D local;
+		local.points.resize(SUPER_VERTEX_COUNT + link.size());
+
+		LocalVector<uint32_t> local_remap;
+		local_remap.resize(link.size());
+
+		for (uint32_t i = 0; i < link.size(); i++) {
+			local.points[SUPER_VERTEX_COUNT + i] = points[link[i]];
+			local_remap[i] = i;
+		}
+
+		local.triangulate(local_remap);
+
+		//Find the local simplices on the inner side of the faces of the hole
+		LocalVector<uint32_t> inside;
+		uint32_t matched_faces = 0;
+
+		for (uint32_t i = 0; i < local.simplices.size(); i++) {
+			local.simplices[i].in_cavity = false;
+		}
+
+		for (uint32_t i = 0; i < local.simplices.size(); i++) {
+			const Simplex &local_simplex = local.simplices[i];
+
+			if (!local_simplex.alive || local.simplex_is_super(local_simplex)) {
+				continue;
+			}
+
+			for (uint32_t k = 0; k < 4; k++) {
+				Face face(link[local_simplex.points[(k + 1) & 3] - SUPER_VERTEX_COUNT], link[local_simplex.points[(k + 2) & 3] - SUPER_VERTEX_COUNT], link[local_simplex.points[(k + 3) & 3] - SUPER_VERTEX_COUNT]);
+				HoleFace *hole_face = hole_faces.getptr(face);
+
+				if (!hole_face) {
+					continue;
+				}
+
+				//Both are positively oriented, so the removed point is on the same side as the opposite vertex
+				//if the orientation stays positive when it replaces it
+				const Vector3 *v[4] = {
+					&local.points[local_simplex.points[0]],
+					&local.points[local_simplex.points[1]],
+					&local.points[local_simplex.points[2]],
+					&local.points[local_simplex.points[3]],
+				};
+				v[k] = &points[p_vertex];
+
+				if (DelaunayPredicates::orient3d(*v[0], *v[1], *v[2], *v[3]) <= 0) {
+					continue;
+				}
+
+				if (hole_face->local_simplex != UINT32_MAX) {
+					cavity.clear();
+					return false;
+				}
+
+				hole_face->local_simplex = i;
+				hole_face->local_face = k;
+				matched_faces++;
+
+				if (!local.simplices[i].in_cavity) {
+					local.simplices[i].in_cavity = true;
+					inside.push_back(i);
+				}
+			}
+		}
+
+		if (matched_faces != hole_faces.size()) {
+			cavity.clear();
+			return false;
+		}
+
+		//Flood fill the rest of the hole, the faces of the hole are the walls
+		for (uint32_t j = 0; j < inside.size(); j++) {
+			const Simplex &local_simplex = local.simplices[inside[j]];
+
+			if (local.simplex_is_super(local_simplex)) {
+				cavity.clear();
+				return false;
+			}
+
+			for (uint32_t k = 0; k < 4; k++) {
+				Face face(link[local_simplex.points[(k + 1) & 3] - SUPER_VERTEX_COUNT], link[local_simplex.points[(k + 2) & 3] - SUPER_VERTEX_COUNT], link[local_simplex.points[(k + 3) & 3] - SUPER_VERTEX_COUNT]);
+				const HoleFace *hole_face = hole_faces.getptr(face);
+
+				if (hole_face && hole_face->local_simplex == inside[j]) {
+					continue;
+				}
+
+				uint32_t neighbor = local_simplex.neighbors[k];
+
+				if (neighbor == UINT32_MAX) {
+					cavity.clear();
+					return false;
+				}
+
+				if (!local.simplices[neighbor].in_cavity) {
+					local.simplices[neighbor].in_cavity = true;
+					inside.push_back(neighbor);
+				}
+			}
+		}
+
+		//Everything fits, replace the simplices around the point
+		LocalVector<uint32_t> local_to_global;
+		local_to_global.resize(local.simplices.size());
+
+		for (uint32_t j = 0; j < inside.size(); j++) {
+			local_to_global[inside[j]] = simplex_allocate();
+		}
+
+		for (uint32_t j = 0; j < inside.size(); j++) {
+			const Simplex &local_simplex = local.simplices[inside[j]];
+			uint32_t new_index = local_to_global[inside[j]];
+			Simplex &new_simplex = simplices[new_index];
+
+			for (uint32_t k = 0; k < 4; k++) {
+				new_simplex.points[k] = link[local_simplex.points[k] - SUPER_VERTEX_COUNT];
+			}
+			new_simplex.alive = true;
 
-#include "r128.h"
+			for (uint32_t k = 0; k < 4; k++) {
+				const HoleFace *hole_face = hole_faces.getptr(Face(new_simplex.points[(k + 1) & 3], new_simplex.points[(k + 2) & 3], new_simplex.points[(k + 3) & 3]));
 
-class Delaunay3D {
-	struct Simplex;
+				if (!hole_face || hole_face->local_simplex != inside[j]) {
+					new_simplex.neighbors[k] = local_to_global[local_simplex.neighbors[k]];
+					continue;
+				}
+
+				new_simplex.neighbors[k] = hole_face->outside;
+
+				if (hole_face->outside != UINT32_MAX) {
+					Simplex &outside = simplices[hole_face->outside];
+
+					for (uint32_t l = 0; l < 4; l++) {
+						if (outside.neighbors[l] == hole_face->star_simplex) {
+							outside.neighbors[l] = new_index;
+							break;
+						}
+					}
+				}
+			}
 
-	struct Vector3i {
-		int x;
-		int y;
-		int z;
+			for (uint32_t k = 0; k < 4; k++) {
+				vertex_simplices[new_simplex.points[k]] = new_index;
+			}
 
-		Vector3i() {
-			x = 0;
-			y = 0;
-			z = 0;
+			last_simplex = new_index;
 		}
 
-		Vector3i(const uint32_t p_x, const uint32_t p_y, const uint32_t p_z) {
-			x = p_x;
-			y = p_y;
-			z = p_z;
+		for (uint32_t j = 0; j < cavity.size(); j++) {
+			simplex_free(cavity[j]);
 		}
 
-		Vector3i(const Vector3i &other) {
-			x = other.x;
-			y = other.y;
-			z = other.z;
+		cavity.clear();
+		vertex_simplices[p_vertex] = UINT32_MAX;
+
+		return true;
+	}
+
+	template <class M>
+	void parallel_run(const uint32_t p_elements, M p_method, ParallelBuild *p_build) {
+#if VERSION_MAJOR > 3
+		WorkerThreadPool::GroupID group = WorkerThreadPool::get_singleton()->add_template_group_task(this, p_method, p_build, p_elements);
+		WorkerThreadPool::get_singleton()->wait_for_group_task_completion(group);
+#else
+		ThreadWorkPool work_pool;
+		work_pool.init();
+		work_pool.do_work(p_elements, this, p_method, p_build);
+		work_pool.finish();
+#endif
+	}
+
+	// Whether the circumsphere is strictly inside the box, with some margin for the rounding errors
+	static bool simplex_sphere_is_inside(const Vector3 &p_a, const Vector3 &p_b, const Vector3 &p_c, const Vector3 &p_d, const AABB &p_box) {
+		double bx = double(p_b.x) - p_a.x;
+		double by = double(p_b.y) - p_a.y;
+		double bz = double(p_b.z) - p_a.z;
+		double cx = double(p_c.x) - p_a.x;
+		double cy = double(p_c.y) - p_a.y;
+		double cz = double(p_c.z) - p_a.z;
+		double dx = double(p_d.x) - p_a.x;
+		double dy = double(p_d.y) - p_a.y;
+		double dz = double(p_d.z) - p_a.z;
+
+		double bl = bx * bx + by * by + bz * bz;
+		double cl = cx * cx + cy * cy + cz * cz;
+		double dl = dx * dx + dy * dy + dz * dz;
+
+		double det = 2.0 * (bx * (cy * dz - dy * cz) - cx * (by * dz - dy * bz) + dx * (by * cz - cy * bz));
+
+		if (det == 0) {
+			return false;
 		}
 
-		Vector3i(const Vector3 &v) {
-			x = static_cast<int>(v.x);
-			y = static_cast<int>(v.y);
-			z = static_cast<int>(v.z);
+		double center[3] = {
+			p_a.x + (bl * (cy * dz - dy * cz) - cl * (by * dz - dy * bz) + dl * (by * cz - cy * bz)) / det,
+			p_a.y + (bx * (cl * dz - dl * cz) - cx * (bl * dz - dl * bz) + dx * (bl * cz - cl * bz)) / det,
+			p_a.z + (bx * (cy * dl - dy * cl) - cx * (by * dl - dy * bl) + dx * (by * cl - cy * bl)) / det,
+		};
+
+		double radius_sq = (center[0] - p_a.x) * (center[0] - p_a.x) + (center[1] - p_a.y) * (center[1] - p_a.y) + (center[2] - p_a.z) * (center[2] - p_a.z);
+		double radius = Math::sqrt(radius_sq);
+		radius += radius * 1e-6 + 1e-9;
+
+		for (int i = 0; i < 3; i++) {
+			if (center[i] - radius <= p_box.position[i] || center[i] + radius >= p_box.position[i] + p_box.size[i]) {
+				return false;
+			}
 		}
 
-		Vector3i &operator=(const Vector3i &other) {
-			x = other.x;
-			y = other.y;
-			z = other.z;
+		return true;
+	}
+
+	// Median splits along the longest axis of the box, until there are p_count cells
+	static void partitions_split(const Vector3 *p_points, uint32_t *p_vertices, const uint32_t p_vertex_count, const AABB &p_box, const uint32_t p_count, LocalVector<Partition> &r_partitions) {
+		if (p_count <= 1) {
+			Partition partition;
+			partition.box = p_box;
+			partition.vertices.resize(p_vertex_count);
+
+			for (uint32_t i = 0; i < p_vertex_count; i++) {
+				partition.vertices[i] = p_vertices[i];
+			}
 
-			return *this;
+			r_partitions.push_back(partition);
+			return;
 		}
-	};
 
-	enum {
-		ACCEL_GRID_SIZE = 16
-	};
-	struct GridPos {
-		Vector3i pos;
-		List<Simplex *>::Element *E = nullptr;
-	};
+		int axis = p_box.get_longest_axis_index();
+		uint32_t half = p_vertex_count / 2;
 
-	struct Simplex {
-		uint32_t points[4];
-		R128 circum_center_x;
-		R128 circum_center_y;
-		R128 circum_center_z;
-		R128 circum_r2;
-		LocalVector<GridPos> grid_positions;
-		List<Simplex *>::Element *SE = nullptr;
-
-		_FORCE_INLINE_ Simplex() {}
-		_FORCE_INLINE_ Simplex(uint32_t p_a, uint32_t p_b, uint32_t p_c, uint32_t p_d) {
-			points[0] = p_a;
-			points[1] = p_b;
-			points[2] = p_c;
-			points[3] = p_d;
+		SortArray<uint32_t, AxisComparator> sorter;
+		sorter.compare.points = p_points;
+		sorter.compare.axis = axis;
+		sorter.nth_element(0, p_vertex_count, half, p_vertices);
+
+		real_t split = p_points[p_vertices[half]][axis];
+
+		AABB low = p_box;
+		low.size[axis] = split - p_box.position[axis];
+
+		AABB high = p_box;
+		high.position[axis] = split;
+		high.size[axis] = p_box.position[axis] + p_box.size[axis] - split;
+
+		partitions_split(p_points, p_vertices, half, low, p_count / 2, r_partitions);
+		partitions_split(p_points, p_vertices + half, p_vertex_count - half, high, p_count - p_count / 2, r_partitions);
+	}
+
+	// Runs on the worker threads
+	void partition_triangulate(uint32_t p_index, ParallelBuild *p_build) {
+		Partition &partition = p_build->partitions[p_index];
+
+		//Sorted, so the local indices resolve cospherical points the same way as the global ones
+		partition.vertices.sort();
+
+		Delaunay3D delaunay;
+		delaunay.points.resize(SUPER_VERTEX_COUNT + partition.vertices.size());
+
+		LocalVector<uint32_t> point_remap;
+		point_remap.resize(partition.vertices.size());
+
+		for (uint32_t i = 0; i < partition.vertices.size(); i++) {
+			delaunay.points[SUPER_VERTEX_COUNT + i] = points[partition.vertices[i]];
+			point_remap[i] = i;
 		}
-	};
 
-	struct Triangle {
-		uint32_t triangle[3];
-		bool bad = false;
-		_FORCE_INLINE_ bool operator==(const Triangle &p_triangle) const {
-			return triangle[0] == p_triangle.triangle[0] && triangle[1] == p_triangle.triangle[1] && triangle[2] == p_triangle.triangle[2];
+		delaunay.triangulate(point_remap);
+
+		LocalVector<uint32_t> final_indices;
+		final_indices.resize(delaunay.simplices.size());
+
+		uint32_t final_count = 0;
+
+		for (uint32_t i = 0; i < delaunay.simplices.size(); i++) {
+			const Simplex &simplex = delaunay.simplices[i];
+			final_indices[i] = UINT32_MAX;
+
+			if (!simplex.alive) {
+				continue;
+			}
+
+			if (!delaunay.simplex_is_super(simplex) &&
+					simplex_sphere_is_inside(delaunay.points[simplex.points[0]], delaunay.points[simplex.points[1]], delaunay.points[simplex.points[2]], delaunay.points[simplex.points[3]], partition.box)) {
+				final_indices[i] = final_count++;
+				continue;
+			}
+
+			for (uint32_t k = 0; k < 4; k++) {
+				if (simplex.points[k] >= SUPER_VERTEX_COUNT) {
+					//Every point belongs to one partition, so the threads never write the same element
+					p_build->boundary[partition.vertices[simplex.points[k] - SUPER_VERTEX_COUNT]] = true;
+				}
+			}
 		}
 
-		_FORCE_INLINE_ Triangle() {}
-		_FORCE_INLINE_ Triangle(uint32_t p_a, uint32_t p_b, uint32_t p_c) {
-			if (p_a > p_b) {
-				SWAP(p_a, p_b);
+		partition.simplices.resize(final_count);
+
+		for (uint32_t i = 0; i < delaunay.simplices.size(); i++) {
+			if (final_indices[i] == UINT32_MAX) {
+				continue;
 			}
-			if (p_b > p_c) {
-				SWAP(p_b, p_c);
+
+			const Simplex &simplex = delaunay.simplices[i];
+			Simplex &final_simplex = partition.simplices[final_indices[i]];
+
+			for (uint32_t k = 0; k < 4; k++) {
+				final_simplex.points[k] = partition.vertices[simplex.points[k] - SUPER_VERTEX_COUNT];
+				final_simplex.neighbors[k] = final_indices[simplex.neighbors[k]];
 			}
-			if (p_a > p_b) {
-				SWAP(p_a, p_b);
+			final_simplex.alive = true;
+
+			for (uint32_t k = 0; k < 4; k++) {
+				if (final_simplex.neighbors[k] != UINT32_MAX) {
+					continue;
+				}
+
+				BoundaryFace boundary_face;
+				boundary_face.simplex = final_indices[i];
+				boundary_face.outside = UINT32_MAX;
+				boundary_face.outside_face = 0;
+
+				partition.boundary_faces[Face(final_simplex.points[(k + 1) & 3], final_simplex.points[(k + 2) & 3], final_simplex.points[(k + 3) & 3])] = boundary_face;
 			}
+		}
 
-			triangle[0] = p_a;
-			triangle[1] = p_b;
-			triangle[2] = p_c;
+		for (uint32_t i = 0; i < partition.vertices.size(); i++) {
+			p_build->point_partitions[partition.vertices[i]] = p_index;
 		}
-	};
+	}
+
+	// Boundary faces only have points from one partition
+	BoundaryFace *boundary_face_find(ParallelBuild *p_build, const uint32_t p_a, const uint32_t p_b, const uint32_t p_c) const {
+		uint32_t partition = p_build->point_partitions[p_a];
 
-	struct TriangleHasher {
-		_FORCE_INLINE_ static uint32_t hash(const Triangle &p_triangle) {
-			uint32_t h = hash_djb2_one_32(p_triangle.triangle[0]);
-			h = hash_djb2_one_32(p_triangle.triangle[1], h);
-			return hash_djb2_one_32(p_triangle.triangle[2], h);
+		if (partition == UINT32_MAX || p_build->point_partitions[p_b] != partition || p_build->point_partitions[p_c] != partition) {
+			return nullptr;
 		}
-	};
 
-	_FORCE_INLINE_ static void circum_sphere_compute(const Vector3 *p_points, Simplex *p_simplex) {
-		// the only part in the algorithm where there may be precision errors is this one, so ensure that
-		// we do it as maximum precision as possible
+		return p_build->partitions[partition].boundary_faces.getptr(Face(p_a, p_b, p_c));
+	}
+
+	// Divide and conquer: the partitions are tetrahedralized on the worker threads, the simplices whose
+	// circumsphere is inside their cell are final. The points of the rest are tetrahedralized again
+	// (in parallel if there are still enough of them), and the parts of it that are not covered by the
+	// final simplices fill the gaps. This gives the same result as triangulate(), up to cospherical ties.
+	void triangulate_parallel(const LocalVector<uint32_t> &p_point_remap) {
+		LocalVector<uint32_t> vertices;
+		AABB rect;
+
+		for (uint32_t i = 0; i < p_point_remap.size(); i++) {
+			if (p_point_remap[i] != i) {
+				continue;
+			}
+
+			if (vertices.size() == 0) {
+				rect.position = points[SUPER_VERTEX_COUNT + i];
+			} else {
+				rect.expand_to(points[SUPER_VERTEX_COUNT + i]);
+			}
+
+			vertices.push_back(SUPER_VERTEX_COUNT + i);
+		}
 
-		R128 v0_x = p_points[p_simplex->points[0]].x;
-		R128 v0_y = p_points[p_simplex->points[0]].y;
-		R128 v0_z = p_points[p_simplex->points[0]].z;
-		R128 v1_x = p_points[p_simplex->points[1]].x;
-		R128 v1_y = p_points[p_simplex->points[1]].y;
-		R128 v1_z = p_points[p_simplex->points[1]].z;
-		R128 v2_x = p_points[p_simplex->points[2]].x;
-		R128 v2_y = p_points[p_simplex->points[2]].y;
-		R128 v2_z = p_points[p_simplex->points[2]].z;
-		R128 v3_x = p_points[p_simplex->points[3]].x;
-		R128 v3_y = p_points[p_simplex->points[3]].y;
-		R128 v3_z = p_points[p_simplex->points[3]].z;
+		uint32_t partition_count = 1;
+		uint32_t thread_count = MAX(OS::get_singleton()->get_processor_count(), 1);
 
-		//Create the rows of our "unrolled" 3x3 matrix
-		R128 row1_x = v1_x - v0_x;
-		R128 row1_y = v1_y - v0_y;
-		R128 row1_z = v1_z - v0_z;
+		while (partition_count < thread_count && vertices.size() / (partition_count * 2) >= PARALLEL_MIN_PARTITION_SIZE) {
+			partition_count *= 2;
+		}
 
-		R128 row2_x = v2_x - v0_x;
-		R128 row2_y = v2_y - v0_y;
-		R128 row2_z = v2_z - v0_z;
+		if (partition_count < 2) {
+			triangulate(p_point_remap);
+			return;
+		}
 
-		R128 row3_x = v3_x - v0_x;
-		R128 row3_y = v3_y - v0_y;
-		R128 row3_z = v3_z - v0_z;
+		ParallelBuild build;
+		build.boundary.resize(points.size());
+		build.point_partitions.resize(points.size());
 
-		R128 sq_lenght1 = row1_x * row1_x + row1_y * row1_y + row1_z * row1_z;
-		R128 sq_lenght2 = row2_x * row2_x + row2_y * row2_y + row2_z * row2_z;
-		R128 sq_lenght3 = row3_x * row3_x + row3_y * row3_y + row3_z * row3_z;
+		for (uint32_t i = 0; i < points.size(); i++) {
+			build.boundary[i] = false;
+			build.point_partitions[i] = UINT32_MAX;
+		}
 
-		//Compute the determinant of said matrix
-		R128 determinant = row1_x * (row2_y * row3_z - row3_y * row2_z) - row2_x * (row1_y * row3_z - row3_y * row1_z) + row3_x * (row1_y * row2_z - row2_y * row1_z);
+		//Nothing else is outside of the points, only the far away super simplex
+		partitions_split(points.ptr(), vertices.ptr(), vertices.size(), rect.grow(1.0), partition_count, build.partitions);
 
-		// Compute the volume of the tetrahedron, and precompute a scalar quantity for re-use in the formula
-		R128 volume = determinant / R128(6.f);
-		R128 i12volume = R128(1.f) / (volume * R128(12.f));
+		parallel_run(build.partitions.size(), &Delaunay3D::partition_triangulate, &build);
 
-		R128 center_x = v0_x + i12volume * ((row2_y * row3_z - row3_y * row2_z) * sq_lenght1 - (row1_y * row3_z - row3_y * row1_z) * sq_lenght2 + (row1_y * row2_z - row2_y * row1_z) * sq_lenght3);
-		R128 center_y = v0_y + i12volume * (-(row2_x * row3_z - row3_x * row2_z) * sq_lenght1 + (row1_x * row3_z - row3_x * row1_z) * sq_lenght2 - (row1_x * row2_z - row2_x * row1_z) * sq_lenght3);
-		R128 center_z = v0_z + i12volume * ((row2_x * row3_y - row3_x * row2_y) * sq_lenght1 - (row1_x * row3_y - row3_x * row1_y) * sq_lenght2 + (row1_x * row2_y - row2_x * row1_y) * sq_lenght3);
+		LocalVector<uint32_t> boundary_remap;
+		boundary_remap.resize(p_point_remap.size());
 
-		//Once we know the center, the radius is clearly the distance to any vertex
+		uint32_t boundary_count = 0;
 
-		R128 rel1_x = center_x - v0_x;
-		R128 rel1_y = center_y - v0_y;
-		R128 rel1_z = center_z - v0_z;
+		for (uint32_t i = 0; i < boundary_remap.size(); i++) {
+			if (p_point_remap[i] == i && build.boundary[SUPER_VERTEX_COUNT + i]) {
+				boundary_remap[i] = i;
+				boundary_count++;
+			} else {
+				boundary_remap[i] = UINT32_MAX;
+			}
+		}
 
-		R128 radius1 = rel1_x * rel1_x + rel1_y * rel1_y + rel1_z * rel1_z;
+		//The boundary points have the same bounding box (the hull is always on the boundary), so they get the same super simplex
+		if (boundary_count <= vertices.size() / 2) {
+			triangulate_parallel(boundary_remap);
+		} else {
+			triangulate(boundary_remap);
+		}
 
-		p_simplex->circum_center_x = center_x;
-		p_simplex->circum_center_y = center_y;
-		p_simplex->circum_center_z = center_z;
-		p_simplex->circum_r2 = radius1;
+		if (!partitions_merge(build)) {
+			//Only cospherical points on the boundaries can make the two disagree
+			triangulate(p_point_remap);
+		}
 	}
 
-	_FORCE_INLINE_ static bool simplex_contains(const Vector3 *p_points, const Simplex &p_simplex, uint32_t p_vertex) {
-		R128 v_x = p_points[p_vertex].x;
-		R128 v_y = p_points[p_vertex].y;
-		R128 v_z = p_points[p_vertex].z;
+	// Runs on the worker threads, finds the faces of the boundary tetrahedralization that are boundary faces of final simplices
+	void simplices_scan(uint32_t p_chunk, ParallelBuild *p_build) {
+		LocalVector<BoundaryMatch> &matches = p_build->chunk_matches[p_chunk];
+		uint32_t chunk_end = MIN((p_chunk + 1) * p_build->chunk_size, simplices.size());
+
+		for (uint32_t i = p_chunk * p_build->chunk_size; i < chunk_end; i++) {
+			const Simplex &simplex = simplices[i];
+			p_build->walls[i] = 0;
 
-		R128 rel2_x = p_simplex.circum_center_x - v_x;
-		R128 rel2_y = p_simplex.circum_center_y - v_y;
-		R128 rel2_z = p_simplex.circum_center_z - v_z;
+			if (!simplex.alive) {
+				continue;
+			}
 
-		R128 radius2 = rel2_x * rel2_x + rel2_y * rel2_y + rel2_z * rel2_z;
+			for (uint32_t k = 0; k < 4; k++) {
+				BoundaryFace *boundary_face = boundary_face_find(p_build, simplex.points[(k + 1) & 3], simplex.points[(k + 2) & 3], simplex.points[(k + 3) & 3]);
 
-		return radius2 < (p_simplex.circum_r2 - R128(0.00001));
-	}
+				if (!boundary_face) {
+					continue;
+				}
+
+				p_build->walls[i] |= 1 << k;
+
+				const Simplex &final_simplex = p_build->partitions[p_build->point_partitions[simplex.points[(k + 1) & 3]]].simplices[boundary_face->simplex];
+
+				uint32_t opposite = 0;
+				for (uint32_t l = 0; l < 4; l++) {
+					if (final_simplex.points[l] != simplex.points[(k + 1) & 3] && final_simplex.points[l] != simplex.points[(k + 2) & 3] && final_simplex.points[l] != simplex.points[(k + 3) & 3]) {
+						opposite = final_simplex.points[l];
+					}
+				}
+
+				const Vector3 *v[4] = {
+					&points[simplex.points[0]],
+					&points[simplex.points[1]],
+					&points[simplex.points[2]],
+					&points[simplex.points[3]],
+				};
+				v[k] = &points[opposite];
+
+				double side = DelaunayPredicates::orient3d(*v[0], *v[1], *v[2], *v[3]);
 
-	static bool simplex_is_coplanar(const Vector3 *p_points, const Simplex &p_simplex) {
-		Plane p(p_points[p_simplex.points[0]], p_points[p_simplex.points[1]], p_points[p_simplex.points[2]]);
-		if (ABS(p.distance_to(p_points[p_simplex.points[3]])) < CMP_EPSILON) {
-			return true;
+				if (side == 0) {
+					p_build->chunk_degenerate[p_chunk] = true;
+					continue;
+				}
+
+				//Only the simplex on the other side of the final one is kept
+				if (side < 0) {
+					BoundaryMatch match;
+					match.boundary_face = boundary_face;
+					match.simplex = i;
+					match.face = k;
+					matches.push_back(match);
+				}
+			}
 		}
+	}
+
+	// Runs on the worker threads, copies the final simplices of a partition into the merged tetrahedralization
+	void partition_merge(uint32_t p_index, ParallelBuild *p_build) {
+		const Partition &partition = p_build->partitions[p_index];
+
+		for (uint32_t j = 0; j < partition.simplices.size(); j++) {
+			const Simplex &final_simplex = partition.simplices[j];
+			uint32_t index = partition.first_simplex + j;
+			Simplex &simplex = simplices[index];
 
-		CameraMatrix cm;
+			for (uint32_t k = 0; k < 4; k++) {
+				simplex.points[k] = final_simplex.points[k];
+				//Final simplices only have the points of their own partition
+				vertex_simplices[final_simplex.points[k]] = index;
 
-		cm.matrix[0][0] = p_points[p_simplex.points[0]].x;
-		cm.matrix[0][1] = p_points[p_simplex.points[1]].x;
-		cm.matrix[0][2] = p_points[p_simplex.points[2]].x;
-		cm.matrix[0][3] = p_points[p_simplex.points[3]].x;
+				if (final_simplex.neighbors[k] != UINT32_MAX) {
+					simplex.neighbors[k] = partition.first_simplex + final_simplex.neighbors[k];
+					continue;
+				}
 
-		cm.matrix[1][0] = p_points[p_simplex.points[0]].y;
-		cm.matrix[1][1] = p_points[p_simplex.points[1]].y;
-		cm.matrix[1][2] = p_points[p_simplex.points[2]].y;
-		cm.matrix[1][3] = p_points[p_simplex.points[3]].y;
+				const BoundaryFace *boundary_face = partition.boundary_faces.getptr(Face(final_simplex.points[(k + 1) & 3], final_simplex.points[(k + 2) & 3], final_simplex.points[(k + 3) & 3]));
 
-		cm.matrix[2][0] = p_points[p_simplex.points[0]].z;
-		cm.matrix[2][1] = p_points[p_simplex.points[1]].z;
-		cm.matrix[2][2] = p_points[p_simplex.points[2]].z;
-		cm.matrix[2][3] = p_points[p_simplex.points[3]].z;
+				simplex.neighbors[k] = boundary_face->outside;
 
-		cm.matrix[3][0] = 1.0;
-		cm.matrix[3][1] = 1.0;
-		cm.matrix[3][2] = 1.0;
-		cm.matrix[3][3] = 1.0;
+				if (boundary_face->outside == UINT32_MAX) {
+					continue;
+				}
 
-		return ABS(camera_matrix_determinant(cm)) <= CMP_EPSILON;
+				//Every face of the kept simplices has at most one final simplex on the other side
+				simplices[boundary_face->outside].neighbors[boundary_face->outside_face] = index;
+			}
+			simplex.alive = true;
+		}
 	}
 
-	static float camera_matrix_determinant(const CameraMatrix &m) {
-		return m.matrix[0][3] * m.matrix[1][2] * m.matrix[2][1] * m.matrix[3][0] - m.matrix[0][2] * m.matrix[1][3] * m.matrix[2][1] * m.matrix[3][0] -
-				m.matrix[0][3] * m.matrix[1][1] * m.matrix[2][2] * m.matrix[3][0] + m.matrix[0][1] * m.matrix[1][3] * m.matrix[2][2] * m.matrix[3][0] +
-				m.matrix[0][2] * m.matrix[1][1] * m.matrix[2][3] * m.matrix[3][0] - m.matrix[0][1] * m.matrix[1][2] * m.matrix[2][3] * m.matrix[3][0] -
-				m.matrix[0][3] * m.matrix[1][2] * m.matrix[2][0] * m.matrix[3][1] + m.matrix[0][2] * m.matrix[1][3] * m.matrix[2][0] * m.matrix[3][1] +
-				m.matrix[0][3] * m.matrix[1][0] * m.matrix[2][2] * m.matrix[3][1] - m.matrix[0][0] * m.matrix[1][3] * m.matrix[2][2] * m.matrix[3][1] -
-				m.matrix[0][2] * m.matrix[1][0] * m.matrix[2][3] * m.matrix[3][1] + m.matrix[0][0] * m.matrix[1][2] * m.matrix[2][3] * m.matrix[3][1] +
-				m.matrix[0][3] * m.matrix[1][1] * m.matrix[2][0] * m.matrix[3][2] - m.matrix[0][1] * m.matrix[1][3] * m.matrix[2][0] * m.matrix[3][2] -
-				m.matrix[0][3] * m.matrix[1][0] * m.matrix[2][1] * m.matrix[3][2] + m.matrix[0][0] * m.matrix[1][3] * m.matrix[2][1] * m.matrix[3][2] +
-				m.matrix[0][1] * m.matrix[1][0] * m.matrix[2][3] * m.matrix[3][2] - m.matrix[0][0] * m.matrix[1][1] * m.matrix[2][3] * m.matrix[3][2] -
-				m.matrix[0][2] * m.matrix[1][1] * m.matrix[2][0] * m.matrix[3][3] + m.matrix[0][1] * m.matrix[1][2] * m.matrix[2][0] * m.matrix[3][3] +
-				m.matrix[0][2] * m.matrix[1][0] * m.matrix[2][1] * m.matrix[3][3] - m.matrix[0][0] * m.matrix[1][2] * m.matrix[2][1] * m.matrix[3][3] -
-				m.matrix[0][1] * m.matrix[1][0] * m.matrix[2][2] * m.matrix[3][3] + m.matrix[0][0] * m.matrix[1][1] * m.matrix[2][2] * m.matrix[3][3];
+	// Replaces the simplices of the boundary tetrahedralization that are covered by the final simplices of the partitions
+	bool partitions_merge(ParallelBuild &p_build) {
+		uint32_t chunk_count = p_build.partitions.size();
+		p_build.chunk_size = (simplices.size() + chunk_count - 1) / chunk_count;
+		p_build.walls.resize(simplices.size());
+		p_build.chunk_matches.resize(chunk_count);
+		p_build.chunk_degenerate.resize(chunk_count);
+
+		for (uint32_t i = 0; i < chunk_count; i++) {
+			p_build.chunk_degenerate[i] = false;
+		}
+
+		parallel_run(chunk_count, &Delaunay3D::simplices_scan, &p_build);
+
+		//The boundary faces separate the simplices that are covered from the ones that are kept
+		LocalVector<uint32_t> kept;
+		//Each boundary face is matched at most once, so every one is matched when the counts agree
+		uint32_t match_count = 0;
+
+		for (uint32_t i = 0; i < chunk_count; i++) {
+			if (p_build.chunk_degenerate[i]) {
+				return false;
+			}
+
+			const LocalVector<BoundaryMatch> &matches = p_build.chunk_matches[i];
+
+			for (uint32_t j = 0; j < matches.size(); j++) {
+				const BoundaryMatch &match = matches[j];
+
+				if (match.boundary_face->outside != UINT32_MAX) {
+					return false;
+				}
+
+				match.boundary_face->outside = match.simplex;
+				match.boundary_face->outside_face = match.face;
+				match_count++;
+
+				if (!simplices[match.simplex].in_cavity) {
+					simplices[match.simplex].in_cavity = true;
+					kept.push_back(match.simplex);
+				}
+			}
+		}
+
+		uint32_t boundary_face_count = 0;
+		uint32_t final_count = 0;
+
+		for (uint32_t i = 0; i < p_build.partitions.size(); i++) {
+			boundary_face_count += p_build.partitions[i].boundary_faces.size();
+			final_count += p_build.partitions[i].simplices.size();
+		}
+
+		//A boundary face without a matching simplex would leave the final simplices unconnected
+		if (match_count != boundary_face_count) {
+			return false;
+		}
+
+		if (boundary_face_count == 0) {
+			//None of the simplices were final
+			for (uint32_t i = 0; i < simplices.size(); i++) {
+				if (simplices[i].alive) {
+					simplices[i].in_cavity = true;
+					kept.push_back(i);
+				}
+			}
+		}
+
+		for (uint32_t j = 0; j < kept.size(); j++) {
+			const Simplex &simplex = simplices[kept[j]];
+
+			for (uint32_t k = 0; k < 4; k++) {
+				if ((p_build.walls[kept[j]] & (1 << k)) || simplex.neighbors[k] == UINT32_MAX) {
+					continue;
+				}
+
+				Simplex &neighbor = simplices[simplex.neighbors[k]];
+
+				if (!neighbor.in_cavity) {
+					neighbor.in_cavity = true;
+					kept.push_back(simplex.neighbors[k]);
+				}
+			}
+		}
+
+		//Every boundary face needs a kept simplex on the other side
+		for (uint32_t i = 0; i < kept.size(); i++) {
+			const Simplex &simplex = simplices[kept[i]];
+
+			for (uint32_t k = 0; k < 4; k++) {
+				if (p_build.walls[kept[i]] & (1 << k)) {
+					const BoundaryFace *boundary_face = boundary_face_find(&p_build, simplex.points[(k + 1) & 3], simplex.points[(k + 2) & 3], simplex.points[(k + 3) & 3]);
+
+					if (boundary_face->outside != kept[i]) {
+						return false;
+					}
+				}
+			}
+		}
+
+		for (uint32_t i = 0; i < vertex_simplices.size(); i++) {
+			vertex_simplices[i] = UINT32_MAX;
+		}
+
+		for (uint32_t i = 0; i < simplices.size(); i++) {
+			Simplex &simplex = simplices[i];
+
+			if (!simplex.alive) {
+				continue;
+			}
+
+			if (!simplex.in_cavity) {
+				simplex_free(i);
+				continue;
+			}
+
+			simplex.in_cavity = false;
+
+			for (uint32_t k = 0; k < 4; k++) {
+				vertex_simplices[simplex.points[k]] = i;
+			}
+
+			last_simplex = i;
+		}
+
+		//The freed simplices are left for later insertions, the final ones are filled in parallel
+		uint32_t first_simplex = simplices.size();
+		simplices.resize(first_simplex + final_count);
+
+		for (uint32_t i = 0; i < p_build.partitions.size(); i++) {
+			p_build.partitions[i].first_simplex = first_simplex;
+			first_simplex += p_build.partitions[i].simplices.size();
+		}
+
+		parallel_run(p_build.partitions.size(), &Delaunay3D::partition_merge, &p_build);
+
+		return true;
 	}
 
 public:
 	struct OutputSimplex {
+		//Ordered so DelaunayPredicates::orient3d() is positive for them
 		uint32_t points[4];
+		//neighbors[i] is the index of the output simplex on the other side of the face opposite to points[i],
+		//UINT32_MAX if there is none
+		uint32_t neighbors[4];
 	};
 
-	static Vector<OutputSimplex> tetrahedralize(const Vector<Vector3> &p_points) {
+	// If r_point_remap is set, it will contain the index of the point that was used in the output
+	// for every input point. Duplicates point to their representative, every other point to itself.
+	// Points with p_skip set are not inserted, their remap is UINT32_MAX.
+	// p_parallel splits large point sets into partitions, and tetrahedralizes them on the worker threads.
+	void build(const Vector<Vector3> &p_points, Vector<uint32_t> *r_point_remap = nullptr, const bool *p_skip = nullptr, const bool p_parallel = false) {
+		clear();
+
 		uint32_t point_count = p_points.size();
-		Vector3 *points = (Vector3 *)memalloc(sizeof(Vector3) * (point_count + 4));
+		points.resize(point_count + SUPER_VERTEX_COUNT);
 
 		{
 			const Vector3 *src_points = p_points.ptr();
@@ -275,183 +1378,232 @@ public:
 				} else {
 					rect.expand_to(point);
 				}
-				points[i] = point;
 			}
 
+			//Flat inputs would divide by zero
+			for (uint32_t i = 0; i < 3; i++) {
+				if (rect.size[i] == 0) {
+					rect.size[i] = 1;
+				}
+			}
+
+			normalization = rect;
+
 			for (uint32_t i = 0; i < point_count; i++) {
-				points[i] = (points[i] - rect.position) / rect.size;
+				points[SUPER_VERTEX_COUNT + i] = (src_points[i] - rect.position) / rect.size;
 			}
+		}
 
-			float delta_max = Math::sqrt(2.0) * 20.0;
-			Vector3 center = Vector3(0.5, 0.5, 0.5);
+		LocalVector<uint32_t> point_remap;
+		points_deduplicate(points.ptr() + SUPER_VERTEX_COUNT, point_count, point_remap, p_skip);
 
-			// any simplex that contains everything is good
-			points[point_count + 0] = center + Vector3(0, 1, 0) * delta_max;
-			points[point_count + 1] = center + Vector3(0, -1, 1) * delta_max;
-			points[point_count + 2] = center + Vector3(1, -1, -1) * delta_max;
-			points[point_count + 3] = center + Vector3(-1, -1, -1) * delta_max;
+		if (r_point_remap) {
+			r_point_remap->resize(point_count);
+			uint32_t *remapw = r_point_remap->ptrw();
+
+			for (uint32_t i = 0; i < point_count; i++) {
+				remapw[i] = point_remap[i];
+			}
 		}
 
-		List<Simplex *> acceleration_grid[ACCEL_GRID_SIZE][ACCEL_GRID_SIZE][ACCEL_GRID_SIZE];
+		if (p_parallel) {
+			triangulate_parallel(point_remap);
+		} else {
+			triangulate(point_remap);
+		}
+	}
 
-		List<Simplex *> simplex_list;
-		{
-			//create root simplex
-			Simplex *root = memnew(Simplex(point_count + 0, point_count + 1, point_count + 2, point_count + 3));
-			root->SE = simplex_list.push_back(root);
-
-			for (uint32_t i = 0; i < ACCEL_GRID_SIZE; i++) {
-				for (uint32_t j = 0; j < ACCEL_GRID_SIZE; j++) {
-					for (uint32_t k = 0; k < ACCEL_GRID_SIZE; k++) {
-						GridPos gp;
-						gp.E = acceleration_grid[i][j][k].push_back(root);
-						gp.pos = Vector3i(i, j, k);
-						root->grid_positions.push_back(gp);
-					}
-				}
+	// Adds a point without rebuilding, only the simplices whose circumsphere contains it are replaced.
+	// Returns the index of the point, or the index of the existing point if it's a duplicate.
+	// Returns UINT32_MAX if the point is too far outside of the points given to build(), it has to be rebuilt then.
+	uint32_t insert_point(const Vector3 &p_point) {
+		Vector3 point = (p_point - normalization.position) / normalization.size;
+
+		if (!point_is_inside_super(point)) {
+			return UINT32_MAX;
+		}
+
+		uint32_t start = simplex_locate(last_simplex, point);
+
+		//A duplicate is always on a vertex of the simplex it is located in
+		const Simplex &simplex = simplices[start];
+		for (uint32_t i = 0; i < 4; i++) {
+			if (simplex.points[i] >= SUPER_VERTEX_COUNT && points[simplex.points[i]].is_equal_approx(point)) {
+				return simplex.points[i] - SUPER_VERTEX_COUNT;
 			}
+		}
+
+		points.push_back(point);
+		vertex_simplices.push_back(UINT32_MAX);
+
+		point_insert(points.size() - 1, start);
 
-			circum_sphere_compute(points, root);
+		return points.size() - 1 - SUPER_VERTEX_COUNT;
+	}
+
+	// Only the simplices around the point are replaced, unless its neighbours are cospherical,
+	// then everything is retriangulated.
+	bool remove_point(const uint32_t p_index) {
+		ERR_FAIL_COND_V(!has_point(p_index), false);
+
+		if (!point_remove(SUPER_VERTEX_COUNT + p_index)) {
+			vertex_simplices[SUPER_VERTEX_COUNT + p_index] = UINT32_MAX;
+			retriangulate();
 		}
 
-		HashMap<Triangle, uint32_t, TriangleHasher> triangles_inserted;
-		LocalVector<Triangle> triangles;
+		return true;
+	}
+
+	// Removed points, and duplicates are not in the tetrahedralization
+	bool has_point(const uint32_t p_index) const {
+		return p_index < points.size() - SUPER_VERTEX_COUNT && vertex_simplices[SUPER_VERTEX_COUNT + p_index] != UINT32_MAX;
+	}
 
-		for (uint32_t i = 0; i < point_count; i++) {
-			bool unique = true;
-			for (uint32_t j = i + 1; j < point_count; j++) {
-				if (points[i].is_equal_approx(points[j])) {
-					unique = false;
-					break;
+	// Including the removed points, indices are never reused
+	uint32_t get_point_count() const {
+		return points.size() - SUPER_VERTEX_COUNT;
+	}
+
+	// The output simplex on the other side of a face. Flat simplices are not in the output, so the ones
+	// behind them are used instead, keeping the hull closed for walks and neighbor queries.
+	uint32_t output_neighbor(uint32_t p_simplex, uint32_t p_face, const LocalVector<uint32_t> &p_output_indices) const {
+		const Simplex &simplex = simplices[p_simplex];
+		uint32_t neighbor = simplex.neighbors[p_face];
+
+		if (neighbor == UINT32_MAX || p_output_indices[neighbor] != UINT32_MAX || simplex_is_super(simplices[neighbor])) {
+			return neighbor != UINT32_MAX ? p_output_indices[neighbor] : UINT32_MAX;
+		}
+
+		const Vector3 &a = points[simplex.points[(p_face + 1) & 3]];
+		const Vector3 &b = points[simplex.points[(p_face + 2) & 3]];
+		const Vector3 &c = points[simplex.points[(p_face + 3) & 3]];
+		bool positive = DelaunayPredicates::orient3d(a, b, c, points[simplex.points[p_face]]) > 0;
+
+		//Flat simplices lie in the plane of the face, the first output simplex reached through them on the other side is used
+		LocalVector<uint32_t> flat;
+		flat.push_back(neighbor);
+
+		for (uint32_t i = 0; i < flat.size(); i++) {
+			const Simplex &flat_simplex = simplices[flat[i]];
+
+			for (uint32_t k = 0; k < 4; k++) {
+				uint32_t other = flat_simplex.neighbors[k];
+
+				if (other == UINT32_MAX || other == p_simplex || simplex_is_super(simplices[other])) {
+					continue;
 				}
-			}
-			if (!unique) {
-				continue;
-			}
 
-			Vector3i grid_pos = Vector3i(points[i] * ACCEL_GRID_SIZE);
-			grid_pos.x = CLAMP(grid_pos.x, 0, ACCEL_GRID_SIZE - 1);
-			grid_pos.y = CLAMP(grid_pos.y, 0, ACCEL_GRID_SIZE - 1);
-			grid_pos.z = CLAMP(grid_pos.z, 0, ACCEL_GRID_SIZE - 1);
-
-			for (List<Simplex *>::Element *E = acceleration_grid[grid_pos.x][grid_pos.y][grid_pos.z].front(); E;) {
-				List<Simplex *>::Element *N = E->next(); //may be deleted
-
-				Simplex *simplex = E->get();
-
-				if (simplex_contains(points, *simplex, i)) {
-					static const uint32_t triangle_order[4][3] = {
-						{ 0, 1, 2 },
-						{ 0, 1, 3 },
-						{ 0, 2, 3 },
-						{ 1, 2, 3 },
-					};
-
-					for (uint32_t k = 0; k < 4; k++) {
-						Triangle t = Triangle(simplex->points[triangle_order[k][0]], simplex->points[triangle_order[k][1]], simplex->points[triangle_order[k][2]]);
-						uint32_t *p = triangles_inserted.getptr(t);
-						if (p) {
-							triangles[*p].bad = true;
-						} else {
-							triangles_inserted.set(t, triangles.size());
-							triangles.push_back(t);
-						}
+				if (p_output_indices[other] == UINT32_MAX) {
+					if (flat.find(other) == -1) {
+						flat.push_back(other);
 					}
+					continue;
+				}
+
+				const Simplex &other_simplex = simplices[other];
 
-					//remove simplex and continue
-					simplex_list.erase(simplex->SE);
+				for (uint32_t l = 0; l < 4; l++) {
+					if (other_simplex.neighbors[l] == flat[i]) {
+						double orient = DelaunayPredicates::orient3d(a, b, c, points[other_simplex.points[l]]);
 
-					for (uint32_t k = 0; k < simplex->grid_positions.size(); k++) {
-						Vector3i p = simplex->grid_positions[k].pos;
-						acceleration_grid[p.x][p.y][p.z].erase(simplex->grid_positions[k].E);
+						if (orient != 0 && (orient > 0) != positive) {
+							return p_output_indices[other];
+						}
 					}
-					memdelete(simplex);
 				}
-				E = N;
 			}
+		}
+
+		return UINT32_MAX;
+	}
+
+	// The simplices that don't touch the super simplex, and are not flat.
+	// If p_sorted is set, they are ordered along a Hilbert curve through their centroids, so neighbouring
+	// simplices are close to each other in the output too.
+	Vector<OutputSimplex> get_output(const bool p_sorted = false) const {
+		LocalVector<uint32_t> output_indices;
+		output_indices.resize(simplices.size());
+
+		uint32_t output_count = 0;
+
+		for (uint32_t i = 0; i < simplices.size(); i++) {
+			const Simplex &simplex = simplices[i];
+
+			if (!simplex.alive || simplex_is_super(simplex) || simplex_is_coplanar(simplex)) {
+				output_indices[i] = UINT32_MAX;
+				continue;
+			}
+
+			output_indices[i] = output_count++;
+		}
 
-			uint32_t good_triangles = 0;
-			for (uint32_t j = 0; j < triangles.size(); j++) {
-				if (triangles[j].bad) {
+		if (p_sorted) {
+			LocalVector<HilbertPoint> order;
+			order.resize(output_count);
+
+			for (uint32_t i = 0; i < simplices.size(); i++) {
+				if (output_indices[i] == UINT32_MAX) {
 					continue;
 				}
-				Simplex *new_simplex = memnew(Simplex(triangles[j].triangle[0], triangles[j].triangle[1], triangles[j].triangle[2], i));
-				circum_sphere_compute(points, new_simplex);
-				new_simplex->SE = simplex_list.push_back(new_simplex);
-				{
-					Vector3 center;
-					center.x = double(new_simplex->circum_center_x);
-					center.y = double(new_simplex->circum_center_y);
-					center.z = double(new_simplex->circum_center_z);
-
-					float radius2 = Math::sqrt(double(new_simplex->circum_r2));
-					radius2 += 0.0001; //
-					Vector3 extents = Vector3(radius2, radius2, radius2);
-					Vector3i from = Vector3i((center - extents) * ACCEL_GRID_SIZE);
-					Vector3i to = Vector3i((center + extents) * ACCEL_GRID_SIZE);
-					from.x = CLAMP(from.x, 0, ACCEL_GRID_SIZE - 1);
-					from.y = CLAMP(from.y, 0, ACCEL_GRID_SIZE - 1);
-					from.z = CLAMP(from.z, 0, ACCEL_GRID_SIZE - 1);
-					to.x = CLAMP(to.x, 0, ACCEL_GRID_SIZE - 1);
-					to.y = CLAMP(to.y, 0, ACCEL_GRID_SIZE - 1);
-					to.z = CLAMP(to.z, 0, ACCEL_GRID_SIZE - 1);
-
-					for (int32_t x = from.x; x <= to.x; x++) {
-						for (int32_t y = from.y; y <= to.y; y++) {
-							for (int32_t z = from.z; z <= to.z; z++) {
-								GridPos gp;
-								gp.pos = Vector3(x, y, z);
-								gp.E = acceleration_grid[x][y][z].push_back(new_simplex);
-								new_simplex->grid_positions.push_back(gp);
-							}
-						}
-					}
-				}
 
-				good_triangles++;
+				const Simplex &simplex = simplices[i];
+				Vector3 centroid = (points[simplex.points[0]] + points[simplex.points[1]] + points[simplex.points[2]] + points[simplex.points[3]]) * 0.25;
+
+				HilbertPoint &hp = order[output_indices[i]];
+				hp.key = hilbert_key(centroid);
+				hp.index = i;
 			}
 
-			//print_line("at point " + itos(i) + "/" + itos(point_count) + " simplices added " + itos(good_triangles) + "/" + itos(simplex_list.size()) + " - triangles: " + itos(triangles.size()));
-			triangles.clear();
-			triangles_inserted.clear();
+			SortArray<HilbertPoint> sorter;
+			sorter.sort(order.ptr(), order.size());
+
+			for (uint32_t i = 0; i < order.size(); i++) {
+				output_indices[order[i].index] = i;
+			}
 		}
 
-		//print_line("end with simplices: " + itos(simplex_list.size()));
 		Vector<OutputSimplex> ret_simplices;
-		ret_simplices.resize(simplex_list.size());
+		ret_simplices.resize(output_count);
 		OutputSimplex *ret_simplicesw = ret_simplices.ptrw();
-		uint32_t simplices_written = 0;
-
-		//List<Simplex *> simplex_list;
-		//for (Simplex *simplex : simplex_list) {
-		for (List<Simplex *>::Element *E = simplex_list.front(); E; E = E->next()) {
-			Simplex *simplex = E->get();
-			bool invalid = false;
-			for (int j = 0; j < 4; j++) {
-				if (simplex->points[j] >= point_count) {
-					invalid = true;
-					break;
-				}
-			}
-			if (invalid || simplex_is_coplanar(points, *simplex)) {
-				memdelete(simplex);
+
+		for (uint32_t i = 0; i < simplices.size(); i++) {
+			if (output_indices[i] == UINT32_MAX) {
 				continue;
 			}
 
-			ret_simplicesw[simplices_written].points[0] = simplex->points[0];
-			ret_simplicesw[simplices_written].points[1] = simplex->points[1];
-			ret_simplicesw[simplices_written].points[2] = simplex->points[2];
-			ret_simplicesw[simplices_written].points[3] = simplex->points[3];
-			simplices_written++;
-			memdelete(simplex);
-		}
+			const Simplex &simplex = simplices[i];
+			OutputSimplex &output = ret_simplicesw[output_indices[i]];
 
-		ret_simplices.resize(simplices_written);
+			for (uint32_t j = 0; j < 4; j++) {
+				output.points[j] = simplex.points[j] - SUPER_VERTEX_COUNT;
 
-		memfree(points);
+				output.neighbors[j] = output_neighbor(i, j, output_indices);
+			}
+		}
 
 		return ret_simplices;
 	}
+
+	void clear() {
+		points.clear();
+		normalization = AABB();
+		vertex_simplices.clear();
+		simplices.clear();
+		free_simplices.clear();
+		last_simplex = 0;
+		cavity_stamp = 0;
+		random_state = 0x2545F4914F6CDD1DULL;
+	}
+
+	static Vector<OutputSimplex> tetrahedralize(const Vector<Vector3> &p_points, Vector<uint32_t> *r_point_remap = nullptr, const bool p_parallel = false, const bool p_sorted = false) {
+		Delaunay3D delaunay;
+		delaunay.build(p_points, r_point_remap, nullptr, p_parallel);
+		return delaunay.get_output(p_sorted);
+	}
+
+	Delaunay3D() {
+		clear();
+	}
 };
 
 #endif // DELAUNAY_3D_H
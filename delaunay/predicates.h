@@ -0,0 +1,498 @@
+#ifndef DELAUNAY_PREDICATES_H
+#define DELAUNAY_PREDICATES_H
+
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "core/version.h"
+
+#if VERSION_MAJOR > 3
+#include "core/math/vector2.h"
+#include "core/math/vector3.h"
+#include "core/templates/local_vector.h"
+#else
+#include "core/local_vector.h"
+#include "core/math/vector2.h"
+#include "core/math/vector3.h"
+#endif
+
+#include <math.h>
+
+// Geometric predicates for the delaunay code, based on Jonathan Richard Shewchuk's
+// "Adaptive Precision Floating-Point Arithmetic and Fast Robust Geometric Predicates".
+// The determinants are evaluated in double precision first, and if the result is smaller than
+// the worst case rounding error, they are evaluated again exactly using expansion arithmetic.
+// Only the signs of the results are meaningful.
+class DelaunayPredicates {
+public:
+	// Positive if p_a, p_b and p_c are in counterclockwise order, negative if they are clockwise,
+	// zero if they are collinear.
+	static double orient2d(const Vector2 &p_a, const Vector2 &p_b, const Vector2 &p_c) {
+		double detleft = (double(p_a.x) - double(p_c.x)) * (double(p_b.y) - double(p_c.y));
+		double detright = (double(p_a.y) - double(p_c.y)) * (double(p_b.x) - double(p_c.x));
+		double det = detleft - detright;
+
+		double errbound = O2D_ERRBOUND_A * (fabs(detleft) + fabs(detright));
+
+		if (det > errbound || -det > errbound) {
+			return det;
+		}
+
+		return orient2d_exact(p_a, p_b, p_c);
+	}
+
+	// Positive if p_d lies inside the circle passing through p_a, p_b and p_c, negative if it lies outside,
+	// zero if the four points are cocircular. The points have to be in counterclockwise order,
+	// otherwise the sign is reversed.
+	static double incircle(const Vector2 &p_a, const Vector2 &p_b, const Vector2 &p_c, const Vector2 &p_d) {
+		double adx = double(p_a.x) - double(p_d.x);
+		double bdx = double(p_b.x) - double(p_d.x);
+		double cdx = double(p_c.x) - double(p_d.x);
+		double ady = double(p_a.y) - double(p_d.y);
+		double bdy = double(p_b.y) - double(p_d.y);
+		double cdy = double(p_c.y) - double(p_d.y);
+
+		double bdxcdy = bdx * cdy;
+		double cdxbdy = cdx * bdy;
+		double cdxady = cdx * ady;
+		double adxcdy = adx * cdy;
+		double adxbdy = adx * bdy;
+		double bdxady = bdx * ady;
+
+		double alift = adx * adx + ady * ady;
+		double blift = bdx * bdx + bdy * bdy;
+		double clift = cdx * cdx + cdy * cdy;
+
+		double det = alift * (bdxcdy - cdxbdy) + blift * (cdxady - adxcdy) + clift * (adxbdy - bdxady);
+
+		double permanent = (fabs(bdxcdy) + fabs(cdxbdy)) * alift + (fabs(cdxady) + fabs(adxcdy)) * blift + (fabs(adxbdy) + fabs(bdxady)) * clift;
+		double errbound = ICC_ERRBOUND_A * permanent;
+
+		if (det > errbound || -det > errbound) {
+			return det;
+		}
+
+		return incircle_exact(p_a, p_b, p_c, p_d);
+	}
+
+	// Positive if p_d lies below the plane of p_a, p_b and p_c, where they appear counterclockwise
+	// when viewed from above. Negative if it lies above, zero if the points are coplanar.
+	static double orient3d(const Vector3 &p_a, const Vector3 &p_b, const Vector3 &p_c, const Vector3 &p_d) {
+		double adx = double(p_a.x) - double(p_d.x);
+		double bdx = double(p_b.x) - double(p_d.x);
+		double cdx = double(p_c.x) - double(p_d.x);
+		double ady = double(p_a.y) - double(p_d.y);
+		double bdy = double(p_b.y) - double(p_d.y);
+		double cdy = double(p_c.y) - double(p_d.y);
+		double adz = double(p_a.z) - double(p_d.z);
+		double bdz = double(p_b.z) - double(p_d.z);
+		double cdz = double(p_c.z) - double(p_d.z);
+
+		double bdxcdy = bdx * cdy;
+		double cdxbdy = cdx * bdy;
+		double cdxady = cdx * ady;
+		double adxcdy = adx * cdy;
+		double adxbdy = adx * bdy;
+		double bdxady = bdx * ady;
+
+		double det = adz * (bdxcdy - cdxbdy) + bdz * (cdxady - adxcdy) + cdz * (adxbdy - bdxady);
+
+		double permanent = (fabs(bdxcdy) + fabs(cdxbdy)) * fabs(adz) + (fabs(cdxady) + fabs(adxcdy)) * fabs(bdz) + (fabs(adxbdy) + fabs(bdxady)) * fabs(cdz);
+		double errbound = O3D_ERRBOUND_A * permanent;
+
+		if (det > errbound || -det > errbound) {
+			return det;
+		}
+
+		return orient3d_exact(p_a, p_b, p_c, p_d);
+	}
+
+	// Positive if p_e lies inside the sphere passing through p_a, p_b, p_c and p_d, negative if it lies outside,
+	// zero if the five points are cospherical. The points have to be ordered so orient3d() is positive for them,
+	// otherwise the sign is reversed.
+	static double insphere(const Vector3 &p_a, const Vector3 &p_b, const Vector3 &p_c, const Vector3 &p_d, const Vector3 &p_e) {
+		double aex = double(p_a.x) - double(p_e.x);
+		double bex = double(p_b.x) - double(p_e.x);
+		double cex = double(p_c.x) - double(p_e.x);
+		double dex = double(p_d.x) - double(p_e.x);
+		double aey = double(p_a.y) - double(p_e.y);
+		double bey = double(p_b.y) - double(p_e.y);
+		double cey = double(p_c.y) - double(p_e.y);
+		double dey = double(p_d.y) - double(p_e.y);
+		double aez = double(p_a.z) - double(p_e.z);
+		double bez = double(p_b.z) - double(p_e.z);
+		double cez = double(p_c.z) - double(p_e.z);
+		double dez = double(p_d.z) - double(p_e.z);
+
+		double aexbey = aex * bey;
+		double bexaey = bex * aey;
+		double ab = aexbey - bexaey;
+		double bexcey = bex * cey;
+		double cexbey = cex * bey;
+		double bc = bexcey - cexbey;
+		double cexdey = cex * dey;
+		double dexcey = dex * cey;
+		double cd = cexdey - dexcey;
+		double dexaey = dex * aey;
+		double aexdey = aex * dey;
+		double da = dexaey - aexdey;
+		double aexcey = aex * cey;
+		double cexaey = cex * aey;
+		double ac = aexcey - cexaey;
+		double bexdey = bex * dey;
+		double dexbey = dex * bey;
+		double bd = bexdey - dexbey;
+
+		double abc = aez * bc - bez * ac + cez * ab;
+		double bcd = bez * cd - cez * bd + dez * bc;
+		double cda = cez * da + dez * ac + aez * cd;
+		double dab = dez * ab + aez * bd + bez * da;
+
+		double alift = aex * aex + aey * aey + aez * aez;
+		double blift = bex * bex + bey * bey + bez * bez;
+		double clift = cex * cex + cey * cey + cez * cez;
+		double dlift = dex * dex + dey * dey + dez * dez;
+
+		double det = (dlift * abc - clift * dab) + (blift * cda - alift * bcd);
+
+		double aezplus = fabs(aez);
+		double bezplus = fabs(bez);
+		double cezplus = fabs(cez);
+		double dezplus = fabs(dez);
+		double aexbeyplus = fabs(aexbey);
+		double bexaeyplus = fabs(bexaey);
+		double bexceyplus = fabs(bexcey);
+		double cexbeyplus = fabs(cexbey);
+		double cexdeyplus = fabs(cexdey);
+		double dexceyplus = fabs(dexcey);
+		double dexaeyplus = fabs(dexaey);
+		double aexdeyplus = fabs(aexdey);
+		double aexceyplus = fabs(aexcey);
+		double cexaeyplus = fabs(cexaey);
+		double bexdeyplus = fabs(bexdey);
+		double dexbeyplus = fabs(dexbey);
+
+		double permanent = ((cexdeyplus + dexceyplus) * bezplus + (dexbeyplus + bexdeyplus) * cezplus + (bexceyplus + cexbeyplus) * dezplus) * alift +
+				((dexaeyplus + aexdeyplus) * cezplus + (aexceyplus + cexaeyplus) * dezplus + (cexdeyplus + dexceyplus) * aezplus) * blift +
+				((aexbeyplus + bexaeyplus) * dezplus + (bexdeyplus + dexbeyplus) * aezplus + (dexaeyplus + aexdeyplus) * bezplus) * clift +
+				((bexceyplus + cexbeyplus) * aezplus + (cexaeyplus + aexceyplus) * bezplus + (aexbeyplus + bexaeyplus) * cezplus) * dlift;
+		double errbound = ISP_ERRBOUND_A * permanent;
+
+		if (det > errbound || -det > errbound) {
+			return det;
+		}
+
+		return insphere_exact(p_a, p_b, p_c, p_d, p_e);
+	}
+
+	// insphere() with the ties broken by symbolically lifting the points (as in the paraboloid lifting of the
+	// delaunay tetrahedralization) by amounts that grow with their index. Every triangulation that uses the same
+	// indices resolves cospherical points the same way, and it is never zero for non coplanar p_a, p_b, p_c, p_d.
+	// See Devillers and Teillaud: "Perturbations for Delaunay and weighted Delaunay 3D triangulations".
+	static double insphere_perturbed(const Vector3 &p_a, const Vector3 &p_b, const Vector3 &p_c, const Vector3 &p_d, const Vector3 &p_e,
+			const uint32_t p_ia, const uint32_t p_ib, const uint32_t p_ic, const uint32_t p_id, const uint32_t p_ie) {
+		double det = insphere(p_a, p_b, p_c, p_d, p_e);
+
+		if (det != 0) {
+			return det;
+		}
+
+		const Vector3 *points[5] = { &p_a, &p_b, &p_c, &p_d, &p_e };
+		const uint32_t indices[5] = { p_ia, p_ib, p_ic, p_id, p_ie };
+
+		//Positions sorted by decreasing index, the highest index is lifted the most
+		int order[5] = { 0, 1, 2, 3, 4 };
+		for (int i = 1; i < 5; i++) {
+			for (int j = i; j > 0 && indices[order[j - 1]] < indices[order[j]]; j--) {
+				SWAP(order[j - 1], order[j]);
+			}
+		}
+
+		for (int i = 0; i < 5; i++) {
+			const Vector3 *others[4];
+			int other_count = 0;
+
+			for (int j = 0; j < 5; j++) {
+				if (j != order[i]) {
+					others[other_count++] = points[j];
+				}
+			}
+
+			//The coefficient of the lift of the point in the 5x5 lifted determinant
+			double orient = orient3d(*others[0], *others[1], *others[2], *others[3]);
+
+			if (orient != 0) {
+				return (order[i] & 1) ? orient : -orient;
+			}
+		}
+
+		return 0;
+	}
+
+	// Same determinants as above, but always evaluated exactly.
+	static double orient2d_exact(const Vector2 &p_a, const Vector2 &p_b, const Vector2 &p_c) {
+		Expansion acx = Expansion::difference(p_a.x, p_c.x);
+		Expansion bcx = Expansion::difference(p_b.x, p_c.x);
+		Expansion acy = Expansion::difference(p_a.y, p_c.y);
+		Expansion bcy = Expansion::difference(p_b.y, p_c.y);
+
+		Expansion det = acx * bcy - acy * bcx;
+
+		return det.estimate();
+	}
+
+	static double incircle_exact(const Vector2 &p_a, const Vector2 &p_b, const Vector2 &p_c, const Vector2 &p_d) {
+		Expansion adx = Expansion::difference(p_a.x, p_d.x);
+		Expansion bdx = Expansion::difference(p_b.x, p_d.x);
+		Expansion cdx = Expansion::difference(p_c.x, p_d.x);
+		Expansion ady = Expansion::difference(p_a.y, p_d.y);
+		Expansion bdy = Expansion::difference(p_b.y, p_d.y);
+		Expansion cdy = Expansion::difference(p_c.y, p_d.y);
+
+		Expansion alift = adx * adx + ady * ady;
+		Expansion blift = bdx * bdx + bdy * bdy;
+		Expansion clift = cdx * cdx + cdy * cdy;
+
+		Expansion det = alift * (bdx * cdy - cdx * bdy) + blift * (cdx * ady - adx * cdy) + clift * (adx * bdy - bdx * ady);
+
+		return det.estimate();
+	}
+
+	static double orient3d_exact(const Vector3 &p_a, const Vector3 &p_b, const Vector3 &p_c, const Vector3 &p_d) {
+		Expansion adx = Expansion::difference(p_a.x, p_d.x);
+		Expansion bdx = Expansion::difference(p_b.x, p_d.x);
+		Expansion cdx = Expansion::difference(p_c.x, p_d.x);
+		Expansion ady = Expansion::difference(p_a.y, p_d.y);
+		Expansion bdy = Expansion::difference(p_b.y, p_d.y);
+		Expansion cdy = Expansion::difference(p_c.y, p_d.y);
+		Expansion adz = Expansion::difference(p_a.z, p_d.z);
+		Expansion bdz = Expansion::difference(p_b.z, p_d.z);
+		Expansion cdz = Expansion::difference(p_c.z, p_d.z);
+
+		Expansion det = adz * (bdx * cdy - cdx * bdy) + bdz * (cdx * ady - adx * cdy) + cdz * (adx * bdy - bdx * ady);
+
+		return det.estimate();
+	}
+
+	static double insphere_exact(const Vector3 &p_a, const Vector3 &p_b, const Vector3 &p_c, const Vector3 &p_d, const Vector3 &p_e) {
+		Expansion aex = Expansion::difference(p_a.x, p_e.x);
+		Expansion bex = Expansion::difference(p_b.x, p_e.x);
+		Expansion cex = Expansion::difference(p_c.x, p_e.x);
+		Expansion dex = Expansion::difference(p_d.x, p_e.x);
+		Expansion aey = Expansion::difference(p_a.y, p_e.y);
+		Expansion bey = Expansion::difference(p_b.y, p_e.y);
+		Expansion cey = Expansion::difference(p_c.y, p_e.y);
+		Expansion dey = Expansion::difference(p_d.y, p_e.y);
+		Expansion aez = Expansion::difference(p_a.z, p_e.z);
+		Expansion bez = Expansion::difference(p_b.z, p_e.z);
+		Expansion cez = Expansion::difference(p_c.z, p_e.z);
+		Expansion dez = Expansion::difference(p_d.z, p_e.z);
+
+		Expansion ab = aex * bey - bex * aey;
+		Expansion bc = bex * cey - cex * bey;
+		Expansion cd = cex * dey - dex * cey;
+		Expansion da = dex * aey - aex * dey;
+		Expansion ac = aex * cey - cex * aey;
+		Expansion bd = bex * dey - dex * bey;
+
+		Expansion abc = aez * bc - bez * ac + cez * ab;
+		Expansion bcd = bez * cd - cez * bd + dez * bc;
+		Expansion cda = cez * da + dez * ac + aez * cd;
+		Expansion dab = dez * ab + aez * bd + bez * da;
+
+		Expansion alift = aex * aex + aey * aey + aez * aez;
+		Expansion blift = bex * bex + bey * bey + bez * bez;
+		Expansion clift = cex * cex + cey * cey + cez * cez;
+		Expansion dlift = dex * dex + dey * dey + dez * dez;
+
+		Expansion det = (dlift * abc - clift * dab) + (blift * cda - alift * bcd);
+
+		return det.estimate();
+	}
+
+private:
+	// (3 + 16 * epsilon) * epsilon, (10 + 96 * epsilon) * epsilon, (7 + 56 * epsilon) * epsilon
+	// and (16 + 224 * epsilon) * epsilon, where epsilon is 2^-53
+	static constexpr double O2D_ERRBOUND_A = 3.3306690738754716e-16;
+	static constexpr double ICC_ERRBOUND_A = 1.1102230246251577e-15;
+	static constexpr double O3D_ERRBOUND_A = 7.7715611723761008e-16;
+	static constexpr double ISP_ERRBOUND_A = 1.7763568394002532e-15;
+
+	// A sum of non overlapping doubles, ordered by increasing magnitude, zero components are removed.
+	// It represents its value exactly, the sign of the value is the sign of the last component.
+	struct Expansion {
+		LocalVector<double> terms;
+
+		_FORCE_INLINE_ static void two_sum(const double p_a, const double p_b, double &r_x, double &r_y) {
+			r_x = p_a + p_b;
+			double bvirt = r_x - p_a;
+			double avirt = r_x - bvirt;
+			r_y = (p_a - avirt) + (p_b - bvirt);
+		}
+
+		_FORCE_INLINE_ static void fast_two_sum(const double p_a, const double p_b, double &r_x, double &r_y) {
+			r_x = p_a + p_b;
+			r_y = p_b - (r_x - p_a);
+		}
+
+		_FORCE_INLINE_ static void two_product(const double p_a, const double p_b, double &r_x, double &r_y) {
+			r_x = p_a * p_b;
+			r_y = fma(p_a, p_b, -r_x);
+		}
+
+		static Expansion difference(const double p_a, const double p_b) {
+			Expansion e;
+
+			double x;
+			double y;
+			two_sum(p_a, -p_b, x, y);
+
+			if (y != 0) {
+				e.terms.push_back(y);
+			}
+			if (x != 0) {
+				e.terms.push_back(x);
+			}
+
+			return e;
+		}
+
+		Expansion scaled(const double p_b) const {
+			Expansion h;
+
+			if (terms.size() == 0 || p_b == 0) {
+				return h;
+			}
+
+			double q;
+			double hh;
+			two_product(terms[0], p_b, q, hh);
+
+			if (hh != 0) {
+				h.terms.push_back(hh);
+			}
+
+			for (uint32_t i = 1; i < terms.size(); i++) {
+				double product1;
+				double product0;
+				double sum;
+				two_product(terms[i], p_b, product1, product0);
+
+				two_sum(q, product0, sum, hh);
+				if (hh != 0) {
+					h.terms.push_back(hh);
+				}
+
+				fast_two_sum(product1, sum, q, hh);
+				if (hh != 0) {
+					h.terms.push_back(hh);
+				}
+			}
+
+			if (q != 0) {
+				h.terms.push_back(q);
+			}
+
+			return h;
+		}
+
+		Expansion operator+(const Expansion &p_f) const {
+			if (terms.size() == 0) {
+				return p_f;
+			}
+			if (p_f.terms.size() == 0) {
+				return *this;
+			}
+
+			Expansion h;
+
+			// Merge the components by increasing magnitude, then add them up from the smallest one
+			uint32_t ei = 0;
+			uint32_t fi = 0;
+			double q = 0;
+			bool first = true;
+
+			while (ei < terms.size() || fi < p_f.terms.size()) {
+				double next;
+
+				if (fi >= p_f.terms.size() || (ei < terms.size() && fabs(terms[ei]) <= fabs(p_f.terms[fi]))) {
+					next = terms[ei++];
+				} else {
+					next = p_f.terms[fi++];
+				}
+
+				if (first) {
+					q = next;
+					first = false;
+					continue;
+				}
+
+				double hh;
+				two_sum(q, next, q, hh);
+
+				if (hh != 0) {
+					h.terms.push_back(hh);
+				}
+			}
+
+			if (q != 0) {
+				h.terms.push_back(q);
+			}
+
+			return h;
+		}
+
+		Expansion operator-() const {
+			Expansion h = *this;
+
+			for (uint32_t i = 0; i < h.terms.size(); i++) {
+				h.terms[i] = -h.terms[i];
+			}
+
+			return h;
+		}
+
+		Expansion operator-(const Expansion &p_f) const {
+			return *this + (-p_f);
+		}
+
+		Expansion operator*(const Expansion &p_f) const {
+			Expansion h;
+
+			for (uint32_t i = 0; i < p_f.terms.size(); i++) {
+				h = h + scaled(p_f.terms[i]);
+			}
+
+			return h;
+		}
+
+		double estimate() const {
+			if (terms.size() == 0) {
+				return 0;
+			}
+
+			return terms[terms.size() - 1];
+		}
+	};
+};
+
+#endif
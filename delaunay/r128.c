@@ -1,2 +0,0 @@
-#define R128_IMPLEMENTATION
-#include "r128.h"
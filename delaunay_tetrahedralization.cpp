@@ -0,0 +1,302 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "delaunay_tetrahedralization.h"
+
+#include "delaunay/predicates.h"
+
+void DelaunayTetrahedralization::build(const Vector<Vector3> &p_points, const bool p_parallel) {
+	_points = p_points;
+	_parallel = p_parallel;
+	_delaunay.build(p_points, nullptr, nullptr, p_parallel);
+	_tetrahedra_dirty = true;
+}
+
+void DelaunayTetrahedralization::clear() {
+	_points.clear();
+	_delaunay.clear();
+	_tetrahedra.clear();
+	_tetrahedra_dirty = false;
+}
+
+int DelaunayTetrahedralization::insert_point(const Vector3 &p_point) {
+	if (_points.size() == 0) {
+		Vector<Vector3> points;
+		points.push_back(p_point);
+		build(points, _parallel);
+		return 0;
+	}
+
+	uint32_t index = _delaunay.insert_point(p_point);
+
+	_tetrahedra_dirty = true;
+
+	if (index != UINT32_MAX) {
+		if (index == static_cast<uint32_t>(_points.size())) {
+			_points.push_back(p_point);
+		}
+
+		return index;
+	}
+
+	//Too far outside of the current points for the super simplex, rebuild with the removed points left out
+	int point_count = _points.size();
+
+	LocalVector<bool> skip;
+	skip.resize(point_count + 1);
+
+	for (int i = 0; i < point_count; ++i) {
+		skip[i] = !_delaunay.has_point(i);
+	}
+	skip[point_count] = false;
+
+	_points.push_back(p_point);
+	_delaunay.build(_points, nullptr, skip.ptr(), _parallel);
+
+	return point_count;
+}
+
+bool DelaunayTetrahedralization::remove_point(const int p_index) {
+	ERR_FAIL_COND_V(!has_point(p_index), false);
+
+	_tetrahedra_dirty = true;
+
+	return _delaunay.remove_point(p_index);
+}
+
+bool DelaunayTetrahedralization::has_point(const int p_index) const {
+	return p_index >= 0 && _delaunay.has_point(p_index);
+}
+
+PoolVector3Array DelaunayTetrahedralization::get_points() const {
+	return _points;
+}
+
+int DelaunayTetrahedralization::get_tetrahedron_count() const {
+	_update_tetrahedra();
+
+	return _tetrahedra.size();
+}
+
+PoolIntArray DelaunayTetrahedralization::get_tetrahedra() const {
+	_update_tetrahedra();
+
+	PoolIntArray ret;
+	ret.resize(_tetrahedra.size() * 4);
+	int64_t *w = ret.ptrw();
+
+	for (int i = 0; i < _tetrahedra.size(); ++i) {
+		const Delaunay3D::OutputSimplex &t = _tetrahedra[i];
+
+		for (int j = 0; j < 4; ++j) {
+			w[i * 4 + j] = t.points[j];
+		}
+	}
+
+	return ret;
+}
+
+PoolIntArray DelaunayTetrahedralization::get_tetrahedron_points(const int p_tetrahedron) const {
+	_update_tetrahedra();
+
+	ERR_FAIL_INDEX_V(p_tetrahedron, _tetrahedra.size(), PoolIntArray());
+
+	const Delaunay3D::OutputSimplex &t = _tetrahedra[p_tetrahedron];
+
+	PoolIntArray ret;
+	ret.resize(4);
+	int64_t *w = ret.ptrw();
+
+	for (int i = 0; i < 4; ++i) {
+		w[i] = t.points[i];
+	}
+
+	return ret;
+}
+
+PoolIntArray DelaunayTetrahedralization::get_tetrahedron_neighbors(const int p_tetrahedron) const {
+	_update_tetrahedra();
+
+	ERR_FAIL_INDEX_V(p_tetrahedron, _tetrahedra.size(), PoolIntArray());
+
+	const Delaunay3D::OutputSimplex &t = _tetrahedra[p_tetrahedron];
+
+	PoolIntArray ret;
+	ret.resize(4);
+	int64_t *w = ret.ptrw();
+
+	for (int i = 0; i < 4; ++i) {
+		w[i] = t.neighbors[i] != UINT32_MAX ? static_cast<int64_t>(t.neighbors[i]) : -1;
+	}
+
+	return ret;
+}
+
+int DelaunayTetrahedralization::find_tetrahedron(const Vector3 &p_point, const int p_hint) const {
+	_update_tetrahedra();
+
+	if (_tetrahedra.size() == 0) {
+		return -1;
+	}
+
+	const Vector3 *points = _points.ptr();
+	const Delaunay3D::OutputSimplex *tetrahedra = _tetrahedra.ptr();
+
+	uint32_t current = (p_hint >= 0 && p_hint < _tetrahedra.size()) ? p_hint : 0;
+
+	//The face that is checked first is random, so the walk can't cycle
+	uint64_t random_state = 0x2545F4914F6CDD1DULL ^ current;
+
+	//Neighbors that step over a flat tetrahedron could make the walk go around, so this is just a safety net
+	for (int step = 0; step < _tetrahedra.size(); ++step) {
+		const Delaunay3D::OutputSimplex &t = tetrahedra[current];
+
+		random_state ^= random_state << 13;
+		random_state ^= random_state >> 7;
+		random_state ^= random_state << 17;
+		uint32_t first_face = (random_state >> 32) & 3;
+
+		bool inside = true;
+
+		for (uint32_t i = 0; i < 4; ++i) {
+			uint32_t face = (first_face + i) & 3;
+
+			const Vector3 *v[4] = {
+				&points[t.points[0]],
+				&points[t.points[1]],
+				&points[t.points[2]],
+				&points[t.points[3]],
+			};
+			v[face] = &p_point;
+
+			if (DelaunayPredicates::orient3d(*v[0], *v[1], *v[2], *v[3]) < 0) {
+				//On the outer side of a face of the convex hull
+				if (t.neighbors[face] == UINT32_MAX) {
+					return -1;
+				}
+
+				current = t.neighbors[face];
+				inside = false;
+				break;
+			}
+		}
+
+		if (inside) {
+			return current;
+		}
+	}
+
+	return -1;
+}
+
+PoolRealArray DelaunayTetrahedralization::get_barycentric_weights(const int p_tetrahedron, const Vector3 &p_point) const {
+	_update_tetrahedra();
+
+	ERR_FAIL_INDEX_V(p_tetrahedron, _tetrahedra.size(), PoolRealArray());
+
+	const Delaunay3D::OutputSimplex &t = _tetrahedra[p_tetrahedron];
+	const Vector3 *points = _points.ptr();
+
+	//Volumes of the tetrahedra formed by replacing one point with p_point, relative to the volume of the whole one
+	double volumes[5];
+
+	for (int i = 0; i < 5; ++i) {
+		Vector3 v[4] = {
+			points[t.points[0]],
+			points[t.points[1]],
+			points[t.points[2]],
+			points[t.points[3]],
+		};
+
+		if (i < 4) {
+			v[i] = p_point;
+		}
+
+		double e1x = double(v[1].x) - v[0].x;
+		double e1y = double(v[1].y) - v[0].y;
+		double e1z = double(v[1].z) - v[0].z;
+		double e2x = double(v[2].x) - v[0].x;
+		double e2y = double(v[2].y) - v[0].y;
+		double e2z = double(v[2].z) - v[0].z;
+		double e3x = double(v[3].x) - v[0].x;
+		double e3y = double(v[3].y) - v[0].y;
+		double e3z = double(v[3].z) - v[0].z;
+
+		volumes[i] = e1x * (e2y * e3z - e2z * e3y) - e1y * (e2x * e3z - e2z * e3x) + e1z * (e2x * e3y - e2y * e3x);
+	}
+
+	PoolRealArray ret;
+	ret.resize(4);
+	float *w = ret.ptrw();
+
+	if (volumes[4] == 0) {
+		for (int i = 0; i < 4; ++i) {
+			w[i] = 0.25;
+		}
+
+		return ret;
+	}
+
+	for (int i = 0; i < 4; ++i) {
+		w[i] = volumes[i] / volumes[4];
+	}
+
+	return ret;
+}
+
+void DelaunayTetrahedralization::_update_tetrahedra() const {
+	if (!_tetrahedra_dirty) {
+		return;
+	}
+
+	_tetrahedra = _delaunay.get_output();
+	_tetrahedra_dirty = false;
+}
+
+DelaunayTetrahedralization::DelaunayTetrahedralization() {
+	_tetrahedra_dirty = false;
+	_parallel = false;
+}
+
+DelaunayTetrahedralization::~DelaunayTetrahedralization() {
+	clear();
+}
+
+void DelaunayTetrahedralization::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("build", "points", "parallel"), &DelaunayTetrahedralization::build, DEFVAL(false));
+	ClassDB::bind_method(D_METHOD("clear"), &DelaunayTetrahedralization::clear);
+
+	ClassDB::bind_method(D_METHOD("insert_point", "point"), &DelaunayTetrahedralization::insert_point);
+	ClassDB::bind_method(D_METHOD("remove_point", "index"), &DelaunayTetrahedralization::remove_point);
+	ClassDB::bind_method(D_METHOD("has_point", "index"), &DelaunayTetrahedralization::has_point);
+
+	ClassDB::bind_method(D_METHOD("get_points"), &DelaunayTetrahedralization::get_points);
+	ClassDB::bind_method(D_METHOD("get_tetrahedron_count"), &DelaunayTetrahedralization::get_tetrahedron_count);
+
+	ClassDB::bind_method(D_METHOD("get_tetrahedra"), &DelaunayTetrahedralization::get_tetrahedra);
+	ClassDB::bind_method(D_METHOD("get_tetrahedron_points", "tetrahedron"), &DelaunayTetrahedralization::get_tetrahedron_points);
+	ClassDB::bind_method(D_METHOD("get_tetrahedron_neighbors", "tetrahedron"), &DelaunayTetrahedralization::get_tetrahedron_neighbors);
+
+	ClassDB::bind_method(D_METHOD("find_tetrahedron", "point", "hint"), &DelaunayTetrahedralization::find_tetrahedron, DEFVAL(-1));
+	ClassDB::bind_method(D_METHOD("get_barycentric_weights", "tetrahedron", "point"), &DelaunayTetrahedralization::get_barycentric_weights);
+}
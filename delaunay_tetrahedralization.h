@@ -0,0 +1,83 @@
+#ifndef DELAUNAY_TETRAHEDRALIZATION_H
+#define DELAUNAY_TETRAHEDRALIZATION_H
+
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "core/object/ref_counted.h"
+#include "core/templates/vector.h"
+
+#include "defines.h"
+
+#include "delaunay/delaunay_3d.h"
+
+// A delaunay tetrahedralization that keeps the face adjacency of the tetrahedra,
+// so points can be located in it by walking, for example to interpolate light probes.
+// Tetrahedra are ordered so their first three points are counterclockwise when viewed from the fourth.
+// Points can be inserted and removed later, that only retriangulates the tetrahedra around them.
+class DelaunayTetrahedralization : public RefCounted {
+	GDCLASS(DelaunayTetrahedralization, RefCounted);
+
+public:
+	void build(const Vector<Vector3> &p_points, const bool p_parallel = false);
+	void clear();
+
+	//Returns the index of the point, or the index of the existing point at the same position
+	int insert_point(const Vector3 &p_point);
+	//Point indices stay valid, removed points are kept in get_points(), but no tetrahedron uses them
+	bool remove_point(const int p_index);
+	bool has_point(const int p_index) const;
+
+	PoolVector3Array get_points() const;
+	int get_tetrahedron_count() const;
+
+	//4 point indices / tetrahedron
+	PoolIntArray get_tetrahedra() const;
+	PoolIntArray get_tetrahedron_points(const int p_tetrahedron) const;
+	//neighbors[i] is on the other side of the face opposite to points[i], -1 on the outer faces
+	PoolIntArray get_tetrahedron_neighbors(const int p_tetrahedron) const;
+
+	//Walks from hint (for example the result of the previous query for the same object), so coherent queries are cheap.
+	//Returns -1 if the point is outside.
+	int find_tetrahedron(const Vector3 &p_point, const int p_hint = -1) const;
+	//Weights of the 4 points of the tetrahedron, in the same order as get_tetrahedron_points()
+	PoolRealArray get_barycentric_weights(const int p_tetrahedron, const Vector3 &p_point) const;
+
+	DelaunayTetrahedralization();
+	~DelaunayTetrahedralization();
+
+protected:
+	static void _bind_methods();
+
+	void _update_tetrahedra() const;
+
+	Vector<Vector3> _points;
+	Delaunay3D _delaunay;
+	//From the last build(), the rebuilds of insert_point() use it too
+	bool _parallel;
+
+	//Only exported from _delaunay when they are queried after a change
+	mutable Vector<Delaunay3D::OutputSimplex> _tetrahedra;
+	mutable bool _tetrahedra_dirty;
+};
+
+#endif
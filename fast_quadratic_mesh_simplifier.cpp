@@ -1,5 +1,8 @@
 #include "fast_quadratic_mesh_simplifier.h"
 
+#include "mesh_result_cache.h"
+#include "mesh_utils.h"
+
 /*
 
 Copyright (c) 2020-2022 Péter Magyar
@@ -66,6 +69,55 @@ void FastQuadraticMeshSimplifier::set_preserve_uv_foldover_edges(const bool valu
 	simplify._preserve_uv_foldover_edges = value;
 }
 
+bool FastQuadraticMeshSimplifier::get_enable_collapse_queue() const {
+	return simplify._enable_collapse_queue;
+}
+void FastQuadraticMeshSimplifier::set_enable_collapse_queue(const bool value) {
+	simplify._enable_collapse_queue = value;
+}
+
+double FastQuadraticMeshSimplifier::get_vertex_link_distance() const {
+	return simplify._vertex_link_distance;
+}
+void FastQuadraticMeshSimplifier::set_vertex_link_distance(const double value) {
+	simplify._vertex_link_distance = value;
+}
+
+int FastQuadraticMeshSimplifier::get_cluster_count() const {
+	return simplify._cluster_count;
+}
+void FastQuadraticMeshSimplifier::set_cluster_count(const int value) {
+	simplify._cluster_count = value;
+}
+
+bool FastQuadraticMeshSimplifier::get_record_collapses() const {
+	return simplify._record_collapses;
+}
+void FastQuadraticMeshSimplifier::set_record_collapses(const bool value) {
+	simplify._record_collapses = value;
+}
+
+double FastQuadraticMeshSimplifier::get_uv_weight() const {
+	return simplify._uv_weight;
+}
+void FastQuadraticMeshSimplifier::set_uv_weight(const double value) {
+	simplify._uv_weight = value;
+}
+
+double FastQuadraticMeshSimplifier::get_uv2_weight() const {
+	return simplify._uv2_weight;
+}
+void FastQuadraticMeshSimplifier::set_uv2_weight(const double value) {
+	simplify._uv2_weight = value;
+}
+
+double FastQuadraticMeshSimplifier::get_color_weight() const {
+	return simplify._color_weight;
+}
+void FastQuadraticMeshSimplifier::set_color_weight(const double value) {
+	simplify._color_weight = value;
+}
+
 int FastQuadraticMeshSimplifier::get_format() const {
 	return simplify._format;
 }
@@ -73,33 +125,336 @@ void FastQuadraticMeshSimplifier::set_format(const int value) {
 	simplify._format = value;
 }
 
+// Keeps the settings, and the allocated memory, so one simplifier can be reused for many meshes
+void FastQuadraticMeshSimplifier::reset() {
+	_cache_state_valid = false;
+	_cache_state_stale = false;
+	_cache_result_valid = false;
+	_cache_store_pending = false;
+	_cache_input = Array();
+	_cache_result = Array();
+	_cache_operations.clear();
+
+	simplify.reset();
+}
+
 void FastQuadraticMeshSimplifier::initialize(const Array &arrays) {
+	reset();
+
+	MeshUtils *mu = MeshUtils::get_singleton();
+
+	if (mu && mu->get_result_cache()->get_enabled()) {
+		//packed arrays are copy on write, so this is cheap
+		_cache_input = arrays.duplicate();
+		_cache_state_hash = MeshResultCache::hash_operation(MeshResultCache::OPERATION_SIMPLIFY_MESH);
+		_cache_state_hash = MeshResultCache::hash_variant(_cache_input, _cache_state_hash);
+		// Recording changes where edges collapse to
+		_cache_state_hash = MeshResultCache::hash_uint64(simplify._record_collapses, _cache_state_hash);
+		_cache_state_valid = true;
+	}
+
 	simplify.initialize(arrays);
 }
 
 Array FastQuadraticMeshSimplifier::get_arrays() {
-	return simplify.get_arrays();
+	if (_cache_result_valid) {
+		return _cache_result.duplicate();
+	}
+
+	Array arrays = simplify.get_arrays();
+
+	//Only the results that are asked for are stored, not every step of a chain of operations
+	if (_cache_store_pending) {
+		_cache_store_pending = false;
+
+		MeshUtils::get_singleton()->get_result_cache()->store(_cache_state_hash, arrays.duplicate());
+	}
+
+	return arrays;
 }
 
 void FastQuadraticMeshSimplifier::simplify_mesh(int target_count, double agressiveness, bool verbose) {
+	CachedOperation op = _cache_create_operation(CACHED_OPERATION_SIMPLIFY_MESH, target_count, agressiveness);
+
+	if (_cache_run_operation(op, verbose)) {
+		return;
+	}
+
 	simplify.simplify_mesh(target_count, agressiveness, verbose);
 }
 
+void FastQuadraticMeshSimplifier::simplify_mesh_to_error(double max_error, double agressiveness, bool verbose) {
+	CachedOperation op = _cache_create_operation(CACHED_OPERATION_SIMPLIFY_MESH_TO_ERROR, 0, agressiveness);
+	op.max_error = max_error;
+
+	if (_cache_run_operation(op, verbose)) {
+		return;
+	}
+
+	simplify.simplify_mesh_to_error(max_error, agressiveness, verbose);
+}
+
+// Relative to the bounding box diagonal, like the max_error of simplify_mesh_to_error()
+double FastQuadraticMeshSimplifier::get_achieved_error() {
+	//Cache hits don't run the collapses
+	_cache_restore_state();
+
+	return simplify.get_achieved_error();
+}
+
+// Simplifies progressively, from the highest ratio to the lowest, so every level only has to continue
+// from the one before it. The levels are returned in the order of target_ratios.
+Array FastQuadraticMeshSimplifier::generate_lods(const Array &target_ratios, double agressiveness, bool verbose) {
+	Array lods;
+	lods.resize(target_ratios.size());
+
+	LocalVector<int> order;
+	order.resize(target_ratios.size());
+
+	for (int i = 0; i < target_ratios.size(); ++i) {
+		int j = i;
+
+		while (j > 0 && (double)target_ratios[order[j - 1]] < (double)target_ratios[i]) {
+			order[j] = order[j - 1];
+			--j;
+		}
+
+		order[j] = i;
+	}
+
+	int triangle_count = _get_triangle_count();
+
+	for (uint32_t i = 0; i < order.size(); ++i) {
+		double ratio = target_ratios[order[i]];
+		int target_count = (int)(MAX(ratio, 0.0) * triangle_count);
+
+		if (target_count < _get_triangle_count()) {
+			simplify_mesh(target_count, agressiveness, verbose);
+		}
+
+		lods[order[i]] = get_arrays();
+	}
+
+	simplify.lod_vertices_share(lods);
+
+	return lods;
+}
+
+// The mesh with n vertices is the first triangle_counts[n] triangles of arrays,
+// with every index i >= n replaced by collapse_map[i] until it is below n.
+Dictionary FastQuadraticMeshSimplifier::get_progressive_mesh() {
+	//The collapses are only recorded when the operations actually run
+	_cache_restore_state();
+
+	Array arrays;
+	PoolVector<int> collapse_map;
+	PoolVector<int> triangle_counts;
+
+	simplify.get_progressive_mesh(arrays, collapse_map, triangle_counts);
+
+	Dictionary mesh;
+
+	mesh["arrays"] = arrays;
+	mesh["collapse_map"] = collapse_map;
+	mesh["triangle_counts"] = triangle_counts;
+
+	return mesh;
+}
+
 void FastQuadraticMeshSimplifier::simplify_mesh_lossless(bool verbose) {
+	CachedOperation op = _cache_create_operation(CACHED_OPERATION_SIMPLIFY_MESH_LOSSLESS, 0, 0);
+
+	if (_cache_run_operation(op, verbose)) {
+		return;
+	}
+
 	simplify.simplify_mesh_lossless(verbose);
 }
 
+// Cache hits leave the simplifier behind, so the cached result is used instead
+int FastQuadraticMeshSimplifier::_get_triangle_count() const {
+	if (_cache_result_valid) {
+		PoolVector<int> indices = _cache_result[ArrayMesh::ARRAY_INDEX];
+		return indices.size() / 3;
+	}
+
+	return simplify.triangles.size();
+}
+
+FastQuadraticMeshSimplifier::CachedOperation FastQuadraticMeshSimplifier::_cache_create_operation(const int p_type, const int p_target_count, const double p_agressiveness) const {
+	CachedOperation op;
+
+	op.type = p_type;
+	op.target_count = p_target_count;
+	op.agressiveness = p_agressiveness;
+	op.max_error = 0;
+
+	op.max_iteration_count = simplify._max_iteration_count;
+	op.max_lossless_iteration_count = simplify._max_lossless_iteration_count;
+	op.enable_smart_link = simplify._enable_smart_link;
+	op.preserve_border_edges = simplify._preserve_border_dges;
+	op.preserve_uv_seam_edges = simplify._preserve_uv_seam_edges;
+	op.preserve_uv_foldover_edges = simplify._preserve_uv_foldover_edges;
+	op.enable_collapse_queue = simplify._enable_collapse_queue;
+	op.format = simplify._format;
+	op.vertex_link_distance = simplify._vertex_link_distance;
+	op.cluster_count = simplify._cluster_count;
+	op.uv_weight = simplify._uv_weight;
+	op.uv2_weight = simplify._uv2_weight;
+	op.color_weight = simplify._color_weight;
+
+	return op;
+}
+
+uint64_t FastQuadraticMeshSimplifier::_cache_hash_operation(const CachedOperation &p_operation, const uint64_t p_seed) const {
+	uint64_t h = MeshResultCache::hash_uint64(p_operation.type, p_seed);
+
+	h = MeshResultCache::hash_uint64(p_operation.target_count, h);
+	h = MeshResultCache::hash_double(p_operation.agressiveness, h);
+	h = MeshResultCache::hash_double(p_operation.max_error, h);
+	h = MeshResultCache::hash_uint64(p_operation.max_iteration_count, h);
+	h = MeshResultCache::hash_uint64(p_operation.max_lossless_iteration_count, h);
+	h = MeshResultCache::hash_uint64(p_operation.enable_smart_link, h);
+	h = MeshResultCache::hash_uint64(p_operation.preserve_border_edges, h);
+	h = MeshResultCache::hash_uint64(p_operation.preserve_uv_seam_edges, h);
+	h = MeshResultCache::hash_uint64(p_operation.preserve_uv_foldover_edges, h);
+	h = MeshResultCache::hash_uint64(p_operation.enable_collapse_queue, h);
+	h = MeshResultCache::hash_uint64(p_operation.format, h);
+	h = MeshResultCache::hash_double(p_operation.vertex_link_distance, h);
+	h = MeshResultCache::hash_uint64(p_operation.cluster_count, h);
+	h = MeshResultCache::hash_double(p_operation.uv_weight, h);
+	h = MeshResultCache::hash_double(p_operation.uv2_weight, h);
+	h = MeshResultCache::hash_double(p_operation.color_weight, h);
+
+	return h;
+}
+
+void FastQuadraticMeshSimplifier::_cache_apply_operation(const CachedOperation &p_operation, const bool p_verbose) {
+	simplify._max_iteration_count = p_operation.max_iteration_count;
+	simplify._max_lossless_iteration_count = p_operation.max_lossless_iteration_count;
+	simplify._enable_smart_link = p_operation.enable_smart_link;
+	simplify._preserve_border_dges = p_operation.preserve_border_edges;
+	simplify._preserve_uv_seam_edges = p_operation.preserve_uv_seam_edges;
+	simplify._preserve_uv_foldover_edges = p_operation.preserve_uv_foldover_edges;
+	simplify._enable_collapse_queue = p_operation.enable_collapse_queue;
+	simplify._format = p_operation.format;
+	simplify._vertex_link_distance = p_operation.vertex_link_distance;
+	simplify._cluster_count = p_operation.cluster_count;
+	simplify._uv_weight = p_operation.uv_weight;
+	simplify._uv2_weight = p_operation.uv2_weight;
+	simplify._color_weight = p_operation.color_weight;
+
+	if (p_operation.type == CACHED_OPERATION_SIMPLIFY_MESH) {
+		simplify.simplify_mesh(p_operation.target_count, p_operation.agressiveness, p_verbose);
+	} else if (p_operation.type == CACHED_OPERATION_SIMPLIFY_MESH_TO_ERROR) {
+		simplify.simplify_mesh_to_error(p_operation.max_error, p_operation.agressiveness, p_verbose);
+	} else {
+		simplify.simplify_mesh_lossless(p_verbose);
+	}
+}
+
+// Returns true if the operation was handled (either from the cache, or by running it, the result is stored
+// by get_arrays()). Returns false if the caller needs to run it without the cache.
+bool FastQuadraticMeshSimplifier::_cache_run_operation(const CachedOperation &p_operation, const bool p_verbose) {
+	_cache_result_valid = false;
+	_cache_store_pending = false;
+	_cache_result = Array();
+
+	if (!_cache_state_valid) {
+		return false;
+	}
+
+	MeshResultCache *cache = MeshUtils::get_singleton()->get_result_cache();
+
+	if (!cache->get_enabled()) {
+		//Got disabled since initialize()
+		_cache_restore_state();
+		_cache_state_valid = false;
+		_cache_operations.clear();
+		return false;
+	}
+
+	uint64_t key = _cache_hash_operation(p_operation, _cache_state_hash);
+
+	Variant cached;
+	if (cache->lookup(key, cached)) {
+		_cache_state_hash = key;
+		_cache_operations.push_back(p_operation);
+		_cache_state_stale = true;
+		_cache_result = cached;
+		_cache_result_valid = true;
+		return true;
+	}
+
+	_cache_restore_state();
+
+	_cache_apply_operation(p_operation, p_verbose);
+
+	_cache_state_hash = key;
+	_cache_operations.push_back(p_operation);
+	_cache_store_pending = true;
+
+	return true;
+}
+
+// Cache hits don't update the simplifier's internal state. If an operation misses after that,
+// bring it up to date by replaying everything since initialize(), so results don't depend on
+// what was cached.
+void FastQuadraticMeshSimplifier::_cache_restore_state() {
+	if (!_cache_state_stale) {
+		return;
+	}
+
+	_cache_state_stale = false;
+
+	CachedOperation current = _cache_create_operation(CACHED_OPERATION_SIMPLIFY_MESH, 0, 0);
+
+	// Record like the initialize() that is replayed did
+	bool record_collapses = simplify._record_collapses;
+	simplify._record_collapses = simplify._recording;
+	simplify.initialize(_cache_input);
+	simplify._record_collapses = record_collapses;
+
+	for (uint32_t i = 0; i < _cache_operations.size(); ++i) {
+		_cache_apply_operation(_cache_operations[i], false);
+	}
+
+	simplify._max_iteration_count = current.max_iteration_count;
+	simplify._max_lossless_iteration_count = current.max_lossless_iteration_count;
+	simplify._enable_smart_link = current.enable_smart_link;
+	simplify._preserve_border_dges = current.preserve_border_edges;
+	simplify._preserve_uv_seam_edges = current.preserve_uv_seam_edges;
+	simplify._preserve_uv_foldover_edges = current.preserve_uv_foldover_edges;
+	simplify._enable_collapse_queue = current.enable_collapse_queue;
+	simplify._format = current.format;
+	simplify._vertex_link_distance = current.vertex_link_distance;
+	simplify._cluster_count = current.cluster_count;
+	simplify._uv_weight = current.uv_weight;
+	simplify._uv2_weight = current.uv2_weight;
+	simplify._color_weight = current.color_weight;
+}
+
 FastQuadraticMeshSimplifier::FastQuadraticMeshSimplifier() {
+	_cache_state_valid = false;
+	_cache_state_stale = false;
+	_cache_result_valid = false;
+	_cache_store_pending = false;
+	_cache_state_hash = 0;
 }
 
 FastQuadraticMeshSimplifier::~FastQuadraticMeshSimplifier() {
 }
 
 void FastQuadraticMeshSimplifier::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("reset"), &FastQuadraticMeshSimplifier::reset);
 	ClassDB::bind_method(D_METHOD("initialize", "arrays"), &FastQuadraticMeshSimplifier::initialize);
 	ClassDB::bind_method(D_METHOD("get_arrays"), &FastQuadraticMeshSimplifier::get_arrays);
 	ClassDB::bind_method(D_METHOD("simplify_mesh", "target_count", "agressiveness", "verbose"), &FastQuadraticMeshSimplifier::simplify_mesh, DEFVAL(7), DEFVAL(false));
 	ClassDB::bind_method(D_METHOD("simplify_mesh_lossless", "verbose"), &FastQuadraticMeshSimplifier::simplify_mesh_lossless, DEFVAL(false));
+	ClassDB::bind_method(D_METHOD("simplify_mesh_to_error", "max_error", "agressiveness", "verbose"), &FastQuadraticMeshSimplifier::simplify_mesh_to_error, DEFVAL(7), DEFVAL(false));
+	ClassDB::bind_method(D_METHOD("get_achieved_error"), &FastQuadraticMeshSimplifier::get_achieved_error);
+	ClassDB::bind_method(D_METHOD("generate_lods", "target_ratios", "agressiveness", "verbose"), &FastQuadraticMeshSimplifier::generate_lods, DEFVAL(7), DEFVAL(false));
+	ClassDB::bind_method(D_METHOD("get_progressive_mesh"), &FastQuadraticMeshSimplifier::get_progressive_mesh);
 
 	ClassDB::bind_method(D_METHOD("get_max_iteration_count"), &FastQuadraticMeshSimplifier::get_max_iteration_count);
 	ClassDB::bind_method(D_METHOD("set_max_iteration_count", "value"), &FastQuadraticMeshSimplifier::set_max_iteration_count);
@@ -125,6 +480,34 @@ void FastQuadraticMeshSimplifier::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_preserve_uv_foldover_edges", "value"), &FastQuadraticMeshSimplifier::set_preserve_uv_foldover_edges);
 	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "preserve_uv_foldover_edges"), "set_preserve_uv_foldover_edges", "get_preserve_uv_foldover_edges");
 
+	ClassDB::bind_method(D_METHOD("get_enable_collapse_queue"), &FastQuadraticMeshSimplifier::get_enable_collapse_queue);
+	ClassDB::bind_method(D_METHOD("set_enable_collapse_queue", "value"), &FastQuadraticMeshSimplifier::set_enable_collapse_queue);
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "enable_collapse_queue"), "set_enable_collapse_queue", "get_enable_collapse_queue");
+
+	ClassDB::bind_method(D_METHOD("get_vertex_link_distance"), &FastQuadraticMeshSimplifier::get_vertex_link_distance);
+	ClassDB::bind_method(D_METHOD("set_vertex_link_distance", "value"), &FastQuadraticMeshSimplifier::set_vertex_link_distance);
+	ADD_PROPERTY(PropertyInfo(Variant::REAL, "vertex_link_distance"), "set_vertex_link_distance", "get_vertex_link_distance");
+
+	ClassDB::bind_method(D_METHOD("get_cluster_count"), &FastQuadraticMeshSimplifier::get_cluster_count);
+	ClassDB::bind_method(D_METHOD("set_cluster_count", "value"), &FastQuadraticMeshSimplifier::set_cluster_count);
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "cluster_count"), "set_cluster_count", "get_cluster_count");
+
+	ClassDB::bind_method(D_METHOD("get_record_collapses"), &FastQuadraticMeshSimplifier::get_record_collapses);
+	ClassDB::bind_method(D_METHOD("set_record_collapses", "value"), &FastQuadraticMeshSimplifier::set_record_collapses);
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "record_collapses"), "set_record_collapses", "get_record_collapses");
+
+	ClassDB::bind_method(D_METHOD("get_uv_weight"), &FastQuadraticMeshSimplifier::get_uv_weight);
+	ClassDB::bind_method(D_METHOD("set_uv_weight", "value"), &FastQuadraticMeshSimplifier::set_uv_weight);
+	ADD_PROPERTY(PropertyInfo(Variant::REAL, "uv_weight"), "set_uv_weight", "get_uv_weight");
+
+	ClassDB::bind_method(D_METHOD("get_uv2_weight"), &FastQuadraticMeshSimplifier::get_uv2_weight);
+	ClassDB::bind_method(D_METHOD("set_uv2_weight", "value"), &FastQuadraticMeshSimplifier::set_uv2_weight);
+	ADD_PROPERTY(PropertyInfo(Variant::REAL, "uv2_weight"), "set_uv2_weight", "get_uv2_weight");
+
+	ClassDB::bind_method(D_METHOD("get_color_weight"), &FastQuadraticMeshSimplifier::get_color_weight);
+	ClassDB::bind_method(D_METHOD("set_color_weight", "value"), &FastQuadraticMeshSimplifier::set_color_weight);
+	ADD_PROPERTY(PropertyInfo(Variant::REAL, "color_weight"), "set_color_weight", "get_color_weight");
+
 	ClassDB::bind_method(D_METHOD("get_format"), &FastQuadraticMeshSimplifier::get_format);
 	ClassDB::bind_method(D_METHOD("set_format", "value"), &FastQuadraticMeshSimplifier::set_format);
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "format"), "set_format", "get_format");
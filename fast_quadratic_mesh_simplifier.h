@@ -32,10 +32,14 @@ SOFTWARE.
 #ifndef Reference
 #define Reference RefCounted
 #endif
+#include "core/templates/local_vector.h"
 #include "core/variant/array.h"
+#include "core/variant/dictionary.h"
 #else
+#include "core/local_vector.h"
 #include "core/reference.h"
 #include "core/array.h"
+#include "core/dictionary.h"
 #endif
 
 #include "simplify.h"
@@ -62,13 +66,39 @@ public:
 	bool get_preserve_uv_foldover_edges() const;
 	void set_preserve_uv_foldover_edges(const bool value);
 
+	bool get_enable_collapse_queue() const;
+	void set_enable_collapse_queue(const bool value);
+
+	double get_vertex_link_distance() const;
+	void set_vertex_link_distance(const double value);
+
+	int get_cluster_count() const;
+	void set_cluster_count(const int value);
+
+	bool get_record_collapses() const;
+	void set_record_collapses(const bool value);
+
+	double get_uv_weight() const;
+	void set_uv_weight(const double value);
+
+	double get_uv2_weight() const;
+	void set_uv2_weight(const double value);
+
+	double get_color_weight() const;
+	void set_color_weight(const double value);
+
 	int get_format() const;
 	void set_format(const int value);
 
+	void reset();
 	void initialize(const Array &arrays);
 	Array get_arrays();
 	void simplify_mesh(int target_count, double agressiveness = 7, bool verbose = false);
 	void simplify_mesh_lossless(bool verbose = false);
+	void simplify_mesh_to_error(double max_error, double agressiveness = 7, bool verbose = false);
+	double get_achieved_error();
+	Array generate_lods(const Array &target_ratios, double agressiveness = 7, bool verbose = false);
+	Dictionary get_progressive_mesh();
 
 	FastQuadraticMeshSimplifier();
 	~FastQuadraticMeshSimplifier();
@@ -77,7 +107,54 @@ protected:
 	static void _bind_methods();
 
 private:
+	enum CachedOperationType {
+		CACHED_OPERATION_SIMPLIFY_MESH = 0,
+		CACHED_OPERATION_SIMPLIFY_MESH_LOSSLESS,
+		CACHED_OPERATION_SIMPLIFY_MESH_TO_ERROR,
+	};
+
+	// An operation, and the settings it ran with, so results can be reproduced
+	// when a cache hit skipped running it.
+	struct CachedOperation {
+		int type;
+		int target_count;
+		double agressiveness;
+		double max_error;
+
+		int max_iteration_count;
+		int max_lossless_iteration_count;
+		bool enable_smart_link;
+		bool preserve_border_edges;
+		bool preserve_uv_seam_edges;
+		bool preserve_uv_foldover_edges;
+		bool enable_collapse_queue;
+		int format;
+		double vertex_link_distance;
+		int cluster_count;
+		double uv_weight;
+		double uv2_weight;
+		double color_weight;
+	};
+
+	CachedOperation _cache_create_operation(const int p_type, const int p_target_count, const double p_agressiveness) const;
+	uint64_t _cache_hash_operation(const CachedOperation &p_operation, const uint64_t p_seed) const;
+	void _cache_apply_operation(const CachedOperation &p_operation, const bool p_verbose);
+	bool _cache_run_operation(const CachedOperation &p_operation, const bool p_verbose);
+	void _cache_restore_state();
+
+	int _get_triangle_count() const;
+
 	Simplify::FQMS simplify;
+
+	bool _cache_state_valid;
+	bool _cache_state_stale;
+	bool _cache_result_valid;
+	//A miss ran the operations, the result is stored under _cache_state_hash when get_arrays() asks for it
+	bool _cache_store_pending;
+	uint64_t _cache_state_hash;
+	Array _cache_input;
+	Array _cache_result;
+	LocalVector<CachedOperation> _cache_operations;
 };
 
 #endif
@@ -0,0 +1,912 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "incremental_uv_atlas.h"
+
+#include "scene/resources/mesh.h"
+
+#include "xatlas/xatlas.h"
+#include "xatlas_arena.h"
+
+static _FORCE_INLINE_ int popcount64(uint64_t p_value) {
+	p_value = p_value - ((p_value >> 1) & 0x5555555555555555ULL);
+	p_value = (p_value & 0x3333333333333333ULL) + ((p_value >> 2) & 0x3333333333333333ULL);
+	p_value = (p_value + (p_value >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (p_value * 0x0101010101010101ULL) >> 56;
+}
+
+//p_value can't be 0
+static _FORCE_INLINE_ int lowest_bit64(uint64_t p_value) {
+	return popcount64((p_value & (~p_value + 1)) - 1);
+}
+
+static _FORCE_INLINE_ uint64_t reverse_bits64(uint64_t p_value) {
+	p_value = ((p_value >> 1) & 0x5555555555555555ULL) | ((p_value & 0x5555555555555555ULL) << 1);
+	p_value = ((p_value >> 2) & 0x3333333333333333ULL) | ((p_value & 0x3333333333333333ULL) << 2);
+	p_value = ((p_value >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((p_value & 0x0F0F0F0F0F0F0F0FULL) << 4);
+	p_value = ((p_value >> 8) & 0x00FF00FF00FF00FFULL) | ((p_value & 0x00FF00FF00FF00FFULL) << 8);
+	p_value = ((p_value >> 16) & 0x0000FFFF0000FFFFULL) | ((p_value & 0x0000FFFF0000FFFFULL) << 16);
+	return (p_value >> 32) | (p_value << 32);
+}
+
+int IncrementalUVAtlas::get_width() const {
+	return _width;
+}
+void IncrementalUVAtlas::set_width(const int value) {
+	ERR_FAIL_COND(value <= 0);
+	ERR_FAIL_COND_MSG(!_entries.is_empty(), "IncrementalUVAtlas: The size can't be changed while the atlas has meshes, call clear() first.");
+
+	_width = value;
+
+	_clear_occupancy();
+	_clear_freed();
+}
+
+int IncrementalUVAtlas::get_height() const {
+	return _height;
+}
+void IncrementalUVAtlas::set_height(const int value) {
+	ERR_FAIL_COND(value <= 0);
+	ERR_FAIL_COND_MSG(!_entries.is_empty(), "IncrementalUVAtlas: The size can't be changed while the atlas has meshes, call clear() first.");
+
+	_height = value;
+
+	_clear_occupancy();
+	_clear_freed();
+}
+
+float IncrementalUVAtlas::get_texel_size() const {
+	return _texel_size;
+}
+void IncrementalUVAtlas::set_texel_size(const float value) {
+	ERR_FAIL_COND(value <= 0);
+
+	_texel_size = value;
+}
+
+int IncrementalUVAtlas::get_padding() const {
+	return _padding;
+}
+void IncrementalUVAtlas::set_padding(const int value) {
+	ERR_FAIL_COND(value < 0);
+
+	_padding = value;
+}
+
+float IncrementalUVAtlas::get_fragmentation_threshold() const {
+	return _fragmentation_threshold;
+}
+void IncrementalUVAtlas::set_fragmentation_threshold(const float value) {
+	_fragmentation_threshold = value;
+}
+
+int IncrementalUVAtlas::add_mesh(Array arr) {
+	Entry entry;
+
+	if (!_unwrap(arr, entry)) {
+		return -1;
+	}
+
+	if (get_fragmentation() > _fragmentation_threshold) {
+		_repack();
+	}
+
+	int id = _next_id++;
+
+	Entry &e = _entries.insert(id, entry)->value;
+
+	LocalVector<Chart *> charts;
+	int64_t area = 0;
+
+	for (uint32_t i = 0; i < e.charts.size(); ++i) {
+		charts.push_back(&e.charts[i]);
+		area += e.charts[i].area;
+	}
+
+	if (_place_all(charts)) {
+		_used_area += area;
+
+		for (uint32_t i = 0; i < charts.size(); ++i) {
+			_freed_area -= _freed_update(*charts[i], false);
+		}
+
+		return id;
+	}
+
+	//Doesn't fit into the free space as it is
+	for (uint32_t i = 0; i < charts.size(); ++i) {
+		Chart *c = charts[i];
+
+		if (c->x != -1) {
+			_blit(*c, false);
+
+			c->x = -1;
+			c->y = -1;
+		}
+	}
+
+	if (!_repack()) {
+		_entries.erase(id);
+
+		ERR_FAIL_V_MSG(-1, "IncrementalUVAtlas: The mesh doesn't fit into the atlas.");
+	}
+
+	return id;
+}
+
+void IncrementalUVAtlas::remove_mesh(const int p_id) {
+	HashMap<int, Entry>::Iterator e = _entries.find(p_id);
+
+	ERR_FAIL_COND(!e);
+
+	for (uint32_t i = 0; i < e->value.charts.size(); ++i) {
+		const Chart &c = e->value.charts[i];
+
+		if (c.x != -1) {
+			_blit(c, false);
+
+			_used_area -= c.area;
+			_freed_area += _freed_update(c, true);
+		}
+	}
+
+	_entries.remove(e);
+}
+
+bool IncrementalUVAtlas::has_mesh(const int p_id) const {
+	return _entries.has(p_id);
+}
+
+PoolVector2Array IncrementalUVAtlas::get_uvs(const int p_id) const {
+	HashMap<int, Entry>::ConstIterator e = _entries.find(p_id);
+
+	ERR_FAIL_COND_V(!e, PoolVector2Array());
+
+	const Entry &entry = e->value;
+
+	PoolVector2Array uvs;
+	uvs.resize(entry.vertex_charts.size());
+	Vector2 *w = uvs.ptrw();
+
+	for (uint32_t i = 0; i < entry.vertex_charts.size(); ++i) {
+		int ci = entry.vertex_charts[i];
+
+		if (ci == -1) {
+			w[i] = Vector2();
+			continue;
+		}
+
+		const Chart &c = entry.charts[ci];
+		const Vector2 &uv = entry.vertex_uvs[i];
+
+		w[i] = Vector2((c.x + uv.x) / _width, (c.y + uv.y) / _height);
+	}
+
+	return uvs;
+}
+
+Array IncrementalUVAtlas::get_mesh_ids() const {
+	Array ids;
+
+	for (const KeyValue<int, Entry> &E : _entries) {
+		ids.push_back(E.key);
+	}
+
+	return ids;
+}
+
+int IncrementalUVAtlas::get_mesh_count() const {
+	return _entries.size();
+}
+
+float IncrementalUVAtlas::get_utilization() const {
+	return static_cast<double>(_used_area) / (static_cast<double>(_width) * _height);
+}
+
+float IncrementalUVAtlas::get_fragmentation() const {
+	if (_freed_area == 0) {
+		return 0;
+	}
+
+	int max_x = 0;
+	int max_y = 0;
+
+	for (const KeyValue<int, Entry> &E : _entries) {
+		for (uint32_t i = 0; i < E.value.charts.size(); ++i) {
+			const Chart &c = E.value.charts[i];
+
+			if (c.x != -1) {
+				max_x = MAX(max_x, c.x + c.width);
+				max_y = MAX(max_y, c.y + c.height);
+			}
+		}
+	}
+
+	if (max_x == 0 || max_y == 0) {
+		//Everything got removed
+		return 0;
+	}
+
+	return MIN(static_cast<double>(_freed_area) / (static_cast<double>(max_x) * max_y), 1.0);
+}
+
+bool IncrementalUVAtlas::repack() {
+	return _repack();
+}
+
+void IncrementalUVAtlas::clear() {
+	_entries.clear();
+	_used_area = 0;
+
+	_clear_occupancy();
+	_clear_freed();
+}
+
+// Unwraps the mesh with xatlas, and extracts a mask for every chart from xatlas' atlas image.
+// (xatlas' BitImage is internal to xatlas.cpp, so the masks are kept here.)
+bool IncrementalUVAtlas::_unwrap(const Array &p_arrays, Entry &r_entry) const {
+	ERR_FAIL_COND_V(p_arrays.size() != Mesh::ARRAY_MAX, false);
+
+	Vector<Vector3> rvertices = p_arrays[Mesh::ARRAY_VERTEX];
+	Vector<Vector3> rnormals = p_arrays[Mesh::ARRAY_NORMAL];
+	Vector<int> rindices = p_arrays[Mesh::ARRAY_INDEX];
+
+	int vc = rvertices.size();
+	int ic = rindices.size();
+
+	ERR_FAIL_COND_V(vc == 0, false);
+	ERR_FAIL_COND_V(rnormals.size() != 0 && rnormals.size() != vc, false);
+
+	const Vector3 *r = rvertices.ptr();
+	const Vector3 *rn = rnormals.ptr();
+
+	LocalVector<float> vertices;
+	LocalVector<float> normals;
+
+	vertices.resize(vc * 3);
+
+	if (rnormals.size() > 0) {
+		normals.resize(vc * 3);
+	}
+
+	for (int i = 0; i < vc; ++i) {
+		vertices[i * 3 + 0] = r[i].x;
+		vertices[i * 3 + 1] = r[i].y;
+		vertices[i * 3 + 2] = r[i].z;
+
+		if (rn) {
+			normals[i * 3 + 0] = rn[i].x;
+			normals[i * 3 + 1] = rn[i].y;
+			normals[i * 3 + 2] = rn[i].z;
+		}
+	}
+
+	LocalVector<uint32_t> indices;
+
+	if (ic == 0) {
+		indices.resize(vc);
+
+		for (int i = 0; i < vc; ++i) {
+			indices[i] = i;
+		}
+	} else {
+		const int *ri = rindices.ptr();
+
+		indices.resize(ic);
+
+		for (int i = 0; i < ic; ++i) {
+			ERR_FAIL_INDEX_V(ri[i], vc, false);
+
+			indices[i] = ri[i];
+		}
+	}
+
+	xatlas_mu::MeshDecl input_mesh;
+	input_mesh.indexData = indices.ptr();
+	input_mesh.indexCount = indices.size();
+	input_mesh.indexFormat = xatlas_mu::IndexFormat::UInt32;
+	input_mesh.vertexCount = vc;
+	input_mesh.vertexPositionData = vertices.ptr();
+	input_mesh.vertexPositionStride = sizeof(float) * 3;
+
+	if (normals.size() > 0) {
+		input_mesh.vertexNormalData = normals.ptr();
+		input_mesh.vertexNormalStride = sizeof(float) * 3;
+	}
+
+	xatlas_mu::ChartOptions chart_options;
+	chart_options.fixWinding = false;
+
+	xatlas_mu::PackOptions pack_options;
+	pack_options.padding = _padding;
+	pack_options.texelsPerUnit = 1.0 / _texel_size;
+	//Every chart has to fit into the atlas, padding, and the bilinear border included
+	pack_options.maxChartSize = MAX(MIN(_width, _height) - 2 * _padding - 2, 1);
+	pack_options.createImage = true;
+
+	XatlasArena::Scope arena_scope;
+
+	xatlas_mu::Atlas *atlas = xatlas_mu::Create();
+
+	xatlas_mu::AddMeshError err = xatlas_mu::AddMesh(atlas, input_mesh, 1);
+
+	if (err != xatlas_mu::AddMeshError::Success) {
+		xatlas_mu::Destroy(atlas);
+		ERR_FAIL_V_MSG(false, xatlas_mu::StringForEnum(err));
+	}
+
+	xatlas_mu::Generate(atlas, chart_options, pack_options);
+
+	if (atlas->width == 0 || atlas->height == 0 || !atlas->image) {
+		xatlas_mu::Destroy(atlas);
+		ERR_FAIL_V_MSG(false, "IncrementalUVAtlas: The mesh has no area.");
+	}
+
+	const int iw = atlas->width;
+	const int ih = atlas->height;
+	const uint32_t *image = atlas->image;
+	const xatlas_mu::Mesh &output = atlas->meshes[0];
+	const int chart_count = atlas->chartCount;
+
+	//Bounds of the charts, without the padding
+	LocalVector<int> min_x;
+	LocalVector<int> min_y;
+	LocalVector<int> max_x;
+	LocalVector<int> max_y;
+	min_x.resize(chart_count);
+	min_y.resize(chart_count);
+	max_x.resize(chart_count);
+	max_y.resize(chart_count);
+
+	for (int i = 0; i < chart_count; ++i) {
+		min_x[i] = INT32_MAX;
+		min_y[i] = INT32_MAX;
+		max_x[i] = INT32_MIN;
+		max_y[i] = INT32_MIN;
+	}
+
+	for (int y = 0; y < ih; ++y) {
+		for (int x = 0; x < iw; ++x) {
+			uint32_t d = image[x + y * iw];
+
+			if (!(d & xatlas_mu::kImageHasChartIndexBit) || (d & xatlas_mu::kImageIsPaddingBit)) {
+				continue;
+			}
+
+			int c = d & xatlas_mu::kImageChartIndexMask;
+
+			min_x[c] = MIN(min_x[c], x);
+			min_y[c] = MIN(min_y[c], y);
+			max_x[c] = MAX(max_x[c], x);
+			max_y[c] = MAX(max_y[c], y);
+		}
+	}
+
+	//The vertices have to end up inside too
+	for (uint32_t i = 0; i < output.vertexCount; ++i) {
+		const xatlas_mu::Vertex &v = output.vertexArray[i];
+
+		if (v.chartIndex < 0) {
+			continue;
+		}
+
+		int c = v.chartIndex;
+
+		min_x[c] = MIN(min_x[c], static_cast<int>(Math::floor(v.uv[0])));
+		min_y[c] = MIN(min_y[c], static_cast<int>(Math::floor(v.uv[1])));
+		max_x[c] = MAX(max_x[c], static_cast<int>(Math::floor(v.uv[0])));
+		max_y[c] = MAX(max_y[c], static_cast<int>(Math::floor(v.uv[1])));
+	}
+
+	r_entry.charts.resize(chart_count);
+
+	LocalVector<uint8_t> cells;
+	LocalVector<uint8_t> dilated;
+
+	for (int c = 0; c < chart_count; ++c) {
+		Chart &chart = r_entry.charts[c];
+
+		if (min_x[c] > max_x[c]) {
+			//Has no texels, and no vertices, nothing to place
+			continue;
+		}
+
+		const int ox = min_x[c] - _padding;
+		const int oy = min_y[c] - _padding;
+		const int w = max_x[c] - min_x[c] + 1 + 2 * _padding;
+		const int h = max_y[c] - min_y[c] + 1 + 2 * _padding;
+
+		cells.resize(w * h);
+		memset(cells.ptr(), 0, w * h);
+
+		for (int y = MAX(oy, 0); y < MIN(oy + h, ih); ++y) {
+			for (int x = MAX(ox, 0); x < MIN(ox + w, iw); ++x) {
+				uint32_t d = image[x + y * iw];
+
+				if ((d & xatlas_mu::kImageHasChartIndexBit) && !(d & xatlas_mu::kImageIsPaddingBit) && static_cast<int>(d & xatlas_mu::kImageChartIndexMask) == c) {
+					cells[(x - ox) + (y - oy) * w] = 1;
+				}
+			}
+		}
+
+		for (uint32_t i = 0; i < output.vertexCount; ++i) {
+			const xatlas_mu::Vertex &v = output.vertexArray[i];
+
+			if (v.chartIndex == c) {
+				cells[(static_cast<int>(Math::floor(v.uv[0])) - ox) + (static_cast<int>(Math::floor(v.uv[1])) - oy) * w] = 1;
+			}
+		}
+
+		//xatlas' own padding can get cut off at the edges of its image, so it's redone here
+		if (_padding > 0) {
+			dilated.resize(w * h);
+
+			for (int y = 0; y < h; ++y) {
+				for (int x = 0; x < w; ++x) {
+					uint8_t s = 0;
+
+					for (int xx = MAX(x - _padding, 0); xx <= MIN(x + _padding, w - 1) && !s; ++xx) {
+						s = cells[xx + y * w];
+					}
+
+					dilated[x + y * w] = s;
+				}
+			}
+
+			for (int y = 0; y < h; ++y) {
+				for (int x = 0; x < w; ++x) {
+					uint8_t s = 0;
+
+					for (int yy = MAX(y - _padding, 0); yy <= MIN(y + _padding, h - 1) && !s; ++yy) {
+						s = dilated[x + yy * w];
+					}
+
+					cells[x + y * w] = s;
+				}
+			}
+		}
+
+		chart.width = w;
+		chart.height = h;
+		chart.row_words = (w + 63) / 64;
+		chart.mask.resize(chart.row_words * h);
+		memset(chart.mask.ptr(), 0, chart.mask.size() * sizeof(uint64_t));
+
+		for (int y = 0; y < h; ++y) {
+			for (int x = 0; x < w; ++x) {
+				if (cells[x + y * w]) {
+					chart.mask[y * chart.row_words + (x >> 6)] |= uint64_t(1) << (x & 63);
+					chart.area++;
+				}
+			}
+		}
+
+		//The origin of the chart in xatlas' image is stored in x, y until the chart gets placed
+		chart.x = ox;
+		chart.y = oy;
+	}
+
+	r_entry.vertex_charts.resize(vc);
+	r_entry.vertex_uvs.resize(vc);
+
+	for (int i = 0; i < vc; ++i) {
+		r_entry.vertex_charts[i] = -1;
+	}
+
+	for (uint32_t i = 0; i < output.vertexCount; ++i) {
+		const xatlas_mu::Vertex &v = output.vertexArray[i];
+
+		if (v.chartIndex < 0) {
+			continue;
+		}
+
+		const Chart &chart = r_entry.charts[v.chartIndex];
+
+		r_entry.vertex_charts[v.xref] = v.chartIndex;
+		r_entry.vertex_uvs[v.xref] = Vector2(v.uv[0] - chart.x, v.uv[1] - chart.y);
+	}
+
+	for (int c = 0; c < chart_count; ++c) {
+		r_entry.charts[c].x = -1;
+		r_entry.charts[c].y = -1;
+	}
+
+	xatlas_mu::Destroy(atlas);
+
+	return true;
+}
+
+bool IncrementalUVAtlas::_fits(const Chart &p_chart, const int p_x, const int p_y) const {
+	const int word = p_x >> 6;
+	const int shift = p_x & 63;
+
+	for (int y = 0; y < p_chart.height; ++y) {
+		const uint64_t *atlas_row = &_occupancy[(p_y + y) * _row_words + word];
+		const uint64_t *mask_row = &p_chart.mask[y * p_chart.row_words];
+
+		for (int i = 0; i < p_chart.row_words; ++i) {
+			const uint64_t m = mask_row[i];
+
+			if (!m) {
+				continue;
+			}
+
+			if (atlas_row[i] & (m << shift)) {
+				return false;
+			}
+
+			//If this is not 0, the next word is inside the atlas
+			if (shift && (m >> (64 - shift)) && (atlas_row[i + 1] & (m >> (64 - shift)))) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+void IncrementalUVAtlas::_blit(const Chart &p_chart, const bool p_set) {
+	const int word = p_chart.x >> 6;
+	const int shift = p_chart.x & 63;
+
+	for (int y = 0; y < p_chart.height; ++y) {
+		uint64_t *atlas_row = &_occupancy[(p_chart.y + y) * _row_words + word];
+		const uint64_t *mask_row = &p_chart.mask[y * p_chart.row_words];
+
+		for (int i = 0; i < p_chart.row_words; ++i) {
+			const uint64_t m = mask_row[i];
+
+			if (!m) {
+				continue;
+			}
+
+			//Charts never overlap, so every texel of the mask changes
+			_row_free[p_chart.y + y] += p_set ? -popcount64(m) : popcount64(m);
+
+			const uint64_t lo = m << shift;
+			const uint64_t hi = shift ? (m >> (64 - shift)) : 0;
+
+			if (p_set) {
+				atlas_row[i] |= lo;
+
+				if (hi) {
+					atlas_row[i + 1] |= hi;
+				}
+			} else {
+				atlas_row[i] &= ~lo;
+
+				if (hi) {
+					atlas_row[i + 1] &= ~hi;
+				}
+			}
+		}
+	}
+}
+
+// First fit, row by row.
+// Rows that don't have enough free texels for the chart are skipped. In a row, the position jumps ahead until
+// the first and the last texel of every row of the chart land on free texels, skipping occupied words at once,
+// and only those positions are tested.
+bool IncrementalUVAtlas::_place(Chart &p_chart) {
+	if (p_chart.area == 0) {
+		p_chart.x = 0;
+		p_chart.y = 0;
+		return true;
+	}
+
+	//Texel count, first and last texel of every row of the chart
+	LocalVector<int> row_areas;
+	LocalVector<int> row_firsts;
+	LocalVector<int> row_lasts;
+	row_areas.resize(p_chart.height);
+	row_firsts.resize(p_chart.height);
+	row_lasts.resize(p_chart.height);
+
+	for (int y = 0; y < p_chart.height; ++y) {
+		row_areas[y] = 0;
+		row_firsts[y] = -1;
+		row_lasts[y] = -1;
+
+		for (int i = 0; i < p_chart.row_words; ++i) {
+			const uint64_t m = p_chart.mask[y * p_chart.row_words + i];
+
+			if (!m) {
+				continue;
+			}
+
+			row_areas[y] += popcount64(m);
+
+			if (row_firsts[y] == -1) {
+				row_firsts[y] = i * 64 + lowest_bit64(m);
+			}
+
+			row_lasts[y] = i * 64 + 63 - lowest_bit64(reverse_bits64(m));
+		}
+	}
+
+
+	const int max_x = _width - p_chart.width;
+
+	for (int y = 0; y <= _height - p_chart.height; ++y) {
+		bool enough = true;
+
+		for (int j = 0; j < p_chart.height && enough; ++j) {
+			enough = row_areas[j] <= _row_free[y + j];
+		}
+
+		if (!enough) {
+			continue;
+		}
+
+		int x = 0;
+
+		while (x <= max_x) {
+			int start_x = x;
+
+			for (int j = 0; j < p_chart.height && x <= max_x; ++j) {
+				if (row_areas[j] == 0) {
+					continue;
+				}
+
+				x = _next_free(y + j, x + row_firsts[j]) - row_firsts[j];
+
+				if (x <= max_x) {
+					x = _next_free(y + j, x + row_lasts[j]) - row_lasts[j];
+				}
+			}
+
+			if (x > max_x) {
+				break;
+			}
+
+			if (x != start_x) {
+				//Moved, so the rows before have to be checked again
+				continue;
+			}
+
+			if (_fits(p_chart, x, y)) {
+				p_chart.x = x;
+				p_chart.y = y;
+
+				_blit(p_chart, true);
+
+				return true;
+			}
+
+			++x;
+		}
+	}
+
+	return false;
+}
+
+// The first free texel of the row at or after p_x, or the width if there is none.
+int IncrementalUVAtlas::_next_free(const int p_y, const int p_x) const {
+	if (p_x >= _width) {
+		return _width;
+	}
+
+	const uint64_t *row = &_occupancy[p_y * _row_words];
+	int word = p_x >> 6;
+	uint64_t free_bits = ~row[word] & (~uint64_t(0) << (p_x & 63));
+
+	while (!free_bits && ++word < _row_words) {
+		free_bits = ~row[word];
+	}
+
+	if (!free_bits) {
+		return _width;
+	}
+
+	return MIN(word * 64 + lowest_bit64(free_bits), _width);
+}
+
+// Largest first. Stops at the first chart that doesn't fit.
+bool IncrementalUVAtlas::_place_all(LocalVector<Chart *> &p_charts) {
+	p_charts.sort_custom<ChartAreaComparator>();
+
+	for (uint32_t i = 0; i < p_charts.size(); ++i) {
+		if (!_place(*p_charts[i])) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Places every chart again. If that fails, the atlas stays as it was.
+bool IncrementalUVAtlas::_repack() {
+	LocalVector<Chart *> charts;
+	LocalVector<Vector2i> positions;
+
+	for (KeyValue<int, Entry> &E : _entries) {
+		for (uint32_t i = 0; i < E.value.charts.size(); ++i) {
+			Chart *c = &E.value.charts[i];
+
+			charts.push_back(c);
+			positions.push_back(Vector2i(c->x, c->y));
+
+			c->x = -1;
+			c->y = -1;
+		}
+	}
+
+	_clear_occupancy();
+
+	if (!_place_all(charts)) {
+		//charts got sorted, so the positions have to be restored in the original order
+		_clear_occupancy();
+
+		uint32_t index = 0;
+		for (KeyValue<int, Entry> &E : _entries) {
+			for (uint32_t i = 0; i < E.value.charts.size(); ++i) {
+				Chart &c = E.value.charts[i];
+				const Vector2i &p = positions[index++];
+
+				c.x = p.x;
+				c.y = p.y;
+
+				if (c.x != -1 && c.area > 0) {
+					_blit(c, true);
+				}
+			}
+		}
+
+		return false;
+	}
+
+	_used_area = 0;
+
+	_clear_freed();
+
+	for (uint32_t i = 0; i < charts.size(); ++i) {
+		_used_area += charts[i]->area;
+	}
+
+	emit_signal("repacked");
+
+	return true;
+}
+
+void IncrementalUVAtlas::_clear_occupancy() {
+	_row_words = (_width + 63) / 64;
+	_occupancy.resize(_row_words * _height);
+	_row_free.resize(_height);
+
+	if (_occupancy.size() > 0) {
+		memset(_occupancy.ptr(), 0, _occupancy.size() * sizeof(uint64_t));
+	}
+
+	for (int y = 0; y < _height; ++y) {
+		_row_free[y] = _width;
+	}
+}
+
+// Marks the texels of a placed chart as freed, or as reused. Returns how many texels changed.
+int IncrementalUVAtlas::_freed_update(const Chart &p_chart, const bool p_freed) {
+	if (p_chart.area == 0) {
+		return 0;
+	}
+
+	const int word = p_chart.x >> 6;
+	const int shift = p_chart.x & 63;
+	int changed = 0;
+
+	for (int y = 0; y < p_chart.height; ++y) {
+		uint64_t *freed_row = &_freed[(p_chart.y + y) * _row_words + word];
+		const uint64_t *mask_row = &p_chart.mask[y * p_chart.row_words];
+
+		for (int i = 0; i < p_chart.row_words; ++i) {
+			const uint64_t m = mask_row[i];
+
+			if (!m) {
+				continue;
+			}
+
+			const uint64_t lo = m << shift;
+			const uint64_t hi = shift ? (m >> (64 - shift)) : 0;
+
+			if (p_freed) {
+				changed += popcount64(lo & ~freed_row[i]);
+				freed_row[i] |= lo;
+
+				if (hi) {
+					changed += popcount64(hi & ~freed_row[i + 1]);
+					freed_row[i + 1] |= hi;
+				}
+			} else {
+				changed += popcount64(lo & freed_row[i]);
+				freed_row[i] &= ~lo;
+
+				if (hi) {
+					changed += popcount64(hi & freed_row[i + 1]);
+					freed_row[i + 1] &= ~hi;
+				}
+			}
+		}
+	}
+
+	return changed;
+}
+
+void IncrementalUVAtlas::_clear_freed() {
+	_freed.resize(((_width + 63) / 64) * _height);
+	_freed_area = 0;
+
+	if (_freed.size() > 0) {
+		memset(_freed.ptr(), 0, _freed.size() * sizeof(uint64_t));
+	}
+}
+
+IncrementalUVAtlas::IncrementalUVAtlas() {
+	_width = 1024;
+	_height = 1024;
+	_texel_size = 0.05;
+	_padding = 1;
+	_fragmentation_threshold = 0.25;
+	_used_area = 0;
+	_next_id = 0;
+
+	_clear_occupancy();
+	_clear_freed();
+}
+
+IncrementalUVAtlas::~IncrementalUVAtlas() {
+	_entries.clear();
+}
+
+void IncrementalUVAtlas::_bind_methods() {
+	ADD_SIGNAL(MethodInfo("repacked"));
+
+	ClassDB::bind_method(D_METHOD("get_width"), &IncrementalUVAtlas::get_width);
+	ClassDB::bind_method(D_METHOD("set_width", "value"), &IncrementalUVAtlas::set_width);
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "width"), "set_width", "get_width");
+
+	ClassDB::bind_method(D_METHOD("get_height"), &IncrementalUVAtlas::get_height);
+	ClassDB::bind_method(D_METHOD("set_height", "value"), &IncrementalUVAtlas::set_height);
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "height"), "set_height", "get_height");
+
+	ClassDB::bind_method(D_METHOD("get_texel_size"), &IncrementalUVAtlas::get_texel_size);
+	ClassDB::bind_method(D_METHOD("set_texel_size", "value"), &IncrementalUVAtlas::set_texel_size);
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "texel_size"), "set_texel_size", "get_texel_size");
+
+	ClassDB::bind_method(D_METHOD("get_padding"), &IncrementalUVAtlas::get_padding);
+	ClassDB::bind_method(D_METHOD("set_padding", "value"), &IncrementalUVAtlas::set_padding);
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "padding"), "set_padding", "get_padding");
+
+	ClassDB::bind_method(D_METHOD("get_fragmentation_threshold"), &IncrementalUVAtlas::get_fragmentation_threshold);
+	ClassDB::bind_method(D_METHOD("set_fragmentation_threshold", "value"), &IncrementalUVAtlas::set_fragmentation_threshold);
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "fragmentation_threshold"), "set_fragmentation_threshold", "get_fragmentation_threshold");
+
+	ClassDB::bind_method(D_METHOD("add_mesh", "arr"), &IncrementalUVAtlas::add_mesh);
+	ClassDB::bind_method(D_METHOD("remove_mesh", "id"), &IncrementalUVAtlas::remove_mesh);
+	ClassDB::bind_method(D_METHOD("has_mesh", "id"), &IncrementalUVAtlas::has_mesh);
+	ClassDB::bind_method(D_METHOD("get_uvs", "id"), &IncrementalUVAtlas::get_uvs);
+	ClassDB::bind_method(D_METHOD("get_mesh_ids"), &IncrementalUVAtlas::get_mesh_ids);
+
+	ClassDB::bind_method(D_METHOD("get_mesh_count"), &IncrementalUVAtlas::get_mesh_count);
+	ClassDB::bind_method(D_METHOD("get_utilization"), &IncrementalUVAtlas::get_utilization);
+	ClassDB::bind_method(D_METHOD("get_fragmentation"), &IncrementalUVAtlas::get_fragmentation);
+
+	ClassDB::bind_method(D_METHOD("repack"), &IncrementalUVAtlas::repack);
+	ClassDB::bind_method(D_METHOD("clear"), &IncrementalUVAtlas::clear);
+}
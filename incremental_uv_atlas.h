@@ -0,0 +1,146 @@
+#ifndef INCREMENTAL_UV_ATLAS_H
+#define INCREMENTAL_UV_ATLAS_H
+
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "core/object/ref_counted.h"
+#include "core/templates/hash_map.h"
+#include "core/templates/local_vector.h"
+
+#include "defines.h"
+
+// A fixed size atlas (for lightmaps, ao) that meshes can be streamed into.
+// Every added mesh gets unwrapped by xatlas on its own, then its charts get placed
+// into the free space of the atlas, without moving the charts that are already in it.
+// Everything gets repacked only when the atlas gets too fragmented (after removals),
+// or when a new mesh doesn't fit otherwise. The repacked signal is emitted then,
+// the uvs of all meshes need to be fetched again.
+class IncrementalUVAtlas : public RefCounted {
+	GDCLASS(IncrementalUVAtlas, RefCounted);
+
+public:
+	int get_width() const;
+	void set_width(const int value);
+
+	int get_height() const;
+	void set_height(const int value);
+
+	float get_texel_size() const;
+	void set_texel_size(const float value);
+
+	int get_padding() const;
+	void set_padding(const int value);
+
+	float get_fragmentation_threshold() const;
+	void set_fragmentation_threshold(const float value);
+
+	//Returns an id, or -1 if the mesh couldn't be added
+	int add_mesh(Array arr);
+	void remove_mesh(const int p_id);
+	bool has_mesh(const int p_id) const;
+	PoolVector2Array get_uvs(const int p_id) const;
+	Array get_mesh_ids() const;
+
+	int get_mesh_count() const;
+	//Ratio of used texels in the whole atlas
+	float get_utilization() const;
+	//Ratio of texels that were freed by remove_mesh() (and are not reused yet) to the area that's covered by charts
+	float get_fragmentation() const;
+
+	bool repack();
+	void clear();
+
+	IncrementalUVAtlas();
+	~IncrementalUVAtlas();
+
+protected:
+	static void _bind_methods();
+
+	struct Chart {
+		//Size of the mask, in texels. The mask contains the padding.
+		int width;
+		int height;
+		int row_words;
+		LocalVector<uint64_t> mask;
+		int area;
+
+		//Position in the atlas, -1 if not placed
+		int x;
+		int y;
+
+		Chart() {
+			width = 0;
+			height = 0;
+			row_words = 0;
+			area = 0;
+			x = -1;
+			y = -1;
+		}
+	};
+
+	struct Entry {
+		LocalVector<Chart> charts;
+		//Per input vertex
+		LocalVector<int> vertex_charts;
+		//Relative to the chart's mask, in texels
+		LocalVector<Vector2> vertex_uvs;
+	};
+
+	struct ChartAreaComparator {
+		_FORCE_INLINE_ bool operator()(const Chart *a, const Chart *b) const {
+			return a->area > b->area;
+		}
+	};
+
+	bool _unwrap(const Array &p_arrays, Entry &r_entry) const;
+
+	bool _fits(const Chart &p_chart, const int p_x, const int p_y) const;
+	void _blit(const Chart &p_chart, const bool p_set);
+	bool _place(Chart &p_chart);
+	int _next_free(const int p_y, const int p_x) const;
+	bool _place_all(LocalVector<Chart *> &p_charts);
+	bool _repack();
+	void _clear_occupancy();
+	int _freed_update(const Chart &p_chart, const bool p_freed);
+	void _clear_freed();
+
+	int _width;
+	int _height;
+	float _texel_size;
+	int _padding;
+	float _fragmentation_threshold;
+
+	int _row_words;
+	LocalVector<uint64_t> _occupancy;
+	//Free texels of every row of the atlas, lets _place() skip the rows a chart can't fit into
+	LocalVector<int> _row_free;
+	int64_t _used_area;
+	//Texels freed by remove_mesh() that no chart was placed on since, in the layout of _occupancy
+	LocalVector<uint64_t> _freed;
+	int64_t _freed_area;
+
+	HashMap<int, Entry> _entries;
+	int _next_id;
+};
+
+#endif
@@ -0,0 +1,370 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "mesh_result_cache.h"
+
+#include "core/io/dir_access.h"
+#include "core/io/file_access.h"
+#include "core/io/marshalls.h"
+#include "core/variant/array.h"
+
+// MurmurHash64A
+uint64_t MeshResultCache::hash_buffer(const void *p_data, uint64_t p_size, uint64_t p_seed) {
+	const uint64_t m = 0xc6a4a7935bd1e995ULL;
+	const int r = 47;
+
+	uint64_t h = p_seed ^ (p_size * m);
+
+	const uint8_t *data = reinterpret_cast<const uint8_t *>(p_data);
+	const uint8_t *end = data + (p_size / 8) * 8;
+
+	while (data != end) {
+		uint64_t k;
+		memcpy(&k, data, sizeof(uint64_t));
+		data += 8;
+
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+
+		h ^= k;
+		h *= m;
+	}
+
+	switch (p_size & 7) {
+		case 7:
+			h ^= uint64_t(data[6]) << 48;
+			[[fallthrough]];
+		case 6:
+			h ^= uint64_t(data[5]) << 40;
+			[[fallthrough]];
+		case 5:
+			h ^= uint64_t(data[4]) << 32;
+			[[fallthrough]];
+		case 4:
+			h ^= uint64_t(data[3]) << 24;
+			[[fallthrough]];
+		case 3:
+			h ^= uint64_t(data[2]) << 16;
+			[[fallthrough]];
+		case 2:
+			h ^= uint64_t(data[1]) << 8;
+			[[fallthrough]];
+		case 1:
+			h ^= uint64_t(data[0]);
+			h *= m;
+	}
+
+	h ^= h >> r;
+	h *= m;
+	h ^= h >> r;
+
+	return h;
+}
+
+uint64_t MeshResultCache::hash_operation(const Operation p_operation) {
+	uint32_t version = 0;
+
+	switch (p_operation) {
+		case OPERATION_UV_UNWRAP:
+			version = UV_UNWRAP_VERSION;
+			break;
+		case OPERATION_SIMPLIFY_MESH:
+			version = SIMPLIFY_MESH_VERSION;
+			break;
+		case OPERATION_UV_REPACK:
+			version = UV_REPACK_VERSION;
+			break;
+	}
+
+	return hash_uint64(version, hash_uint64(p_operation));
+}
+
+uint64_t MeshResultCache::hash_uint64(uint64_t p_value, uint64_t p_seed) {
+	return hash_buffer(&p_value, sizeof(uint64_t), p_seed);
+}
+
+uint64_t MeshResultCache::hash_double(double p_value, uint64_t p_seed) {
+	return hash_buffer(&p_value, sizeof(double), p_seed);
+}
+
+uint64_t MeshResultCache::hash_variant(const Variant &p_value, uint64_t p_seed) {
+	uint64_t h = hash_uint64(p_value.get_type(), p_seed);
+
+	switch (p_value.get_type()) {
+		case Variant::NIL:
+			return h;
+		case Variant::ARRAY: {
+			Array arr = p_value;
+
+			h = hash_uint64(arr.size(), h);
+
+			for (int i = 0; i < arr.size(); ++i) {
+				h = hash_variant(arr[i], h);
+			}
+
+			return h;
+		}
+		case Variant::PACKED_BYTE_ARRAY: {
+			PackedByteArray arr = p_value;
+			return hash_buffer(arr.ptr(), arr.size() * sizeof(uint8_t), h);
+		}
+		case Variant::PACKED_INT32_ARRAY: {
+			PackedInt32Array arr = p_value;
+			return hash_buffer(arr.ptr(), arr.size() * sizeof(int32_t), h);
+		}
+		case Variant::PACKED_INT64_ARRAY: {
+			PackedInt64Array arr = p_value;
+			return hash_buffer(arr.ptr(), arr.size() * sizeof(int64_t), h);
+		}
+		case Variant::PACKED_FLOAT32_ARRAY: {
+			PackedFloat32Array arr = p_value;
+			return hash_buffer(arr.ptr(), arr.size() * sizeof(float), h);
+		}
+		case Variant::PACKED_FLOAT64_ARRAY: {
+			PackedFloat64Array arr = p_value;
+			return hash_buffer(arr.ptr(), arr.size() * sizeof(double), h);
+		}
+		case Variant::PACKED_VECTOR2_ARRAY: {
+			PackedVector2Array arr = p_value;
+			return hash_buffer(arr.ptr(), arr.size() * sizeof(Vector2), h);
+		}
+		case Variant::PACKED_VECTOR3_ARRAY: {
+			PackedVector3Array arr = p_value;
+			return hash_buffer(arr.ptr(), arr.size() * sizeof(Vector3), h);
+		}
+		case Variant::PACKED_COLOR_ARRAY: {
+			PackedColorArray arr = p_value;
+			return hash_buffer(arr.ptr(), arr.size() * sizeof(Color), h);
+		}
+		default:
+			return hash_uint64(p_value.hash(), h);
+	}
+}
+
+bool MeshResultCache::get_enabled() const {
+	MutexLock lock(_mutex);
+
+	return _enabled;
+}
+void MeshResultCache::set_enabled(const bool value) {
+	MutexLock lock(_mutex);
+
+	_enabled = value;
+}
+
+int MeshResultCache::get_memory_capacity() const {
+	MutexLock lock(_mutex);
+
+	return _memory.get_capacity();
+}
+void MeshResultCache::set_memory_capacity(const int value) {
+	ERR_FAIL_COND(value < 0);
+
+	MutexLock lock(_mutex);
+
+	_memory.set_capacity(value);
+}
+
+bool MeshResultCache::get_disk_enabled() const {
+	MutexLock lock(_mutex);
+
+	return _disk_enabled;
+}
+void MeshResultCache::set_disk_enabled(const bool value) {
+	MutexLock lock(_mutex);
+
+	_disk_enabled = value;
+}
+
+String MeshResultCache::get_disk_path() const {
+	MutexLock lock(_mutex);
+
+	return _disk_path;
+}
+void MeshResultCache::set_disk_path(const String &value) {
+	MutexLock lock(_mutex);
+
+	_disk_path = value;
+}
+
+bool MeshResultCache::lookup(const uint64_t p_key, Variant &r_value) {
+	MutexLock lock(_mutex);
+
+	if (!_enabled) {
+		return false;
+	}
+
+	const Variant *v = _memory.getptr(p_key);
+
+	if (v) {
+		r_value = *v;
+		return true;
+	}
+
+	if (!_disk_enabled) {
+		return false;
+	}
+
+	if (!_load_blob(p_key, r_value)) {
+		return false;
+	}
+
+	if (_memory.get_capacity() > 0) {
+		_memory.insert(p_key, r_value);
+	}
+
+	return true;
+}
+
+void MeshResultCache::store(const uint64_t p_key, const Variant &p_value) {
+	MutexLock lock(_mutex);
+
+	if (!_enabled) {
+		return;
+	}
+
+	if (_memory.get_capacity() > 0) {
+		_memory.insert(p_key, p_value);
+	}
+
+	if (_disk_enabled) {
+		_save_blob(p_key, p_value);
+	}
+}
+
+void MeshResultCache::clear(const bool p_disk) {
+	MutexLock lock(_mutex);
+
+	_memory.clear();
+
+	if (!p_disk) {
+		return;
+	}
+
+	Ref<DirAccess> da = DirAccess::open(_disk_path);
+
+	if (da.is_null()) {
+		return;
+	}
+
+	da->list_dir_begin();
+
+	String file = da->get_next();
+	while (!file.is_empty()) {
+		if (!da->current_is_dir() && file.ends_with(".mucache")) {
+			da->remove(file);
+		}
+
+		file = da->get_next();
+	}
+
+	da->list_dir_end();
+}
+
+String MeshResultCache::_get_blob_path(const uint64_t p_key) const {
+	return _disk_path.path_join(String::num_uint64(p_key, 16).lpad(16, "0") + ".mucache");
+}
+
+bool MeshResultCache::_load_blob(const uint64_t p_key, Variant &r_value) {
+	String path = _get_blob_path(p_key);
+
+	if (!FileAccess::exists(path)) {
+		return false;
+	}
+
+	Ref<FileAccess> f = FileAccess::open(path, FileAccess::READ);
+
+	if (f.is_null()) {
+		return false;
+	}
+
+	uint32_t magic = f->get_32();
+	uint32_t version = f->get_32();
+	uint64_t key = f->get_64();
+	uint32_t len = f->get_32();
+
+	if (magic != BLOB_MAGIC || version != FORMAT_VERSION || key != p_key || len > f->get_length() - f->get_position()) {
+		//Stale, or corrupt, it will get rewritten on the next store
+		f.unref();
+		DirAccess::remove_absolute(path);
+		return false;
+	}
+
+	Vector<uint8_t> data;
+	data.resize(len);
+
+	if (f->get_buffer(data.ptrw(), len) != len) {
+		return false;
+	}
+
+	return decode_variant(r_value, data.ptr(), len, nullptr, false) == OK;
+}
+
+void MeshResultCache::_save_blob(const uint64_t p_key, const Variant &p_value) {
+	int len = 0;
+	Error err = encode_variant(p_value, nullptr, len, false);
+	ERR_FAIL_COND(err != OK);
+
+	Vector<uint8_t> data;
+	data.resize(len);
+	encode_variant(p_value, data.ptrw(), len, false);
+
+	if (!DirAccess::dir_exists_absolute(_disk_path)) {
+		err = DirAccess::make_dir_recursive_absolute(_disk_path);
+		ERR_FAIL_COND_MSG(err != OK, "MeshResultCache: Couldn't create cache directory: " + _disk_path);
+	}
+
+	String path = _get_blob_path(p_key);
+	//Write to a temporary file first, so an interrupted write can't leave a truncated blob behind
+	String tmp_path = path + ".tmp";
+
+	Ref<FileAccess> f = FileAccess::open(tmp_path, FileAccess::WRITE);
+	ERR_FAIL_COND_MSG(f.is_null(), "MeshResultCache: Couldn't write cache file: " + tmp_path);
+
+	f->store_32(BLOB_MAGIC);
+	f->store_32(FORMAT_VERSION);
+	f->store_64(p_key);
+	f->store_32(len);
+	f->store_buffer(data.ptr(), len);
+	f.unref();
+
+	Ref<DirAccess> da = DirAccess::create_for_path(path);
+	ERR_FAIL_COND(da.is_null());
+
+	if (da->file_exists(path)) {
+		da->remove(path);
+	}
+
+	da->rename(tmp_path, path);
+}
+
+MeshResultCache::MeshResultCache() {
+	_enabled = false;
+	_disk_enabled = false;
+	_disk_path = "user://mesh_utils_cache";
+	_memory.set_capacity(64);
+}
+
+MeshResultCache::~MeshResultCache() {
+	_memory.clear();
+}
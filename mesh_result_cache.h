@@ -0,0 +1,95 @@
+#ifndef MESH_RESULT_CACHE_H
+#define MESH_RESULT_CACHE_H
+
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "core/os/mutex.h"
+#include "core/string/ustring.h"
+#include "core/templates/lru.h"
+#include "core/variant/variant.h"
+
+// Caches results of deterministic, expensive operations (uv_unwrap, simplify_mesh)
+// keyed by a 64 bit hash of their inputs and parameters.
+// There is an in memory LRU tier, and an optional on disk tier, which stores
+// versioned binary blobs, so results survive restarts.
+class MeshResultCache {
+public:
+	enum Operation {
+		OPERATION_UV_UNWRAP = 1,
+		OPERATION_SIMPLIFY_MESH,
+		OPERATION_UV_REPACK,
+	};
+
+	// Bump this if the layout of the blobs on disk changes, so stale blobs get discarded.
+	static const uint32_t FORMAT_VERSION = 1;
+
+	// Bump the version of an operation if its output changes for the same input,
+	// so results of the previous algorithm are not reused.
+	static const uint32_t UV_UNWRAP_VERSION = 1;
+	static const uint32_t SIMPLIFY_MESH_VERSION = 7;
+	static const uint32_t UV_REPACK_VERSION = 1;
+
+	//Seed for the key of an operation, includes its algorithm version
+	static uint64_t hash_operation(const Operation p_operation);
+	static uint64_t hash_buffer(const void *p_data, uint64_t p_size, uint64_t p_seed = 0);
+	static uint64_t hash_uint64(uint64_t p_value, uint64_t p_seed = 0);
+	static uint64_t hash_double(double p_value, uint64_t p_seed = 0);
+	//Hashes the contents of packed arrays (and arrays of them) instead of their identity
+	static uint64_t hash_variant(const Variant &p_value, uint64_t p_seed = 0);
+
+	bool get_enabled() const;
+	void set_enabled(const bool value);
+
+	int get_memory_capacity() const;
+	void set_memory_capacity(const int value);
+
+	bool get_disk_enabled() const;
+	void set_disk_enabled(const bool value);
+
+	String get_disk_path() const;
+	void set_disk_path(const String &value);
+
+	bool lookup(const uint64_t p_key, Variant &r_value);
+	void store(const uint64_t p_key, const Variant &p_value);
+	void clear(const bool p_disk = false);
+
+	MeshResultCache();
+	~MeshResultCache();
+
+private:
+	String _get_blob_path(const uint64_t p_key) const;
+	bool _load_blob(const uint64_t p_key, Variant &r_value);
+	void _save_blob(const uint64_t p_key, const Variant &p_value);
+
+	static const uint32_t BLOB_MAGIC = 0x4243554D; // "MUCB"
+
+	//Guards the settings too, uv_unwrap() and the simplifiers read them from any thread
+	mutable Mutex _mutex;
+	LRUCache<uint64_t, Variant> _memory;
+
+	bool _enabled;
+	bool _disk_enabled;
+	String _disk_path;
+};
+
+#endif
@@ -21,6 +21,9 @@ SOFTWARE.
 */
 
 #include "mesh_utils.h"
+#include "mesh_result_cache.h"
+#include "core/os/os.h"
+#include "core/templates/hash_map.h"
 #include "core/templates/local_vector.h"
 #include "core/variant/variant.h"
 #include "scene/resources/mesh.h"
@@ -28,14 +31,14 @@ SOFTWARE.
 #include visual_server_h
 
 #include "xatlas/xatlas.h"
+#include "xatlas_arena.h"
 
 #if GODOT4
 #define Texture Texture2D
+#endif
 
-#include "core/math/delaunay_3d.h"
-#else
+#include "delaunay/delaunay_2d.h"
 #include "delaunay/delaunay_3d.h"
-#endif
 
 MeshUtils *MeshUtils::_instance;
 
@@ -486,7 +489,24 @@ Array MeshUtils::remove_doubles_interpolate_normals(Array arr) const {
 	return retarr;
 }
 
-PoolVector2Array MeshUtils::uv_unwrap(Array arrays, bool p_block_align, float p_texel_size, int p_padding, int p_max_chart_size) const {
+static void _uv_unwrap_profile_callback(const char *name, uint64_t value, void *userData) {
+	Dictionary *phases = reinterpret_cast<Dictionary *>(userData);
+
+	(*phases)[String(name)] = value;
+}
+
+static bool _uv_unwrap_progress_callback(xatlas_mu::ProgressCategory category, int progress, void *userData) {
+	UVUnwrapProgress *p = reinterpret_cast<UVUnwrapProgress *>(userData);
+
+	//The category enums are in the same order
+	return p->report(static_cast<UVUnwrapProgress::ProgressCategory>(category), progress);
+}
+
+PoolVector2Array MeshUtils::uv_unwrap(Array arrays, bool p_block_align, float p_texel_size, int p_padding, int p_max_chart_size, const Ref<UVUnwrapProgress> &p_progress) const {
+	if (p_progress.is_valid() && p_progress->is_cancelled()) {
+		return PoolVector2Array();
+	}
+
 	LocalVector<float> vertices;
 	LocalVector<float> normals;
 	LocalVector<int> indices;
@@ -518,6 +538,25 @@ PoolVector2Array MeshUtils::uv_unwrap(Array arrays, bool p_block_align, float p_
 	Vector<int> rindices = arrays[Mesh::ARRAY_INDEX];
 	int ic = rindices.size();
 
+	uint64_t cache_key = 0;
+	bool use_cache = _result_cache->get_enabled();
+
+	if (use_cache) {
+		cache_key = MeshResultCache::hash_operation(MeshResultCache::OPERATION_UV_UNWRAP);
+		cache_key = MeshResultCache::hash_variant(arrays[Mesh::ARRAY_VERTEX], cache_key);
+		cache_key = MeshResultCache::hash_variant(arrays[Mesh::ARRAY_NORMAL], cache_key);
+		cache_key = MeshResultCache::hash_variant(arrays[Mesh::ARRAY_INDEX], cache_key);
+		cache_key = MeshResultCache::hash_uint64(p_block_align, cache_key);
+		cache_key = MeshResultCache::hash_double(p_texel_size, cache_key);
+		cache_key = MeshResultCache::hash_uint64(p_padding, cache_key);
+		cache_key = MeshResultCache::hash_uint64(p_max_chart_size, cache_key);
+
+		Variant cached;
+		if (_result_cache->lookup(cache_key, cached)) {
+			return cached;
+		}
+	}
+
 	if (ic == 0) {
 		for (int j = 0; j < vc / 3; j++) {
 			indices.push_back(vertex_ofs + j * 3 + 0);
@@ -561,12 +600,43 @@ PoolVector2Array MeshUtils::uv_unwrap(Array arrays, bool p_block_align, float p_
 	pack_options.blockAlign = p_block_align;
 	pack_options.texelsPerUnit = 1.0 / p_texel_size;
 
+	uint64_t start_usec = OS::get_singleton()->get_ticks_usec();
+
+	//Everything xatlas allocates from here is given back at once when this goes out of scope
+	XatlasArena::Scope arena_scope;
+
 	xatlas_mu::Atlas *atlas = xatlas_mu::Create();
 
+	if (p_progress.is_valid()) {
+		xatlas_mu::SetProgressCallback(atlas, _uv_unwrap_progress_callback, p_progress.ptr());
+	}
+
 	xatlas_mu::AddMeshError err = xatlas_mu::AddMesh(atlas, input_mesh, 1);
 	ERR_FAIL_COND_V_MSG(err != xatlas_mu::AddMeshError::Success, PoolVector2Array(), xatlas_mu::StringForEnum(err));
 
-	xatlas_mu::Generate(atlas, chart_options, pack_options);
+	//Same as Generate(), but PackCharts would complain if it gets called after ComputeCharts got cancelled
+	xatlas_mu::AddMeshJoin(atlas);
+
+	if (p_progress.is_valid() && p_progress->is_cancelled()) {
+		xatlas_mu::Destroy(atlas);
+		return PoolVector2Array();
+	}
+
+	xatlas_mu::ComputeCharts(atlas, chart_options);
+
+	if (p_progress.is_valid() && p_progress->is_cancelled()) {
+		xatlas_mu::Destroy(atlas);
+		return PoolVector2Array();
+	}
+
+	xatlas_mu::PackCharts(atlas, pack_options);
+
+	if (p_progress.is_valid() && p_progress->is_cancelled()) {
+		xatlas_mu::Destroy(atlas);
+		return PoolVector2Array();
+	}
+
+	_store_unwrap_profile(start_usec, arena_scope.get_arena());
 
 	float w = atlas->width;
 	float h = atlas->height;
@@ -591,11 +661,266 @@ PoolVector2Array MeshUtils::uv_unwrap(Array arrays, bool p_block_align, float p_
 
 	xatlas_mu::Destroy(atlas);
 
+	if (use_cache) {
+		_result_cache->store(cache_key, retarr);
+	}
+
 	return retarr;
 }
 
-PoolIntArray MeshUtils::delaunay3d_tetrahedralize(const Vector<Vector3> &p_points) {
-	Vector<Delaunay3D::OutputSimplex> data = Delaunay3D::tetrahedralize(p_points);
+static uint32_t _uv_repack_find_piece(LocalVector<uint32_t> &r_parents, uint32_t p_index) {
+	while (r_parents[p_index] != p_index) {
+		r_parents[p_index] = r_parents[r_parents[p_index]];
+		p_index = r_parents[p_index];
+	}
+
+	return p_index;
+}
+
+static void _uv_repack_join_pieces(LocalVector<uint32_t> &r_parents, const uint32_t p_a, const uint32_t p_b) {
+	uint32_t a = _uv_repack_find_piece(r_parents, p_a);
+	uint32_t b = _uv_repack_find_piece(r_parents, p_b);
+
+	if (a != b) {
+		r_parents[MAX(a, b)] = MIN(a, b);
+	}
+}
+
+PoolVector2Array MeshUtils::uv_repack(Array arrays, bool p_uv2, bool p_block_align, float p_texel_size, int p_padding, int p_max_chart_size, const Ref<UVUnwrapProgress> &p_progress) const {
+	ERR_FAIL_COND_V(arrays.size() != Mesh::ARRAY_MAX, PoolVector2Array());
+
+	if (p_progress.is_valid() && p_progress->is_cancelled()) {
+		return PoolVector2Array();
+	}
+
+	const int uv_index = p_uv2 ? Mesh::ARRAY_TEX_UV2 : Mesh::ARRAY_TEX_UV;
+
+	Vector<Vector3> rvertices = arrays[Mesh::ARRAY_VERTEX];
+	Vector<Vector2> ruvs = arrays[uv_index];
+	Vector<int> rindices = arrays[Mesh::ARRAY_INDEX];
+
+	int vc = rvertices.size();
+	int ic = rindices.size();
+
+	ERR_FAIL_COND_V_MSG(ruvs.size() != vc, PoolVector2Array(), "uv_repack: The mesh doesn't have uvs to repack.");
+
+	uint64_t cache_key = 0;
+	bool use_cache = _result_cache->get_enabled();
+
+	if (use_cache) {
+		cache_key = MeshResultCache::hash_operation(MeshResultCache::OPERATION_UV_REPACK);
+		cache_key = MeshResultCache::hash_variant(arrays[Mesh::ARRAY_VERTEX], cache_key);
+		cache_key = MeshResultCache::hash_variant(arrays[uv_index], cache_key);
+		cache_key = MeshResultCache::hash_variant(arrays[Mesh::ARRAY_INDEX], cache_key);
+		cache_key = MeshResultCache::hash_uint64(p_block_align, cache_key);
+		cache_key = MeshResultCache::hash_double(p_texel_size, cache_key);
+		cache_key = MeshResultCache::hash_uint64(p_padding, cache_key);
+		cache_key = MeshResultCache::hash_uint64(p_max_chart_size, cache_key);
+
+		Variant cached;
+		if (_result_cache->lookup(cache_key, cached)) {
+			return cached;
+		}
+	}
+
+	const Vector3 *r = rvertices.ptr();
+	const Vector2 *ruv = ruvs.ptr();
+
+	LocalVector<float> uvs;
+	uvs.resize(vc * 2);
+
+	for (int i = 0; i < vc; ++i) {
+		uvs[i * 2] = ruv[i].x;
+		uvs[i * 2 + 1] = ruv[i].y;
+	}
+
+	LocalVector<uint32_t> indices;
+
+	if (ic == 0) {
+		indices.resize(vc);
+
+		for (int i = 0; i < vc; ++i) {
+			indices[i] = i;
+		}
+	} else {
+		const int *ri = rindices.ptr();
+
+		indices.resize(ic);
+
+		for (int i = 0; i < ic; ++i) {
+			ERR_FAIL_INDEX_V(ri[i], vc, PoolVector2Array());
+
+			indices[i] = ri[i];
+		}
+	}
+
+	ERR_FAIL_COND_V(indices.size() % 3 != 0, PoolVector2Array());
+
+	//xatlas would merge charts of overlapping pieces (like multiple copies of the same prop after MeshMerger)
+	//if their uvs touch. Every piece gets its own material, so that can't happen.
+	//Triangles, and vertices on the same position (hard edges) join pieces.
+	LocalVector<uint32_t> pieces;
+	pieces.resize(vc);
+
+	for (int i = 0; i < vc; ++i) {
+		pieces[i] = i;
+	}
+
+	for (uint32_t i = 0; i < indices.size(); i += 3) {
+		_uv_repack_join_pieces(pieces, indices[i], indices[i + 1]);
+		_uv_repack_join_pieces(pieces, indices[i], indices[i + 2]);
+	}
+
+	HashMap<Vector3, uint32_t> positions;
+
+	for (int i = 0; i < vc; ++i) {
+		HashMap<Vector3, uint32_t>::Iterator e = positions.find(r[i]);
+
+		if (e) {
+			_uv_repack_join_pieces(pieces, e->value, i);
+		} else {
+			positions.insert(r[i], i);
+		}
+	}
+
+	LocalVector<uint32_t> face_materials;
+	face_materials.resize(indices.size() / 3);
+
+	for (uint32_t i = 0; i < face_materials.size(); ++i) {
+		face_materials[i] = _uv_repack_find_piece(pieces, indices[i * 3]);
+	}
+
+	xatlas_mu::UvMeshDecl input_mesh;
+	input_mesh.vertexUvData = uvs.ptr();
+	input_mesh.vertexCount = vc;
+	input_mesh.vertexStride = sizeof(float) * 2;
+	input_mesh.indexData = indices.ptr();
+	input_mesh.indexCount = indices.size();
+	input_mesh.indexFormat = xatlas_mu::IndexFormat::UInt32;
+	input_mesh.faceMaterialData = face_materials.ptr();
+
+	xatlas_mu::PackOptions pack_options;
+	pack_options.padding = p_padding;
+	pack_options.maxChartSize = p_max_chart_size;
+	pack_options.blockAlign = p_block_align;
+	pack_options.texelsPerUnit = p_texel_size > 0 ? 1.0 / p_texel_size : 0;
+
+	uint64_t start_usec = OS::get_singleton()->get_ticks_usec();
+
+	XatlasArena::Scope arena_scope;
+
+	xatlas_mu::Atlas *atlas = xatlas_mu::Create();
+
+	if (p_progress.is_valid()) {
+		xatlas_mu::SetProgressCallback(atlas, _uv_unwrap_progress_callback, p_progress.ptr());
+	}
+
+	xatlas_mu::AddMeshError err = xatlas_mu::AddUvMesh(atlas, input_mesh);
+
+	if (err != xatlas_mu::AddMeshError::Success) {
+		xatlas_mu::Destroy(atlas);
+		ERR_FAIL_V_MSG(PoolVector2Array(), xatlas_mu::StringForEnum(err));
+	}
+
+	//Only finds the charts, they are not parameterized again
+	xatlas_mu::ComputeCharts(atlas);
+
+	if (p_progress.is_valid() && p_progress->is_cancelled()) {
+		xatlas_mu::Destroy(atlas);
+		return PoolVector2Array();
+	}
+
+	xatlas_mu::PackCharts(atlas, pack_options);
+
+	if (p_progress.is_valid() && p_progress->is_cancelled()) {
+		xatlas_mu::Destroy(atlas);
+		return PoolVector2Array();
+	}
+
+	_store_unwrap_profile(start_usec, arena_scope.get_arena());
+
+	float w = atlas->width;
+	float h = atlas->height;
+
+	if (w == 0 || h == 0) {
+		xatlas_mu::Destroy(atlas);
+		return PoolVector2Array(); //no valid charts
+	}
+
+	const xatlas_mu::Mesh &output = atlas->meshes[0];
+
+	PoolVector2Array retarr;
+	retarr.resize(vc);
+
+	Vector2 *retarrw = retarr.ptrw();
+
+	for (uint32_t i = 0; i < output.vertexCount; i++) {
+		const xatlas_mu::Vertex &v = output.vertexArray[i];
+
+		if (v.chartIndex == -1) {
+			//Only used by zero area / nan faces
+			retarrw[v.xref] = Vector2();
+			continue;
+		}
+
+		retarrw[v.xref] = Vector2(v.uv[0] / w, v.uv[1] / h);
+	}
+
+	xatlas_mu::Destroy(atlas);
+
+	if (use_cache) {
+		_result_cache->store(cache_key, retarr);
+	}
+
+	return retarr;
+}
+
+Dictionary MeshUtils::get_last_unwrap_profile() const {
+	MutexLock lock(_last_unwrap_profile_mutex);
+
+	return _last_unwrap_profile.duplicate(true);
+}
+
+void MeshUtils::_store_unwrap_profile(const uint64_t p_start_usec, const XatlasArena *p_arena) const {
+	Dictionary profile;
+
+	profile["total_usec"] = OS::get_singleton()->get_ticks_usec() - p_start_usec;
+	profile["memory_peak"] = p_arena->get_peak_usage();
+	profile["allocation_count"] = p_arena->get_allocation_count();
+
+	//Microseconds, keyed by the names xatlas uses internally (addMeshThread, computeChartsReal, packChartsRasterize, ...).
+	//xatlas keeps these in globals, so they can get mixed up if unwraps run on multiple threads at the same time.
+	Dictionary phases;
+	profile["profiling_enabled"] = xatlas_mu::GetLastProfile(_uv_unwrap_profile_callback, &phases);
+	profile["phases"] = phases;
+
+	MutexLock lock(_last_unwrap_profile_mutex);
+
+	_last_unwrap_profile = profile;
+}
+
+Vector<int> MeshUtils::delaunay2d_triangulate(const Vector<Vector2> &p_points, const Vector<int> &p_constraint_edges) {
+	Vector<Delaunay2D::OutputTriangle> data = Delaunay2D::triangulate(p_points, p_constraint_edges);
+
+	Vector<int> ret;
+	ret.resize(data.size() * 3);
+	int *w = ret.ptrw();
+
+	for (int i = 0; i < data.size(); ++i) {
+		int indx = i * 3;
+
+		const Delaunay2D::OutputTriangle &t = data[i];
+
+		w[indx] = t.points[0];
+		w[indx + 1] = t.points[1];
+		w[indx + 2] = t.points[2];
+	}
+
+	return ret;
+}
+
+PoolIntArray MeshUtils::delaunay3d_tetrahedralize(const Vector<Vector3> &p_points, const bool p_parallel) {
+	Vector<Delaunay3D::OutputSimplex> data = Delaunay3D::tetrahedralize(p_points, nullptr, p_parallel);
 
 	PoolIntArray ret;
 	ret.resize(data.size() * 4);
@@ -615,12 +940,85 @@ PoolIntArray MeshUtils::delaunay3d_tetrahedralize(const Vector<Vector3> &p_point
 	return ret;
 }
 
+Vector<int> MeshUtils::delaunay3d_tetrahedralize_compact(const Vector<Vector3> &p_points, const bool p_parallel) {
+	Vector<Delaunay3D::OutputSimplex> data = Delaunay3D::tetrahedralize(p_points, nullptr, p_parallel, true);
+
+	Vector<int> ret;
+	ret.resize(data.size() * 4);
+	int *w = ret.ptrw();
+
+	for (int i = 0; i < data.size(); ++i) {
+		int indx = i * 4;
+
+		const Delaunay3D::OutputSimplex &s = data[i];
+
+		w[indx] = s.points[0];
+		w[indx + 1] = s.points[1];
+		w[indx + 2] = s.points[2];
+		w[indx + 3] = s.points[3];
+	}
+
+	return ret;
+}
+
+Ref<DelaunayTetrahedralization> MeshUtils::delaunay3d_tetrahedralization(const Vector<Vector3> &p_points, const bool p_parallel) {
+	Ref<DelaunayTetrahedralization> tetrahedralization;
+	tetrahedralization.instantiate();
+	tetrahedralization->build(p_points, p_parallel);
+
+	return tetrahedralization;
+}
+
+bool MeshUtils::get_result_cache_enabled() const {
+	return _result_cache->get_enabled();
+}
+void MeshUtils::set_result_cache_enabled(const bool value) {
+	_result_cache->set_enabled(value);
+}
+
+int MeshUtils::get_result_cache_memory_capacity() const {
+	return _result_cache->get_memory_capacity();
+}
+void MeshUtils::set_result_cache_memory_capacity(const int value) {
+	_result_cache->set_memory_capacity(value);
+}
+
+bool MeshUtils::get_result_cache_disk_enabled() const {
+	return _result_cache->get_disk_enabled();
+}
+void MeshUtils::set_result_cache_disk_enabled(const bool value) {
+	_result_cache->set_disk_enabled(value);
+}
+
+String MeshUtils::get_result_cache_path() const {
+	return _result_cache->get_disk_path();
+}
+void MeshUtils::set_result_cache_path(const String &value) {
+	_result_cache->set_disk_path(value);
+}
+
+void MeshUtils::clear_result_cache(const bool p_disk) {
+	_result_cache->clear(p_disk);
+}
+
+MeshResultCache *MeshUtils::get_result_cache() const {
+	return _result_cache;
+}
+
 MeshUtils::MeshUtils() {
 	_instance = this;
+
+	_result_cache = memnew(MeshResultCache);
+
+	XatlasArena::install();
 }
 
 MeshUtils::~MeshUtils() {
 	_instance = NULL;
+
+	memdelete(_result_cache);
+
+	XatlasArena::uninstall();
 }
 
 void MeshUtils::_bind_methods() {
@@ -630,9 +1028,34 @@ void MeshUtils::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("remove_doubles", "arr"), &MeshUtils::remove_doubles);
 	ClassDB::bind_method(D_METHOD("remove_doubles_interpolate_normals", "arr"), &MeshUtils::remove_doubles_interpolate_normals);
 
-	ClassDB::bind_method(D_METHOD("uv_unwrap", "arr", "block_align", "texel_size", "padding", "max_chart_size"), &MeshUtils::uv_unwrap, true, 0.05, 1, 4094);
+	ClassDB::bind_method(D_METHOD("uv_unwrap", "arr", "block_align", "texel_size", "padding", "max_chart_size", "progress"), &MeshUtils::uv_unwrap, true, 0.05, 1, 4094, Variant());
+
+	ClassDB::bind_method(D_METHOD("delaunay2d_triangulate", "points", "constraint_edges"), &MeshUtils::delaunay2d_triangulate, DEFVAL(Vector<int>()));
+	ClassDB::bind_method(D_METHOD("delaunay3d_tetrahedralize", "points", "parallel"), &MeshUtils::delaunay3d_tetrahedralize, DEFVAL(false));
+	ClassDB::bind_method(D_METHOD("delaunay3d_tetrahedralize_compact", "points", "parallel"), &MeshUtils::delaunay3d_tetrahedralize_compact, DEFVAL(false));
+	ClassDB::bind_method(D_METHOD("delaunay3d_tetrahedralization", "points", "parallel"), &MeshUtils::delaunay3d_tetrahedralization, DEFVAL(false));
+
+	ClassDB::bind_method(D_METHOD("uv_repack", "arr", "uv2", "block_align", "texel_size", "padding", "max_chart_size", "progress"), &MeshUtils::uv_repack, false, true, 0, 1, 4094, Variant());
+
+	ClassDB::bind_method(D_METHOD("get_last_unwrap_profile"), &MeshUtils::get_last_unwrap_profile);
+
+	ClassDB::bind_method(D_METHOD("get_result_cache_enabled"), &MeshUtils::get_result_cache_enabled);
+	ClassDB::bind_method(D_METHOD("set_result_cache_enabled", "value"), &MeshUtils::set_result_cache_enabled);
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "result_cache_enabled"), "set_result_cache_enabled", "get_result_cache_enabled");
+
+	ClassDB::bind_method(D_METHOD("get_result_cache_memory_capacity"), &MeshUtils::get_result_cache_memory_capacity);
+	ClassDB::bind_method(D_METHOD("set_result_cache_memory_capacity", "value"), &MeshUtils::set_result_cache_memory_capacity);
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "result_cache_memory_capacity"), "set_result_cache_memory_capacity", "get_result_cache_memory_capacity");
+
+	ClassDB::bind_method(D_METHOD("get_result_cache_disk_enabled"), &MeshUtils::get_result_cache_disk_enabled);
+	ClassDB::bind_method(D_METHOD("set_result_cache_disk_enabled", "value"), &MeshUtils::set_result_cache_disk_enabled);
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "result_cache_disk_enabled"), "set_result_cache_disk_enabled", "get_result_cache_disk_enabled");
+
+	ClassDB::bind_method(D_METHOD("get_result_cache_path"), &MeshUtils::get_result_cache_path);
+	ClassDB::bind_method(D_METHOD("set_result_cache_path", "value"), &MeshUtils::set_result_cache_path);
+	ADD_PROPERTY(PropertyInfo(Variant::STRING, "result_cache_path"), "set_result_cache_path", "get_result_cache_path");
 
-	ClassDB::bind_method(D_METHOD("delaunay3d_tetrahedralize", "points"), &MeshUtils::delaunay3d_tetrahedralize);
+	ClassDB::bind_method(D_METHOD("clear_result_cache", "disk"), &MeshUtils::clear_result_cache, DEFVAL(false));
 }
 
 #if GODOT4
@@ -28,13 +28,22 @@ SOFTWARE.
 
 #if VERSION_MAJOR > 3
 #include "core/object/object.h"
+#include "core/variant/dictionary.h"
 #else
+#include "core/dictionary.h"
 #include "core/object.h"
 #endif
 
+#include "core/os/mutex.h"
+
 #include "scene/resources/texture.h"
 
 #include "defines.h"
+#include "delaunay_tetrahedralization.h"
+#include "uv_unwrap_progress.h"
+
+class MeshResultCache;
+class XatlasArena;
 
 #if GODOT4
 #define Texture Texture2D
@@ -54,9 +63,46 @@ public:
 	Array remove_doubles_interpolate_normals(Array arr) const;
 
 	//Only unwraps, does not create new seams
-	PoolVector2Array uv_unwrap(Array arr, bool p_block_align = true, float p_texel_size = 0.05, int p_padding = 1, int p_max_chart_size = 4094) const;
+	//progress is optional, it can be used to observe, and to cancel the unwrap. Cancelled unwraps return an empty array.
+	PoolVector2Array uv_unwrap(Array arr, bool p_block_align = true, float p_texel_size = 0.05, int p_padding = 1, int p_max_chart_size = 4094, const Ref<UVUnwrapProgress> &p_progress = Ref<UVUnwrapProgress>()) const;
+
+	//Packs the existing uv (or uv2) charts of the mesh into a new atlas, without re-charting it.
+	//Charts are found by uv connectivity, overlapping charts of different (not connected) pieces of the mesh are kept apart,
+	//so it works on the output of MeshMerger. texel_size is in uv units, if it's 0 a scale that gives about a 1024x1024 atlas is used.
+	PoolVector2Array uv_repack(Array arr, bool p_uv2 = false, bool p_block_align = true, float p_texel_size = 0, int p_padding = 1, int p_max_chart_size = 4094, const Ref<UVUnwrapProgress> &p_progress = Ref<UVUnwrapProgress>()) const;
+
+	//Timings of the last uv_unwrap / uv_repack call (that actually ran xatlas).
+	//Per phase xatlas timings are only present if the module was built with mesh_utils_xatlas_profile=yes.
+	Dictionary get_last_unwrap_profile() const;
+
+	//Flat index buffer of the triangles, counterclockwise in the plane of the points, so with the points mapped to x and z
+	//they face upwards, and it can be used as ARRAY_INDEX directly. constraint_edges are pairs of point indices,
+	//the edges between them will be in the triangulation (constrained Delaunay).
+	Vector<int> delaunay2d_triangulate(const Vector<Vector2> &p_points, const Vector<int> &p_constraint_edges = Vector<int>());
+
+	//parallel splits large (100k+) point sets into partitions that are tetrahedralized on the worker threads
+	PoolIntArray delaunay3d_tetrahedralize(const Vector<Vector3> &p_points, const bool p_parallel = false);
+	//Same tetrahedralization with 32 bit indices, and the tetrahedra ordered along a Hilbert curve,
+	//so the ones next to each other in space are mostly next to each other in the array too
+	Vector<int> delaunay3d_tetrahedralize_compact(const Vector<Vector3> &p_points, const bool p_parallel = false);
+	//Same tetrahedralization, but it keeps the adjacency, and it can be queried
+	Ref<DelaunayTetrahedralization> delaunay3d_tetrahedralization(const Vector<Vector3> &p_points, const bool p_parallel = false);
+
+	bool get_result_cache_enabled() const;
+	void set_result_cache_enabled(const bool value);
 
-	PoolIntArray delaunay3d_tetrahedralize(const Vector<Vector3> &p_points);
+	int get_result_cache_memory_capacity() const;
+	void set_result_cache_memory_capacity(const int value);
+
+	bool get_result_cache_disk_enabled() const;
+	void set_result_cache_disk_enabled(const bool value);
+
+	String get_result_cache_path() const;
+	void set_result_cache_path(const String &value);
+
+	void clear_result_cache(const bool p_disk = false);
+
+	MeshResultCache *get_result_cache() const;
 
 	MeshUtils();
 	~MeshUtils();
@@ -65,7 +111,14 @@ protected:
 	static void _bind_methods();
 
 private:
+	void _store_unwrap_profile(const uint64_t p_start_usec, const XatlasArena *p_arena) const;
+
 	static MeshUtils *_instance;
+
+	MeshResultCache *_result_cache;
+
+	mutable Mutex _last_unwrap_profile_mutex;
+	mutable Dictionary _last_unwrap_profile;
 };
 
 #if GODOT4
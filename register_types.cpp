@@ -32,16 +32,22 @@ SOFTWARE.
 #include "core/engine.h"
 #endif
 
+#include "delaunay_tetrahedralization.h"
 #include "fast_quadratic_mesh_simplifier.h"
+#include "incremental_uv_atlas.h"
 #include "mesh_merger.h"
 #include "mesh_utils.h"
+#include "uv_unwrap_progress.h"
 
 static MeshUtils *mesh_utils = NULL;
 
 void initialize_mesh_utils_module(ModuleInitializationLevel p_level) {
 	if (p_level == MODULE_INITIALIZATION_LEVEL_SCENE) {
+		GDREGISTER_CLASS(DelaunayTetrahedralization);
 		GDREGISTER_CLASS(FastQuadraticMeshSimplifier);
+		GDREGISTER_CLASS(IncrementalUVAtlas);
 		GDREGISTER_CLASS(MeshMerger);
+		GDREGISTER_CLASS(UVUnwrapProgress);
 
 		mesh_utils = memnew(MeshUtils);
 		GDREGISTER_CLASS(MeshUtils);
@@ -28,6 +28,12 @@
 #include "core/math/vector3.h"
 #include "scene/resources/mesh.h"
 
+#if VERSION_MAJOR > 3
+#include "core/object/worker_thread_pool.h"
+#else
+#include "core/os/thread_work_pool.h"
+#endif
+
 #include <float.h> //FLT_EPSILON, DBL_EPSILON
 #include <limits.h>
 #include <algorithm>
@@ -334,27 +340,16 @@ public:
 };
 ///////////////////////////////////////////
 
-struct BorderVertex {
-	int index;
-	int hash;
-};
-
-static bool compare_border_vertex(const BorderVertex &i1, const BorderVertex &i2) {
-	return (i1.hash < i2.hash);
-}
-
 class FQMS {
 
 public:
+	// Only the data the collapse loops need, so triangles stay 48 bytes.
+	// Normals, and the per corner attributes live in the triangle_* arrays, indexed
+	// by triangle id (normals) or triangle id * 3 + corner (uvs, uv2s, colors).
 	struct Triangle {
-		int v[3];
 		double err[4];
-		int deleted, dirty;
-		vec3f n;
-		vec3f uvs[3];
-		vec3f uv2s[3];
-		Color color[3];
-		int material;
+		int v[3];
+		uint8_t deleted, dirty;
 	};
 
 	struct Vertex {
@@ -362,26 +357,189 @@ public:
 		int tstart, tcount;
 		SymetricMatrix q;
 		int border;
+		// seam and foldover stay set once found, so they survive repeated simplify calls
 		bool seam;
 		bool foldover;
+		// Linked to an other vertex by smart link, see output_vertices_build()
+		bool welded;
+		// Shared with an other cluster, see simplify_mesh_clusters()
+		bool locked;
 	};
 
 	struct Ref {
 		int tid, tvertex;
 	};
 
+	// A candidate edge for the collapse queue. Entries are never removed from the heap,
+	// they are skipped when popped if either vertex changed since they were pushed.
+	// version is the number of collapses done when the entry was pushed, and the error
+	// is only used for ordering, so the entry fits into 16 bytes.
+	struct CollapseEdge {
+		float error;
+		int v0, v1;
+		int version;
+	};
+
+	// One edge collapse, using input vertex indices, see collapse_record()
+	struct CollapseRecord {
+		int kept;
+		int removed;
+	};
+
+	struct CollapseEdgeComparator {
+		bool operator()(const CollapseEdge &a, const CollapseEdge &b) const {
+			return a.error > b.error;
+		}
+	};
+
+	// Edges bucketed by their lower vertex index, see border_edges_update()
+	struct BorderEdges {
+		std::vector<int> offsets;
+		std::vector<int> others;
+		std::vector<uint8_t> border;
+	};
+
+	struct VertexPositionComparator {
+		const Vertex *vertices;
+
+		VertexPositionComparator(const Vertex *p_vertices) {
+			vertices = p_vertices;
+		}
+
+		bool operator()(const int a, const int b) const {
+			const vec3f &pa = vertices[a].p;
+			const vec3f &pb = vertices[b].p;
+
+			if (pa.x != pb.x)
+				return pa.x < pb.x;
+
+			if (pa.y != pb.y)
+				return pa.y < pb.y;
+
+			return pa.z < pb.z;
+		}
+	};
+
+	// Orders triangle ids along one axis of their centers
+	struct TriangleCenterComparator {
+		const vec3f *centers;
+		int axis;
+
+		TriangleCenterComparator(const vec3f *p_centers, const int p_axis) {
+			centers = p_centers;
+			axis = p_axis;
+		}
+
+		bool operator()(const int a, const int b) const {
+			const vec3f &ca = centers[a];
+			const vec3f &cb = centers[b];
+
+			if (axis == 0)
+				return ca.x < cb.x;
+
+			if (axis == 1)
+				return ca.y < cb.y;
+
+			return ca.z < cb.z;
+		}
+	};
+
+	// A spatially compact part of the mesh, see simplify_mesh_clusters().
+	// After simplifying, triangles and the triangle_* arrays hold what is left of it,
+	// already using the vertex indices of the whole mesh.
+	struct Cluster {
+		std::vector<int> triangle_ids;
+		int target_count;
+
+		std::vector<int> vertex_ids;
+		std::vector<vec3f> positions;
+
+		std::vector<Triangle> triangles;
+		std::vector<vec3f> triangle_normals;
+		std::vector<vec3f> triangle_uvs;
+		std::vector<vec3f> triangle_uv2s;
+		std::vector<Color> triangle_colors;
+
+		// _max_collapse_error of the cluster's FQMS
+		double max_error;
+	};
+
+	struct Clusters {
+		std::vector<Cluster> clusters;
+		// The cluster using each vertex, or CLUSTER_SHARED
+		std::vector<int> owners;
+		// Index of the vertex in the cluster owning it
+		std::vector<int> local_ids;
+		// target_count / triangle count
+		double ratio;
+		double agressiveness;
+	};
+
+	enum {
+		BORDER_EDGES_CHUNK_SIZE = 4096,
+		BORDER_EDGES_PARALLEL_MIN_VERTICES = 65536,
+		CLUSTER_MIN_TRIANGLES = 32768,
+		CLUSTER_CHUNK_SIZE = 65536,
+		CLUSTER_SHARED = -2,
+		CLUSTER_SEAM_RINGS = 4,
+	};
+
+	// Keeps the spatial hash cell coordinates in range for tiny link distances
+	static constexpr double LINK_MIN_CELL_SIZE = 1e-9;
+	// Corner attributes closer than this are one vertex, the interpolation on collapse leaves some rounding noise
+	static constexpr double CORNER_ATTRIBUTE_EPSILON = 1e-5;
+
 	std::vector<Triangle> triangles;
 	std::vector<Vertex> vertices;
 	std::vector<Ref> refs;
 
+	std::vector<vec3f> triangle_normals;
+	std::vector<vec3f> triangle_uvs;
+	std::vector<vec3f> triangle_uv2s;
+	std::vector<Color> triangle_colors;
+
 	int _max_iteration_count;
 	int _max_lossless_iteration_count;
 	bool _enable_smart_link;
 	bool _preserve_border_dges;
 	bool _preserve_uv_seam_edges;
 	bool _preserve_uv_foldover_edges;
+	bool _enable_collapse_queue;
 	int _format;
 	double _vertex_link_distance;
+	int _cluster_count;
+	// Clusters already run on the worker threads
+	bool _use_threads;
+	// Weights of the attribute quadrics, 0 disables them, see attribute_quadrics_update()
+	double _uv_weight;
+	double _uv2_weight;
+	double _color_weight;
+	// Bounding box diagonal of the input, see simplify_mesh_to_error()
+	double _error_scale;
+	// Largest error of the collapses since initialize()
+	double _max_collapse_error;
+	// Has to be set before initialize(), see get_progressive_mesh()
+	bool _record_collapses;
+	// _record_collapses, as it was in initialize()
+	bool _recording;
+	// Smart link only welds the borders of the input, not vertices that got close while simplifying
+	bool _linked;
+
+	// Per vertex attribute quadrics, attribute_stride doubles each, see attribute_quadrics_update()
+	std::vector<double> attribute_quadrics;
+	// Per attribute channel
+	std::vector<double> attribute_weights;
+	int attribute_stride;
+
+	// Collapse recording, only filled when _recording is set
+	Array _record_input;
+	std::vector<CollapseRecord> collapse_records;
+	// The input vertex whose position, and attributes a vertex has
+	std::vector<int> vertex_sources;
+	// The input triangle of a triangle
+	std::vector<int> triangle_sources;
+	// Per input triangle, the collapse record that removed it, or -1
+	std::vector<int> triangle_removals;
 
 	// Helper functions
 
@@ -395,7 +553,53 @@ public:
 	//
 
 	void simplify_mesh(int target_count, double agressiveness = 7, bool verbose = false) {
-		ERR_FAIL_COND_MSG(_enable_smart_link, "FastQuadraticMeshSimplifier: enable_smart_link setting is not yet suppored!");
+		if (cluster_count_get() > 1) {
+			simplify_mesh_clusters(target_count, agressiveness, verbose);
+			return;
+		}
+
+		simplify_mesh_collapse(target_count, agressiveness, verbose);
+
+		// clean up mesh
+		compact_mesh();
+	} //simplify_mesh()
+
+	//
+	// Error bounded variant of simplify_mesh
+	//
+	// max_error : how far the surface can move, relative to the bounding box diagonal
+	//             of the input. Collapse errors are quadric errors, so this is an estimate.
+	//             Only the geometric part of them is limited, the attribute quadrics only
+	//             change which edges go first.
+	//
+	// Stops as soon as every remaining collapse would exceed max_error. The clusters are not
+	// used, as they need a triangle count to split the work.
+	//
+
+	void simplify_mesh_to_error(double max_error, double agressiveness = 7, bool verbose = false) {
+		double error_limit = MAX(max_error, 0.0) * _error_scale;
+
+		simplify_mesh_collapse(0, agressiveness, verbose, error_limit * error_limit);
+
+		// clean up mesh
+		compact_mesh();
+	} //simplify_mesh_to_error()
+
+	// The largest geometric collapse error since initialize(), in the units of simplify_mesh_to_error()
+
+	double get_achieved_error() const {
+		return sqrt(MAX(_max_collapse_error, 0.0)) / _error_scale;
+	}
+
+	// Collapses edges until target_count is reached, but leaves the deleted triangles and
+	// the unused vertices in place, so clusters can still map their vertices back after it.
+	// No edge with a geometric (quadric) error above error_limit is collapsed.
+
+	void simplify_mesh_collapse(int target_count, double agressiveness = 7, bool verbose = false, double error_limit = DBL_MAX) {
+		if (_enable_collapse_queue) {
+			simplify_mesh_queue(target_count, verbose, error_limit);
+			return;
+		}
 
 		// init
 		for (unsigned int i = 0; i < triangles.size(); ++i) {
@@ -428,6 +632,16 @@ public:
 			//
 			double threshold = 0.000000001 * pow(double(iteration + 3), agressiveness);
 
+			// Past the error limit, only the edges below it are left. With attribute quadrics the
+			// error of an edge can be above it while its geometric part is not, so keep going
+			bool limited = threshold >= error_limit;
+			if (limited && !attribute_stride) {
+				threshold = error_limit;
+			}
+
+			int iteration_deleted_triangles = deleted_triangles;
+			bool above_threshold = false;
+
 			// target number of triangles reached ? Then break
 			if ((verbose) && (iteration % 5 == 0)) {
 				print_line("iteration " + String::num(iteration) + " - triangles " + String::num(triangle_count - deleted_triangles) + " threshold " + String::num(threshold));
@@ -437,33 +651,41 @@ public:
 			for (unsigned int i = 0; i < triangles.size(); ++i) {
 				Triangle &t = triangles[i];
 
-				if (t.err[3] > threshold)
+				if (t.deleted)
 					continue;
 
-				if (t.deleted)
+				if (t.err[3] > threshold) {
+					above_threshold = true;
 					continue;
+				}
 
 				if (t.dirty)
 					continue;
 
 				for (int j = 0; j < 3; ++j) {
+					if (t.err[j] >= threshold)
+						above_threshold = true;
+
 					if (t.err[j] < threshold) {
 
 						int i0 = t.v[j];
 						Vertex &v0 = vertices[i0];
 						int i1 = t.v[(j + 1) % 3];
 						Vertex &v1 = vertices[i1];
-						// Border check
-						if (v0.border != v1.border)
-							continue;
-						else if (_preserve_border_dges && v0.border)
+						// Border, uv seam and foldover check
+						if (!edge_is_collapsible(v0, v1))
 							continue;
 
 						//if (v0.border || v1.border) continue;
 
 						// Compute vertex to collapse to
 						vec3f p;
-						calculate_error(i0, i1, p);
+						double error = calculate_error(i0, i1, p);
+						if (attribute_stride)
+							error = geometric_error(i0, i1, p);
+						if (error > error_limit)
+							continue;
+
 						deleted0.resize(v0.tcount); // normals temporarily
 						deleted1.resize(v1.tcount); // normals temporarily
 						// don't remove if flipped
@@ -484,9 +706,24 @@ public:
 							update_uv2s(i0, v1, p, deleted1);
 						}
 
+						// Without the color quadrics p can be far from where the colors fit
+						if ((_format & VisualServer::ARRAY_FORMAT_COLOR) != 0 && _color_weight > 0) {
+							update_colors(i0, v0, p, deleted0);
+							update_colors(i0, v1, p, deleted1);
+						}
+
 						// not flipped, so remove edge
+						_max_collapse_error = MAX(_max_collapse_error, error);
+
+						if (_recording)
+							collapse_record(i0, i1, p);
+
 						v0.p = p;
 						v0.q = v1.q + v0.q;
+
+						if (attribute_stride)
+							attribute_quadrics_merge(i0, i1);
+
 						int tstart = refs.size();
 
 						update_triangles(i0, v0, deleted0, deleted_triangles);
@@ -510,200 +747,890 @@ public:
 				// done?
 				if (triangle_count - deleted_triangles <= target_count) break;
 			}
+
+			// Nothing changed, so the next iteration would not find anything either. With attribute
+			// quadrics only once the threshold is past every edge, see above
+			if (limited && (!attribute_stride || !above_threshold) && deleted_triangles == iteration_deleted_triangles)
+				break;
 		}
-		// clean up mesh
-		compact_mesh();
-	} //simplify_mesh()
+	} //simplify_mesh_collapse()
 
-	void simplify_mesh_lossless(bool verbose = false) {
-		ERR_FAIL_COND_MSG(_enable_smart_link, "FastQuadraticMeshSimplifier: enable_smart_link setting is not yet suppored!");
+	//
+	// Priority queue variant of simplify_mesh
+	//
+	// Always collapses the cheapest valid edge next, and stops as soon as
+	// target_count is reached, so there are no thresholds or iterations.
+	// Stale queue entries are detected using per vertex version stamps, which
+	// store the collapse that last changed the vertex.
+	//
 
-		// init
-		for (unsigned int i = 0; i < triangles.size(); ++i)
+	void simplify_mesh_queue(int target_count, bool verbose = false, double error_limit = DBL_MAX) {
+		for (unsigned int i = 0; i < triangles.size(); ++i) {
 			triangles[i].deleted = 0;
+		}
+
+		update_mesh(0);
 
-		// main iteration loop
 		int deleted_triangles = 0;
+		int triangle_count = triangles.size();
+		int collapse_count = 0;
 		std::vector<int> deleted0, deleted1;
-		//unsigned int triangle_count = triangles.size();
+		std::vector<int> versions(vertices.size(), 0);
+		std::vector<int> marks(vertices.size(), -1);
+		std::vector<CollapseEdge> queue;
+		int stamp = 0;
 
-		for (int iteration = 0; iteration < _max_lossless_iteration_count; iteration++) {
-			// update mesh constantly
-			update_mesh(iteration);
-			// clear dirty flag
-			for (unsigned int i = 0; i < triangles.size(); ++i)
-				triangles[i].dirty = 0;
-			//
-			// All triangles with edges below the threshold will be removed
-			//
-			// The following numbers works well for most models.
-			// If it does not, try to adjust the 3 parameters
-			//
-			double threshold = DBL_EPSILON; //1.0E-3 EPS;
-			if (verbose) {
-				print_line("lossless iteration " + String::num(iteration));
-			}
+		queue.reserve(triangles.size() * 3 / 2);
 
-			// remove vertices & mark deleted triangles
-			for (unsigned int i = 0; i < triangles.size(); ++i) {
-				Triangle &t = triangles[i];
+		for (unsigned int i = 0; i < vertices.size(); ++i) {
+			collapse_queue_push_edges(i, true, 0, queue, marks, stamp++);
+		}
 
-				if (t.err[3] > threshold)
-					continue;
+		std::make_heap(queue.begin(), queue.end(), CollapseEdgeComparator());
 
-				if (t.deleted)
-					continue;
+		while (triangle_count - deleted_triangles > target_count && !queue.empty()) {
+			std::pop_heap(queue.begin(), queue.end(), CollapseEdgeComparator());
+			CollapseEdge e = queue.back();
+			queue.pop_back();
 
-				if (t.dirty)
-					continue;
+			if (versions[e.v0] > e.version || versions[e.v1] > e.version)
+				continue;
 
-				for (int j = 0; j < 3; ++j) {
-					if (t.err[j] < threshold) {
-						int i0 = t.v[j];
-						Vertex &v0 = vertices[i0];
-						int i1 = t.v[(j + 1) % 3];
-						Vertex &v1 = vertices[i1];
+			int i0 = e.v0;
+			Vertex &v0 = vertices[i0];
+			int i1 = e.v1;
+			Vertex &v1 = vertices[i1];
 
-						// Border check
-						if (v0.border != v1.border)
-							continue;
+			// Compute vertex to collapse to
+			vec3f p;
+			double error = calculate_error(i0, i1, p);
+			if (attribute_stride)
+				error = geometric_error(i0, i1, p);
 
-						// Compute vertex to collapse to
-						vec3f p;
-						calculate_error(i0, i1, p);
+			if (error > error_limit) {
+				// Every edge left in the queue is at least this bad, unless the attribute quadrics ordered it
+				if (!attribute_stride)
+					break;
 
-						deleted0.resize(v0.tcount); // normals temporarily
-						deleted1.resize(v1.tcount); // normals temporarily
+				continue;
+			}
 
-						// don't remove if flipped
-						if (flipped(p, i0, i1, v0, v1, deleted0))
-							continue;
+			deleted0.resize(v0.tcount); // normals temporarily
+			deleted1.resize(v1.tcount); // normals temporarily
 
-						if (flipped(p, i1, i0, v1, v0, deleted1))
-							continue;
+			// don't remove if flipped
+			if (flipped(p, i0, i1, v0, v1, deleted0))
+				continue;
 
-						if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV) != 0) {
-							update_uvs(i0, v0, p, deleted0);
-							update_uvs(i0, v1, p, deleted1);
-						}
+			if (flipped(p, i1, i0, v1, v0, deleted1))
+				continue;
 
-						if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV2) != 0) {
-							update_uv2s(i0, v0, p, deleted0);
-							update_uv2s(i0, v1, p, deleted1);
-						}
+			if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV) != 0) {
+				update_uvs(i0, v0, p, deleted0);
+				update_uvs(i0, v1, p, deleted1);
+			}
 
-						// not flipped, so remove edge
-						v0.p = p;
-						v0.q = v1.q + v0.q;
-						int tstart = refs.size();
+			if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV2) != 0) {
+				update_uv2s(i0, v0, p, deleted0);
+				update_uv2s(i0, v1, p, deleted1);
+			}
 
-						update_triangles(i0, v0, deleted0, deleted_triangles);
-						update_triangles(i0, v1, deleted1, deleted_triangles);
+			// Without the color quadrics p can be far from where the colors fit
+			if ((_format & VisualServer::ARRAY_FORMAT_COLOR) != 0 && _color_weight > 0) {
+				update_colors(i0, v0, p, deleted0);
+				update_colors(i0, v1, p, deleted1);
+			}
 
-						int tcount = refs.size() - tstart;
+			// not flipped, so remove edge
+			_max_collapse_error = MAX(_max_collapse_error, error);
 
-						if (tcount <= v0.tcount) {
-							// save ram
-							if (tcount) memcpy(&refs[v0.tstart], &refs[tstart], tcount * sizeof(Ref));
-						} else {
-							// append
-							v0.tstart = tstart;
-						}
+			if (_recording)
+				collapse_record(i0, i1, p);
 
-						v0.tcount = tcount;
-						break;
-					}
-				}
-			}
+			v0.p = p;
+			v0.q = v1.q + v0.q;
 
-			if (deleted_triangles <= 0)
-				break;
+			if (attribute_stride)
+				attribute_quadrics_merge(i0, i1);
 
-			deleted_triangles = 0;
-		} //for each iteration
-		// clean up mesh
-		compact_mesh();
-	} //simplify_mesh_lossless()
+			int tstart = refs.size();
 
-	// Check if a triangle flips when this edge is removed
+			update_triangles(i0, v0, deleted0, deleted_triangles, false);
+			update_triangles(i0, v1, deleted1, deleted_triangles, false);
 
-	bool flipped(vec3f p, int i0, int i1, Vertex &v0, Vertex &v1, std::vector<int> &deleted) {
+			int tcount = refs.size() - tstart;
 
-		for (int k = 0; k < v0.tcount; ++k) {
-			Triangle &t = triangles[refs[v0.tstart + k].tid];
+			if (tcount <= v0.tcount) {
+				// save ram
+				if (tcount) memcpy(&refs[v0.tstart], &refs[tstart], tcount * sizeof(Ref));
+				refs.resize(tstart);
+			} else {
+				// append
+				v0.tstart = tstart;
+			}
 
-			if (t.deleted)
-				continue;
+			v0.tcount = tcount;
+			v1.tcount = 0;
 
-			int s = refs[v0.tstart + k].tvertex;
-			int id1 = t.v[(s + 1) % 3];
-			int id2 = t.v[(s + 2) % 3];
+			++collapse_count;
+			versions[i0] = collapse_count;
+			versions[i1] = collapse_count;
 
-			if (id1 == i1 || id2 == i1) // delete ?
-			{
-				deleted[k] = 1;
-				continue;
+			collapse_queue_push_edges(i0, false, collapse_count, queue, marks, stamp++);
+
+			// Most entries are stale by now, drop them so popping stays cheap
+			if (queue.size() > (unsigned int)(triangle_count - deleted_triangles) * 3) {
+				collapse_queue_prune(queue, versions);
 			}
-			vec3f d1 = vertices[id1].p - p;
-			d1.normalize();
-			vec3f d2 = vertices[id2].p - p;
-			d2.normalize();
-			if (fabs(d1.dot(d2)) > 0.999) return true;
-			vec3f n;
-			n.cross(d1, d2);
-			n.normalize();
-			deleted[k] = 0;
-			if (n.dot(t.n) < 0.2) return true;
 		}
-		return false;
-	}
 
-	// update_uvs
+		if (verbose) {
+			print_line("collapses " + String::num(collapse_count) + " - triangles " + String::num(triangle_count - deleted_triangles));
+		}
+	} //simplify_mesh_queue()
 
-	void update_uvs(int i0, const Vertex &v, const vec3f &p, std::vector<int> &deleted) {
-		for (int k = 0; k < v.tcount; ++k) {
-			Ref &r = refs[v.tstart + k];
-			Triangle &t = triangles[r.tid];
+	// Push every collapsible edge around a vertex into the collapse queue
+	// p_only_greater is used for the initial fill, so every edge only gets pushed once
+
+	void collapse_queue_push_edges(int i0, bool p_only_greater, int version, std::vector<CollapseEdge> &queue, std::vector<int> &marks, int stamp) {
+		Vertex &v0 = vertices[i0];
+		marks[i0] = stamp;
+
+		for (int k = 0; k < v0.tcount; ++k) {
+			Triangle &t = triangles[refs[v0.tstart + k].tid];
 
 			if (t.deleted)
 				continue;
 
-			if (deleted[k])
-				continue;
+			for (int j = 0; j < 3; ++j) {
+				int i1 = t.v[j];
 
-			vec3f p1 = vertices[t.v[0]].p;
-			vec3f p2 = vertices[t.v[1]].p;
-			vec3f p3 = vertices[t.v[2]].p;
+				if (marks[i1] == stamp)
+					continue;
 
-			t.uvs[r.tvertex] = interpolate(p, p1, p2, p3, t.uvs);
-		}
-	}
+				marks[i1] = stamp;
 
-	void update_uv2s(int i0, const Vertex &v, const vec3f &p, std::vector<int> &deleted) {
-		for (int k = 0; k < v.tcount; ++k) {
-			Ref &r = refs[v.tstart + k];
-			Triangle &t = triangles[r.tid];
+				if (p_only_greater && i1 < i0)
+					continue;
 
-			if (t.deleted)
-				continue;
+				Vertex &v1 = vertices[i1];
 
-			if (deleted[k])
-				continue;
+				// Border, uv seam and foldover check
+				if (!edge_is_collapsible(v0, v1))
+					continue;
 
-			vec3f p1 = vertices[t.v[0]].p;
-			vec3f p2 = vertices[t.v[1]].p;
-			vec3f p3 = vertices[t.v[2]].p;
+				vec3f p;
+				CollapseEdge e;
+				e.error = calculate_error(i0, i1, p);
+				e.v0 = i0;
+				e.v1 = i1;
+				e.version = version;
 
-			t.uv2s[r.tvertex] = interpolate(p, p1, p2, p3, t.uv2s);
+				queue.push_back(e);
+
+				if (!p_only_greater) {
+					std::push_heap(queue.begin(), queue.end(), CollapseEdgeComparator());
+				}
+			}
 		}
 	}
 
-	// Update triangle connections and edge error after a edge is collapsed
+	// Remove stale entries, and restore the heap property
 
-	void update_triangles(int i0, Vertex &v, std::vector<int> &deleted, int &deleted_triangles) {
-		vec3f p;
+	void collapse_queue_prune(std::vector<CollapseEdge> &queue, const std::vector<int> &versions) {
+		unsigned int dst = 0;
 
-		for (int k = 0; k < v.tcount; ++k) {
+		for (unsigned int i = 0; i < queue.size(); ++i) {
+			const CollapseEdge &e = queue[i];
+
+			if (versions[e.v0] > e.version || versions[e.v1] > e.version)
+				continue;
+
+			queue[dst++] = e;
+		}
+
+		queue.resize(dst);
+
+		std::make_heap(queue.begin(), queue.end(), CollapseEdgeComparator());
+	}
+
+	//
+	// Parallel variant of simplify_mesh
+	//
+	// The triangles are split into spatially compact clusters, which are simplified on the worker
+	// threads with the vertices they share with other clusters locked. Then a short serial pass
+	// simplifies the dense strips left around the locked vertices. Only if that still can't reach
+	// target_count, the whole mesh is simplified again.
+	//
+
+	void simplify_mesh_clusters(int target_count, double agressiveness, bool verbose) {
+		for (unsigned int i = 0; i < triangles.size(); ++i) {
+			triangles[i].deleted = 0;
+		}
+
+		// The clusters can't see across their borders, so the flags that they can't find for
+		// themselves are found for the whole mesh first
+		if (_enable_smart_link || _preserve_uv_seam_edges || _preserve_uv_foldover_edges) {
+			vertex_flags_update();
+		}
+
+		Clusters clusters;
+		clusters.ratio = (double)target_count / triangles.size();
+		clusters.agressiveness = agressiveness;
+		clusters_build(cluster_count_get(), clusters);
+
+		parallel_run(clusters.clusters.size(), &FQMS::cluster_simplify, &clusters);
+
+		clusters_merge(clusters, 0);
+
+		if (verbose) {
+			print_line("clusters " + String::num(clusters.clusters.size()) + " - triangles " + String::num(triangles.size()));
+		}
+
+		clusters_cleanup(clusters.owners, target_count, agressiveness);
+
+		if (verbose) {
+			print_line("cluster seams - triangles " + String::num(triangles.size()));
+		}
+
+		// The borders were already welded by vertex_flags_update()
+		if ((int)triangles.size() > target_count) {
+			simplify_mesh_collapse(target_count, agressiveness, verbose);
+		}
+
+		// clean up mesh
+		compact_mesh();
+	} //simplify_mesh_clusters()
+
+	int cluster_count_get() const {
+		// The clusters don't record their collapses
+		if (_recording)
+			return 1;
+
+		return MIN(_cluster_count, (int)triangles.size() / CLUSTER_MIN_TRIANGLES);
+	}
+
+	// Border, uv seam and foldover flags for the whole mesh. With smart link the borders are welded first.
+
+	void vertex_flags_update() {
+		for (unsigned int i = 0; i < vertices.size(); ++i) {
+			vertices[i].border = 0;
+		}
+
+		update_references();
+		border_edges_update();
+
+		if (_enable_smart_link && !_linked) {
+			vertices_link();
+			update_references();
+
+			for (unsigned int i = 0; i < vertices.size(); ++i) {
+				vertices[i].border = 0;
+			}
+
+			border_edges_update();
+		}
+
+		uv_seams_update();
+	}
+
+	// Splits the triangles into p_count clusters with (almost) the same size, and finds the vertices they share
+
+	void clusters_build(int p_count, Clusters &r_clusters) {
+		std::vector<vec3f> centers(triangles.size());
+		std::vector<int> ids(triangles.size());
+
+		uint32_t chunk_count = (triangles.size() + CLUSTER_CHUNK_SIZE - 1) / CLUSTER_CHUNK_SIZE;
+		parallel_run(chunk_count, &FQMS::cluster_centers_find, &centers);
+
+		for (unsigned int i = 0; i < triangles.size(); ++i) {
+			ids[i] = i;
+		}
+
+		std::vector<int> ends;
+		clusters_split(ids, centers, 0, ids.size(), p_count, ends);
+
+		r_clusters.clusters.resize(ends.size());
+		r_clusters.owners.resize(vertices.size(), -1);
+		r_clusters.local_ids.resize(vertices.size(), -1);
+
+		int begin = 0;
+		for (unsigned int i = 0; i < ends.size(); ++i) {
+			Cluster &cluster = r_clusters.clusters[i];
+
+			cluster.triangle_ids.assign(ids.begin() + begin, ids.begin() + ends[i]);
+			// Set by cluster_simplify(), once it knows how many triangles are locked
+			cluster.target_count = -1;
+
+			for (int j = begin; j < ends[i]; ++j) {
+				const Triangle &t = triangles[ids[j]];
+
+				for (int k = 0; k < 3; ++k) {
+					int &owner = r_clusters.owners[t.v[k]];
+
+					if (owner == -1) {
+						owner = i;
+					} else if (owner != (int)i) {
+						owner = CLUSTER_SHARED;
+					}
+				}
+			}
+
+			begin = ends[i];
+		}
+	}
+
+	// Can run on the worker threads, every chunk only writes its own centers
+
+	void cluster_centers_find(uint32_t p_chunk, std::vector<vec3f> *r_centers) {
+		int from = p_chunk * CLUSTER_CHUNK_SIZE;
+		int to = MIN(from + CLUSTER_CHUNK_SIZE, (int)triangles.size());
+
+		for (int i = from; i < to; ++i) {
+			const Triangle &t = triangles[i];
+
+			(*r_centers)[i] = (vertices[t.v[0]].p + vertices[t.v[1]].p + vertices[t.v[2]].p) / 3;
+		}
+	}
+
+	// Recursively halves r_ids[p_begin, p_end) at the median of the longest axis of the triangle centers
+
+	void clusters_split(std::vector<int> &r_ids, const std::vector<vec3f> &p_centers, int p_begin, int p_end, int p_count, std::vector<int> &r_ends) {
+		if (p_count <= 1) {
+			r_ends.push_back(p_end);
+			return;
+		}
+
+		vec3f min_p = p_centers[r_ids[p_begin]];
+		vec3f max_p = min_p;
+
+		for (int i = p_begin + 1; i < p_end; ++i) {
+			const vec3f &c = p_centers[r_ids[i]];
+
+			min_p.x = MIN(min_p.x, c.x);
+			min_p.y = MIN(min_p.y, c.y);
+			min_p.z = MIN(min_p.z, c.z);
+			max_p.x = MAX(max_p.x, c.x);
+			max_p.y = MAX(max_p.y, c.y);
+			max_p.z = MAX(max_p.z, c.z);
+		}
+
+		vec3f size = max_p - min_p;
+
+		int axis = 0;
+		if (size.y > size.x && size.y >= size.z) {
+			axis = 1;
+		} else if (size.z > size.x && size.z > size.y) {
+			axis = 2;
+		}
+
+		int count = p_count / 2;
+		int mid = p_begin + (int)((int64_t)(p_end - p_begin) * count / p_count);
+
+		std::nth_element(r_ids.begin() + p_begin, r_ids.begin() + mid, r_ids.begin() + p_end, TriangleCenterComparator(p_centers.data(), axis));
+
+		clusters_split(r_ids, p_centers, p_begin, mid, count, r_ends);
+		clusters_split(r_ids, p_centers, mid, p_end, p_count - count, r_ends);
+	}
+
+	// Runs on the worker threads. Simplifies a cluster in its own FQMS, only reading the shared data.
+
+	void cluster_simplify(uint32_t p_index, Clusters *p_clusters) {
+		Cluster &cluster = p_clusters->clusters[p_index];
+
+		FQMS fqms;
+		fqms._max_iteration_count = _max_iteration_count;
+		fqms._preserve_border_dges = _preserve_border_dges;
+		fqms._preserve_uv_seam_edges = _preserve_uv_seam_edges;
+		fqms._preserve_uv_foldover_edges = _preserve_uv_foldover_edges;
+		fqms._enable_collapse_queue = _enable_collapse_queue;
+		fqms._format = _format;
+		fqms._uv_weight = _uv_weight;
+		fqms._uv2_weight = _uv2_weight;
+		fqms._color_weight = _color_weight;
+		fqms._error_scale = _error_scale;
+		fqms._use_threads = false;
+
+		// Only this cluster writes the local ids of the vertices it owns.
+		// The shared vertices come after those, and are looked up in shared_ids.
+		const std::vector<int> &owners = p_clusters->owners;
+		std::vector<int> &local_ids = p_clusters->local_ids;
+		std::vector<int> &vertex_ids = cluster.vertex_ids;
+		std::vector<int> shared_ids;
+
+		vertex_ids.reserve(cluster.triangle_ids.size() / 2 + 1);
+
+		for (unsigned int i = 0; i < cluster.triangle_ids.size(); ++i) {
+			const Triangle &t = triangles[cluster.triangle_ids[i]];
+
+			for (int j = 0; j < 3; ++j) {
+				int index = t.v[j];
+
+				if (owners[index] != (int)p_index) {
+					shared_ids.push_back(index);
+				} else if (local_ids[index] == -1) {
+					local_ids[index] = vertex_ids.size();
+					vertex_ids.push_back(index);
+				}
+			}
+		}
+
+		std::sort(shared_ids.begin(), shared_ids.end());
+		shared_ids.erase(std::unique(shared_ids.begin(), shared_ids.end()), shared_ids.end());
+
+		int shared_start = vertex_ids.size();
+		vertex_ids.insert(vertex_ids.end(), shared_ids.begin(), shared_ids.end());
+
+		fqms.vertices.resize(vertex_ids.size());
+
+		for (unsigned int i = 0; i < vertex_ids.size(); ++i) {
+			const Vertex &src = vertices[vertex_ids[i]];
+			Vertex &v = fqms.vertices[i];
+
+			v.p = src.p;
+			v.border = 0;
+			v.seam = src.seam;
+			v.foldover = src.foldover;
+			v.welded = src.welded;
+			v.locked = owners[vertex_ids[i]] == CLUSTER_SHARED;
+		}
+
+		fqms.triangles_resize(cluster.triangle_ids.size());
+
+		int locked_count = 0;
+
+		for (unsigned int i = 0; i < cluster.triangle_ids.size(); ++i) {
+			int tid = cluster.triangle_ids[i];
+			Triangle t = triangles[tid];
+			bool locked = false;
+
+			for (int j = 0; j < 3; ++j) {
+				int index = t.v[j];
+
+				if (owners[index] == (int)p_index) {
+					t.v[j] = local_ids[index];
+				} else {
+					t.v[j] = shared_start + (std::lower_bound(shared_ids.begin(), shared_ids.end(), index) - shared_ids.begin());
+					locked = true;
+				}
+			}
+
+			if (locked) {
+				++locked_count;
+			}
+
+			t.deleted = 0;
+			t.dirty = 0;
+
+			fqms.triangles[i] = t;
+			fqms.triangle_normals[i] = triangle_normals[tid];
+
+			for (int j = 0; j < 3; ++j) {
+				if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV) != 0) {
+					fqms.triangle_uvs[i * 3 + j] = triangle_uvs[tid * 3 + j];
+				}
+
+				if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV2) != 0) {
+					fqms.triangle_uv2s[i * 3 + j] = triangle_uv2s[tid * 3 + j];
+				}
+
+				if ((_format & VisualServer::ARRAY_FORMAT_COLOR) != 0) {
+					fqms.triangle_colors[i * 3 + j] = triangle_colors[tid * 3 + j];
+				}
+			}
+		}
+
+		// Triangles around the locked vertices can't be removed, so the rest of the cluster gets
+		// simplified further instead, and clusters_cleanup() takes care of them
+		if (cluster.target_count < 0) {
+			cluster.target_count = (int)(p_clusters->ratio * (cluster.triangle_ids.size() - locked_count)) + locked_count;
+		}
+
+		fqms.simplify_mesh_collapse(cluster.target_count, p_clusters->agressiveness, false);
+
+		cluster.max_error = fqms._max_collapse_error;
+
+		cluster.positions.resize(vertex_ids.size());
+
+		for (unsigned int i = 0; i < vertex_ids.size(); ++i) {
+			cluster.positions[i] = fqms.vertices[i].p;
+		}
+
+		int dst = 0;
+		for (unsigned int i = 0; i < fqms.triangles.size(); ++i) {
+			Triangle &t = fqms.triangles[i];
+
+			if (t.deleted)
+				continue;
+
+			for (int j = 0; j < 3; ++j) {
+				t.v[j] = vertex_ids[t.v[j]];
+			}
+
+			t.dirty = 0;
+
+			fqms.triangle_move(dst++, i);
+		}
+
+		fqms.triangles_resize(dst);
+
+		cluster.triangles.swap(fqms.triangles);
+		cluster.triangle_normals.swap(fqms.triangle_normals);
+		cluster.triangle_uvs.swap(fqms.triangle_uvs);
+		cluster.triangle_uv2s.swap(fqms.triangle_uv2s);
+		cluster.triangle_colors.swap(fqms.triangle_colors);
+	}
+
+	// Simplifies the triangles around the vertices the clusters shared, as a single cluster.
+	// Its own border with the rest of the mesh is locked.
+
+	void clusters_cleanup(const std::vector<int> &p_owners, int p_target_count, double agressiveness) {
+		int excess = triangles.size() - p_target_count;
+
+		if (excess <= 0)
+			return;
+
+		// The shared vertices, and the rings of vertices around them
+		std::vector<uint8_t> near(vertices.size(), 0);
+
+		for (unsigned int i = 0; i < vertices.size(); ++i) {
+			if (p_owners[i] == CLUSTER_SHARED) {
+				near[i] = 1;
+			}
+		}
+
+		for (int ring = 1; ring <= CLUSTER_SEAM_RINGS; ++ring) {
+			for (unsigned int i = 0; i < triangles.size(); ++i) {
+				const Triangle &t = triangles[i];
+
+				if (near[t.v[0]] == ring || near[t.v[1]] == ring || near[t.v[2]] == ring) {
+					for (int j = 0; j < 3; ++j) {
+						if (near[t.v[j]] == 0) {
+							near[t.v[j]] = ring + 1;
+						}
+					}
+				}
+			}
+		}
+
+		Clusters seams;
+		seams.agressiveness = agressiveness;
+		seams.clusters.resize(1);
+		seams.owners.resize(vertices.size(), -1);
+		seams.local_ids.resize(vertices.size(), -1);
+
+		Cluster &cluster = seams.clusters[0];
+
+		for (unsigned int i = 0; i < triangles.size(); ++i) {
+			const Triangle &t = triangles[i];
+			int owner = (near[t.v[0]] || near[t.v[1]] || near[t.v[2]]) ? 0 : 1;
+
+			for (int j = 0; j < 3; ++j) {
+				int &o = seams.owners[t.v[j]];
+
+				if (o == -1) {
+					o = owner;
+				} else if (o != owner) {
+					o = CLUSTER_SHARED;
+				}
+			}
+
+			if (owner == 0) {
+				cluster.triangle_ids.push_back(i);
+			}
+		}
+
+		cluster.target_count = MAX((int)cluster.triangle_ids.size() - excess, 0);
+
+		cluster_simplify(0, &seams);
+
+		// Keep the rest in place, and put the simplified seams after it
+		int dst = 0;
+		for (unsigned int i = 0; i < triangles.size(); ++i) {
+			const Triangle &t = triangles[i];
+
+			if (!near[t.v[0]] && !near[t.v[1]] && !near[t.v[2]]) {
+				triangle_move(dst++, i);
+			}
+		}
+
+		clusters_merge(seams, dst);
+	}
+
+	// Puts the simplified clusters back together after the first p_offset triangles.
+	// Locked vertices never move, so it doesn't matter which cluster writes them back.
+
+	void clusters_merge(Clusters &p_clusters, int p_offset) {
+		int count = p_offset;
+
+		for (unsigned int i = 0; i < p_clusters.clusters.size(); ++i) {
+			count += p_clusters.clusters[i].triangles.size();
+		}
+
+		triangles_resize(count);
+
+		int dst = p_offset;
+		for (unsigned int i = 0; i < p_clusters.clusters.size(); ++i) {
+			const Cluster &cluster = p_clusters.clusters[i];
+
+			for (unsigned int j = 0; j < cluster.triangles.size(); ++j) {
+				triangles[dst] = cluster.triangles[j];
+				triangle_normals[dst] = cluster.triangle_normals[j];
+
+				for (int k = 0; k < 3; ++k) {
+					if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV) != 0) {
+						triangle_uvs[dst * 3 + k] = cluster.triangle_uvs[j * 3 + k];
+					}
+
+					if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV2) != 0) {
+						triangle_uv2s[dst * 3 + k] = cluster.triangle_uv2s[j * 3 + k];
+					}
+
+					if ((_format & VisualServer::ARRAY_FORMAT_COLOR) != 0) {
+						triangle_colors[dst * 3 + k] = cluster.triangle_colors[j * 3 + k];
+					}
+				}
+
+				++dst;
+			}
+
+			for (unsigned int j = 0; j < cluster.vertex_ids.size(); ++j) {
+				vertices[cluster.vertex_ids[j]].p = cluster.positions[j];
+			}
+
+			_max_collapse_error = MAX(_max_collapse_error, cluster.max_error);
+		}
+	}
+
+	void simplify_mesh_lossless(bool verbose = false) {
+		// init
+		for (unsigned int i = 0; i < triangles.size(); ++i)
+			triangles[i].deleted = 0;
+
+		// main iteration loop
+		int deleted_triangles = 0;
+		std::vector<int> deleted0, deleted1;
+		//unsigned int triangle_count = triangles.size();
+
+		for (int iteration = 0; iteration < _max_lossless_iteration_count; iteration++) {
+			// update mesh constantly
+			update_mesh(iteration);
+			// clear dirty flag
+			for (unsigned int i = 0; i < triangles.size(); ++i)
+				triangles[i].dirty = 0;
+			//
+			// All triangles with edges below the threshold will be removed
+			//
+			// The following numbers works well for most models.
+			// If it does not, try to adjust the 3 parameters
+			//
+			double threshold = DBL_EPSILON; //1.0E-3 EPS;
+			if (verbose) {
+				print_line("lossless iteration " + String::num(iteration));
+			}
+
+			// remove vertices & mark deleted triangles
+			for (unsigned int i = 0; i < triangles.size(); ++i) {
+				Triangle &t = triangles[i];
+
+				if (t.err[3] > threshold)
+					continue;
+
+				if (t.deleted)
+					continue;
+
+				if (t.dirty)
+					continue;
+
+				for (int j = 0; j < 3; ++j) {
+					if (t.err[j] < threshold) {
+						int i0 = t.v[j];
+						Vertex &v0 = vertices[i0];
+						int i1 = t.v[(j + 1) % 3];
+						Vertex &v1 = vertices[i1];
+
+						// Border, uv seam and foldover check
+						if (!edge_is_collapsible(v0, v1))
+							continue;
+
+						// Compute vertex to collapse to
+						vec3f p;
+						double error = calculate_error(i0, i1, p);
+						if (attribute_stride)
+							error = geometric_error(i0, i1, p);
+
+						deleted0.resize(v0.tcount); // normals temporarily
+						deleted1.resize(v1.tcount); // normals temporarily
+
+						// don't remove if flipped
+						if (flipped(p, i0, i1, v0, v1, deleted0))
+							continue;
+
+						if (flipped(p, i1, i0, v1, v0, deleted1))
+							continue;
+
+						if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV) != 0) {
+							update_uvs(i0, v0, p, deleted0);
+							update_uvs(i0, v1, p, deleted1);
+						}
+
+						if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV2) != 0) {
+							update_uv2s(i0, v0, p, deleted0);
+							update_uv2s(i0, v1, p, deleted1);
+						}
+
+						// Without the color quadrics p can be far from where the colors fit
+						if ((_format & VisualServer::ARRAY_FORMAT_COLOR) != 0 && _color_weight > 0) {
+							update_colors(i0, v0, p, deleted0);
+							update_colors(i0, v1, p, deleted1);
+						}
+
+						// not flipped, so remove edge
+						_max_collapse_error = MAX(_max_collapse_error, error);
+
+						if (_recording)
+							collapse_record(i0, i1, p);
+
+						v0.p = p;
+						v0.q = v1.q + v0.q;
+
+						if (attribute_stride)
+							attribute_quadrics_merge(i0, i1);
+
+						int tstart = refs.size();
+
+						update_triangles(i0, v0, deleted0, deleted_triangles);
+						update_triangles(i0, v1, deleted1, deleted_triangles);
+
+						int tcount = refs.size() - tstart;
+
+						if (tcount <= v0.tcount) {
+							// save ram
+							if (tcount) memcpy(&refs[v0.tstart], &refs[tstart], tcount * sizeof(Ref));
+						} else {
+							// append
+							v0.tstart = tstart;
+						}
+
+						v0.tcount = tcount;
+						break;
+					}
+				}
+			}
+
+			if (deleted_triangles <= 0)
+				break;
+
+			deleted_triangles = 0;
+		} //for each iteration
+		// clean up mesh
+		compact_mesh();
+	} //simplify_mesh_lossless()
+
+	// Check if a triangle flips when this edge is removed
+
+	bool flipped(vec3f p, int i0, int i1, Vertex &v0, Vertex &v1, std::vector<int> &deleted) {
+
+		for (int k = 0; k < v0.tcount; ++k) {
+			Triangle &t = triangles[refs[v0.tstart + k].tid];
+
+			if (t.deleted)
+				continue;
+
+			int s = refs[v0.tstart + k].tvertex;
+			int id1 = t.v[(s + 1) % 3];
+			int id2 = t.v[(s + 2) % 3];
+
+			if (id1 == i1 || id2 == i1) // delete ?
+			{
+				deleted[k] = 1;
+				continue;
+			}
+			vec3f d1 = vertices[id1].p - p;
+			d1.normalize();
+			vec3f d2 = vertices[id2].p - p;
+			d2.normalize();
+			if (fabs(d1.dot(d2)) > 0.999) return true;
+			vec3f n;
+			n.cross(d1, d2);
+			n.normalize();
+			deleted[k] = 0;
+			if (n.dot(triangle_normals[refs[v0.tstart + k].tid]) < 0.2) return true;
+		}
+		return false;
+	}
+
+	// update_uvs
+
+	void update_uvs(int i0, const Vertex &v, const vec3f &p, std::vector<int> &deleted) {
+		for (int k = 0; k < v.tcount; ++k) {
+			Ref &r = refs[v.tstart + k];
+			Triangle &t = triangles[r.tid];
+
+			if (t.deleted)
+				continue;
+
+			if (deleted[k])
+				continue;
+
+			vec3f p1 = vertices[t.v[0]].p;
+			vec3f p2 = vertices[t.v[1]].p;
+			vec3f p3 = vertices[t.v[2]].p;
+
+			vec3f *uvs = &triangle_uvs[r.tid * 3];
+			uvs[r.tvertex] = interpolate(p, p1, p2, p3, uvs);
+		}
+	}
+
+	void update_uv2s(int i0, const Vertex &v, const vec3f &p, std::vector<int> &deleted) {
+		for (int k = 0; k < v.tcount; ++k) {
+			Ref &r = refs[v.tstart + k];
+			Triangle &t = triangles[r.tid];
+
+			if (t.deleted)
+				continue;
+
+			if (deleted[k])
+				continue;
+
+			vec3f p1 = vertices[t.v[0]].p;
+			vec3f p2 = vertices[t.v[1]].p;
+			vec3f p3 = vertices[t.v[2]].p;
+
+			vec3f *uv2s = &triangle_uv2s[r.tid * 3];
+			uv2s[r.tvertex] = interpolate(p, p1, p2, p3, uv2s);
+		}
+	}
+
+	void update_colors(int i0, const Vertex &v, const vec3f &p, std::vector<int> &deleted) {
+		for (int k = 0; k < v.tcount; ++k) {
+			Ref &r = refs[v.tstart + k];
+			Triangle &t = triangles[r.tid];
+
+			if (t.deleted)
+				continue;
+
+			if (deleted[k])
+				continue;
+
+			vec3f p1 = vertices[t.v[0]].p;
+			vec3f p2 = vertices[t.v[1]].p;
+			vec3f p3 = vertices[t.v[2]].p;
+
+			Color *colors = &triangle_colors[r.tid * 3];
+			vec3f bary = barycentric(p, p1, p2, p3);
+			colors[r.tvertex] = colors[0] * bary.x + colors[1] * bary.y + colors[2] * bary.z;
+		}
+	}
+
+	// Update triangle connections and edge error after a edge is collapsed
+
+	// The collapse queue keeps its own edge errors, so it can skip recalculating them here
+
+	void update_triangles(int i0, Vertex &v, std::vector<int> &deleted, int &deleted_triangles, bool update_error = true) {
+		vec3f p;
+
+		for (int k = 0; k < v.tcount; ++k) {
 			Ref &r = refs[v.tstart + k];
 			Triangle &t = triangles[r.tid];
 
@@ -713,20 +1640,47 @@ public:
 			if (deleted[k]) {
 				t.deleted = 1;
 				deleted_triangles++;
+
+				if (_recording)
+					triangle_removals[triangle_sources[r.tid]] = collapse_records.size() - 1;
+
 				continue;
 			}
 
 			t.v[r.tvertex] = i0;
+			refs.push_back(r);
+
+			if (!update_error)
+				continue;
 
 			t.dirty = 1;
 			t.err[0] = calculate_error(t.v[0], t.v[1], p);
 			t.err[1] = calculate_error(t.v[1], t.v[2], p);
 			t.err[2] = calculate_error(t.v[2], t.v[0], p);
 			t.err[3] = min(t.err[0], min(t.err[1], t.err[2]));
-			refs.push_back(r);
 		}
 	}
 
+	// Records the collapse of the edge i0 - i1 into i0. p is the position of one of them (see calculate_error()),
+	// the input vertex of the other one is removed. Has to be called before the triangles are updated.
+
+	void collapse_record(int i0, int i1, const vec3f &p) {
+		const vec3f &p0 = vertices[i0].p;
+
+		CollapseRecord record;
+
+		if (p.x == p0.x && p.y == p0.y && p.z == p0.z) {
+			record.kept = vertex_sources[i0];
+			record.removed = vertex_sources[i1];
+		} else {
+			record.kept = vertex_sources[i1];
+			record.removed = vertex_sources[i0];
+			vertex_sources[i0] = record.kept;
+		}
+
+		collapse_records.push_back(record);
+	}
+
 	// compact triangles, compute edge error and build reference list
 
 	void update_mesh(int iteration) {
@@ -735,11 +1689,11 @@ public:
 			int dst = 0;
 			for (unsigned int i = 0; i < triangles.size(); ++i) {
 				if (!triangles[i].deleted) {
-					triangles[dst++] = triangles[i];
+					triangle_move(dst++, i);
 				}
 			}
 
-			triangles.resize(dst);
+			triangles_resize(dst);
 		}
 
 		//
@@ -751,7 +1705,17 @@ public:
 		//
 		if (iteration == 0) {
 			for (unsigned int i = 0; i < vertices.size(); ++i) {
-				vertices[i].q = SymetricMatrix(0.0);
+				Vertex &v = vertices[i];
+
+				v.q = SymetricMatrix(0.0);
+				v.border = 0;
+			}
+
+			// Weld the borders first, so the quadrics already see the linked triangles
+			if (_enable_smart_link && !_linked) {
+				update_references();
+				border_edges_update();
+				vertices_link();
 			}
 
 			for (unsigned int i = 0; i < triangles.size(); ++i) {
@@ -763,11 +1727,19 @@ public:
 
 				n.cross(p[1] - p[0], p[2] - p[0]);
 				n.normalize();
-				t.n = n;
+				triangle_normals[i] = n;
+
+				// Degenerate triangles have no plane, it would only make the quadrics NaN
+				if (n.x != n.x)
+					continue;
+
 				for (int j = 0; j < 3; ++j) {
 					vertices[t.v[j]].q = vertices[t.v[j]].q + SymetricMatrix(n.x, n.y, n.z, -n.dot(p[0]));
 				}
 			}
+
+			attribute_quadrics_update();
+
 			for (unsigned int i = 0; i < triangles.size(); ++i) {
 				// Calc Edge Error
 				Triangle &t = triangles[i];
@@ -781,6 +1753,22 @@ public:
 			}
 		}
 
+		update_references();
+
+		// Identify boundary : vertices[].border=0,1
+		if (iteration == 0) {
+			for (unsigned int i = 0; i < vertices.size(); ++i) {
+				vertices[i].border = 0;
+			}
+
+			border_edges_update();
+			uv_seams_update();
+		}
+	}
+
+	// Build the vertex -> triangle reference list
+
+	void update_references() {
 		// Init Reference ID list
 		for (unsigned int i = 0; i < vertices.size(); ++i) {
 			vertices[i].tstart = 0;
@@ -815,149 +1803,381 @@ public:
 				v.tcount++;
 			}
 		}
+	}
 
-		// Identify boundary : vertices[].border=0,1
-		if (iteration == 0) {
-			std::vector<int> vcount, vids;
+	// Border edges
+	//
+	// Every edge is put into the bucket of its lower vertex index once per triangle using it.
+	// Edges that only show up once in their bucket are used by a single triangle, so they are borders.
+	// The buckets are independent, so large meshes sort them on the worker threads.
 
-			for (unsigned int i = 0; i < vertices.size(); ++i) {
-				Vertex &v = vertices[i];
+	void border_edges_update() {
+		BorderEdges edges;
 
-				v.border = 0;
-				v.seam = false;
-				v.foldover = false;
+		edges.offsets.resize(vertices.size() + 1, 0);
+
+		for (unsigned int i = 0; i < triangles.size(); ++i) {
+			const Triangle &t = triangles[i];
+
+			for (int j = 0; j < 3; ++j) {
+				int a = t.v[j];
+				int b = t.v[(j + 1) % 3];
+
+				if (a != b) {
+					edges.offsets[MIN(a, b) + 1]++;
+				}
 			}
+		}
 
-			int border_vertex_count = 0;
-			double border_min_x = DBL_MIN;
-			double border_max_x = DBL_MAX;
+		for (unsigned int i = 0; i < vertices.size(); ++i) {
+			edges.offsets[i + 1] += edges.offsets[i];
+		}
 
-			for (unsigned int i = 0; i < vertices.size(); ++i) {
-				Vertex &v = vertices[i];
-				vcount.clear();
-				vids.clear();
+		std::vector<int> fill(edges.offsets.begin(), edges.offsets.end() - 1);
 
-				for (int j = 0; j < v.tcount; ++j) {
-					int kt = refs[v.tstart + j].tid;
-					Triangle &t = triangles[kt];
+		edges.others.resize(edges.offsets[vertices.size()]);
+		edges.border.resize(edges.others.size(), 0);
 
-					for (int k = 0; k < 3; ++k) {
-						unsigned int ofs = 0;
-						int id = t.v[k];
+		for (unsigned int i = 0; i < triangles.size(); ++i) {
+			const Triangle &t = triangles[i];
 
-						while (ofs < vcount.size()) {
-							if (vids[ofs] == id)
-								break;
+			for (int j = 0; j < 3; ++j) {
+				int a = t.v[j];
+				int b = t.v[(j + 1) % 3];
 
-							ofs++;
-						}
+				if (a != b) {
+					edges.others[fill[MIN(a, b)]++] = MAX(a, b);
+				}
+			}
+		}
 
-						if (ofs == vcount.size()) {
-							vcount.push_back(1);
-							vids.push_back(id);
-						} else {
-							vcount[ofs]++;
-						}
-					}
+		uint32_t chunk_count = (vertices.size() + BORDER_EDGES_CHUNK_SIZE - 1) / BORDER_EDGES_CHUNK_SIZE;
+
+		if (_use_threads && vertices.size() >= BORDER_EDGES_PARALLEL_MIN_VERTICES) {
+			parallel_run(chunk_count, &FQMS::border_edges_find, &edges);
+		} else {
+			for (uint32_t i = 0; i < chunk_count; ++i) {
+				border_edges_find(i, &edges);
+			}
+		}
+
+		for (unsigned int i = 0; i < vertices.size(); ++i) {
+			for (int j = edges.offsets[i]; j < edges.offsets[i + 1]; ++j) {
+				if (edges.border[j]) {
+					vertices[i].border = 1;
+					vertices[edges.others[j]].border = 1;
 				}
+			}
+		}
+	}
 
-				for (unsigned int j = 0; j < vcount.size(); ++j) {
-					if (vcount[j] == 1) {
-						Vertex &vv = vertices[vids[j]];
+	// Can run on the worker threads, every chunk only writes its own buckets
 
-						vv.border = 1;
-						++border_vertex_count;
+	void border_edges_find(uint32_t p_chunk, BorderEdges *p_edges) {
+		int from = p_chunk * BORDER_EDGES_CHUNK_SIZE;
+		int to = MIN(from + BORDER_EDGES_CHUNK_SIZE, (int)vertices.size());
 
-						if (_enable_smart_link) {
-							if (vv.p.x < border_min_x)
-								border_min_x = vv.p.x;
+		int *others = p_edges->others.data();
+		uint8_t *border = p_edges->border.data();
 
-							if (vv.p.x < border_max_x)
-								border_max_x = vv.p.x;
-						}
-					}
+		for (int i = from; i < to; ++i) {
+			int begin = p_edges->offsets[i];
+			int end = p_edges->offsets[i + 1];
+
+			std::sort(others + begin, others + end);
+
+			int j = begin;
+			while (j < end) {
+				int k = j + 1;
+
+				while (k < end && others[k] == others[j]) {
+					++k;
+				}
+
+				if (k - j == 1) {
+					border[j] = 1;
 				}
 
-				if (_enable_smart_link) {
-					std::vector<BorderVertex> border_vertices;
+				j = k;
+			}
+		}
+	}
 
-					double border_area_width = border_max_x - border_min_x;
+	// UV seams and foldovers
+	//
+	// Border vertices that share their position with an other border vertex were split when the mesh was built.
+	// If their uvs differ they are on a uv seam, otherwise they are on a foldover.
 
-					for (unsigned int j = 0; j < vertices.size(); j++) {
-						Vertex &vj = vertices[i];
+	void uv_seams_update() {
+		if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV) == 0)
+			return;
 
-						if (v.border) {
-							BorderVertex bv;
-							bv.hash = static_cast<int>(((((vj.p.x - border_min_x) / border_area_width) * 2.0) - 1.0) * INT_MAX);
-							bv.index = j;
+		std::vector<int> border_vertices;
 
-							border_vertices.push_back(bv);
-						}
+		for (unsigned int i = 0; i < vertices.size(); ++i) {
+			if (vertices[i].border && vertices[i].tcount > 0) {
+				border_vertices.push_back(i);
+			}
+		}
+
+		std::sort(border_vertices.begin(), border_vertices.end(), VertexPositionComparator(vertices.data()));
+
+		unsigned int i = 0;
+		while (i < border_vertices.size()) {
+			unsigned int k = i + 1;
+			const vec3f &p = vertices[border_vertices[i]].p;
+
+			while (k < border_vertices.size() && vertices[border_vertices[k]].p.x == p.x && vertices[border_vertices[k]].p.y == p.y && vertices[border_vertices[k]].p.z == p.z) {
+				++k;
+			}
+
+			for (unsigned int j = i; j < k; ++j) {
+				Vertex &vj = vertices[border_vertices[j]];
+				vec3f uvj = vertex_uv(border_vertices[j]);
+
+				for (unsigned int l = j + 1; l < k; ++l) {
+					Vertex &vl = vertices[border_vertices[l]];
+					vec3f uvl = vertex_uv(border_vertices[l]);
+
+					if (uvj.x == uvl.x && uvj.y == uvl.y) {
+						vj.foldover = true;
+						vl.foldover = true;
+					} else {
+						vj.seam = true;
+						vl.seam = true;
 					}
+				}
+			}
+
+			i = k;
+		}
+	}
 
-					std::sort(border_vertices.begin(), border_vertices.end(), compare_border_vertex);
+	// Smart link
+	//
+	// Border vertices closer than _vertex_link_distance to an earlier border vertex are welded into it,
+	// so separately built parts of a mesh (like the submeshes MeshMerger puts together) can be simplified
+	// across their shared borders. Candidates are found using a spatial hash with a cell size of
+	// _vertex_link_distance. Only the positions are welded, the corners keep their own attributes,
+	// and get_arrays() splits welded vertices again where those differ.
 
-					// Calculate the maximum hash distance based on the maximum vertex link distance
-					int tdst = static_cast<int>((_vertex_link_distance / border_area_width) * INT_MAX);
-					int hash_max_distance = MAX(tdst, 1);
+	void vertices_link() {
+		_linked = true;
 
-					// Then find identical border vertices and bind them together as one
-					for (unsigned int j = 0; j < border_vertices.size(); ++j) {
-						BorderVertex &bv = border_vertices[j];
+		std::vector<int> border_vertices;
 
-						if (bv.index == -1)
-							continue;
+		for (unsigned int i = 0; i < vertices.size(); ++i) {
+			if (vertices[i].border && vertices[i].tcount > 0) {
+				border_vertices.push_back(i);
+			}
+		}
 
-						//var myPoint = vertices[myIndex].p;
-						for (unsigned int k = i + 1; k < border_vertices.size(); ++k) {
-							BorderVertex &obv = border_vertices[k];
+		if (border_vertices.size() < 2)
+			return;
 
-							//int otherIndex = obv.index;
-							//var otherPoint = vertices[otherIndex].p;
-							if (obv.index == -1)
-								continue;
+		double cell_size = MAX(_vertex_link_distance, LINK_MIN_CELL_SIZE);
+		double max_distance_sq = _vertex_link_distance * _vertex_link_distance;
 
-							else if ((obv.hash - bv.hash) > hash_max_distance) // There is no point to continue beyond this point
-								break;
+		uint32_t table_size = 1;
+		while (table_size < border_vertices.size() * 2) {
+			table_size <<= 1;
+		}
+
+		// Only vertices that stay are inserted, chained through next
+		std::vector<int> heads(table_size, -1);
+		std::vector<int> next(vertices.size(), -1);
+
+		for (unsigned int i = 0; i < border_vertices.size(); ++i) {
+			int index = border_vertices[i];
+			const vec3f &p = vertices[index].p;
+
+			int64_t cx = (int64_t)floor(p.x / cell_size);
+			int64_t cy = (int64_t)floor(p.y / cell_size);
+			int64_t cz = (int64_t)floor(p.z / cell_size);
+
+			int target = -1;
 
-							Vertex &vj = vertices[j];
-							Vertex &ov = vertices[k];
-
-							double sqr_x = ((vj.p.x - ov.p.x) * (vj.p.x - ov.p.x));
-							double sqr_y = ((vj.p.y - ov.p.y) * (vj.p.y - ov.p.y));
-							double sqr_z = ((vj.p.z - ov.p.z) * (vj.p.z - ov.p.z));
-							double sqr_magnitude = sqr_x + sqr_y + sqr_z;
-
-							if (sqr_magnitude <= _vertex_link_distance) {
-								obv.index = -1; // NOTE: This makes sure that the "other" vertex is not processed again
-								vj.border = false;
-								ov.border = false;
-								/*
-								if (AreUVsTheSame(0, myIndex, otherIndex)) {
-									vertices[myIndex].foldover = true;
-									vertices[otherIndex].foldover = true;
-								} else {
-									vertices[myIndex].seam = true;
-									vertices[otherIndex].seam = true;
-								}
-
-								int other_triangle_count = ov.tcount;
-								int other_triangle_start = ov.tstart;
-								for (int k = 0; k < other_triangle_count; k++) {
-									Ref &r = refs[other_triangle_start + k];
-
-									Triangle &t = triangles[r.tid];
-									t.v[r.tvertex] = myIndex;
-								}
-								*/
+			for (int64_t x = cx - 1; x <= cx + 1 && target == -1; ++x) {
+				for (int64_t y = cy - 1; y <= cy + 1 && target == -1; ++y) {
+					for (int64_t z = cz - 1; z <= cz + 1 && target == -1; ++z) {
+						int other = heads[link_cell_hash(x, y, z) & (table_size - 1)];
+
+						while (other != -1) {
+							vec3f d = vertices[other].p - p;
+
+							if (d.dot(d) <= max_distance_sq && !vertices_share_triangle(index, other)) {
+								target = other;
+								break;
 							}
+
+							other = next[other];
 						}
 					}
-
-					// Update the references again
-					//update_references();
 				}
 			}
+
+			if (target == -1) {
+				uint32_t h = link_cell_hash(cx, cy, cz) & (table_size - 1);
+				next[index] = heads[h];
+				heads[h] = index;
+				continue;
+			}
+
+			vertex_link(index, target);
+		}
+	}
+
+	// Moves the triangles of a vertex to target. The vertex is left unreferenced, and gets removed by compact_mesh().
+
+	void vertex_link(int index, int target) {
+		Vertex &v = vertices[index];
+		Vertex &tv = vertices[target];
+
+		bool same_uvs = true;
+
+		if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV) != 0) {
+			vec3f uv = vertex_uv(index);
+			vec3f tuv = vertex_uv(target);
+
+			same_uvs = uv.x == tuv.x && uv.y == tuv.y;
+		}
+
+		if (same_uvs) {
+			v.foldover = true;
+			tv.foldover = true;
+		} else {
+			v.seam = true;
+			tv.seam = true;
+		}
+
+		v.welded = true;
+		tv.welded = true;
+
+		for (int k = 0; k < v.tcount; ++k) {
+			const Ref &r = refs[v.tstart + k];
+			triangles[r.tid].v[r.tvertex] = target;
+		}
+
+		// A weld is a collapse that removes no triangles
+		if (_recording) {
+			CollapseRecord record;
+			record.kept = vertex_sources[target];
+			record.removed = vertex_sources[index];
+
+			collapse_records.push_back(record);
+		}
+	}
+
+	// Welding vertices of the same triangle would make it degenerate
+
+	bool vertices_share_triangle(int i0, int i1) const {
+		const Vertex &v = vertices[i0];
+
+		for (int k = 0; k < v.tcount; ++k) {
+			const Triangle &t = triangles[refs[v.tstart + k].tid];
+
+			if (t.v[0] == i1 || t.v[1] == i1 || t.v[2] == i1)
+				return true;
+		}
+
+		return false;
+	}
+
+	static uint32_t link_cell_hash(int64_t x, int64_t y, int64_t z) {
+		return uint32_t(x * 73856093) ^ uint32_t(y * 19349663) ^ uint32_t(z * 83492791);
+	}
+
+	// The uv of a vertex, taken from its first triangle
+
+	vec3f vertex_uv(int i) const {
+		const Ref &r = refs[vertices[i].tstart];
+		return triangle_uvs[r.tid * 3 + r.tvertex];
+	}
+
+	// Whether an edge can be collapsed, based on the lock, border, uv seam and foldover flags of its vertices
+
+	bool edge_is_collapsible(const Vertex &v0, const Vertex &v1) const {
+		if (v0.locked || v1.locked)
+			return false;
+
+		if (v0.border != v1.border)
+			return false;
+
+		if (_preserve_border_dges && v0.border)
+			return false;
+
+		if (_preserve_uv_seam_edges && (v0.seam || v1.seam))
+			return false;
+
+		if (_preserve_uv_foldover_edges && (v0.foldover || v1.foldover))
+			return false;
+
+		return true;
+	}
+
+	template <class M, class U>
+	void parallel_run(const uint32_t p_elements, M p_method, U p_userdata) {
+#if VERSION_MAJOR > 3
+		WorkerThreadPool::GroupID group = WorkerThreadPool::get_singleton()->add_template_group_task(this, p_method, p_userdata, p_elements);
+		WorkerThreadPool::get_singleton()->wait_for_group_task_completion(group);
+#else
+		ThreadWorkPool work_pool;
+		work_pool.init();
+		work_pool.do_work(p_elements, this, p_method, p_userdata);
+		work_pool.finish();
+#endif
+	}
+
+	// Move a triangle, and its attributes to a lower index while compacting
+
+	void triangle_move(int dst, int src) {
+		if (dst == src)
+			return;
+
+		triangles[dst] = triangles[src];
+		triangle_normals[dst] = triangle_normals[src];
+
+		if (_recording) {
+			triangle_sources[dst] = triangle_sources[src];
+		}
+
+		if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV) != 0) {
+			for (int j = 0; j < 3; ++j) {
+				triangle_uvs[dst * 3 + j] = triangle_uvs[src * 3 + j];
+			}
+		}
+
+		if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV2) != 0) {
+			for (int j = 0; j < 3; ++j) {
+				triangle_uv2s[dst * 3 + j] = triangle_uv2s[src * 3 + j];
+			}
+		}
+
+		if ((_format & VisualServer::ARRAY_FORMAT_COLOR) != 0) {
+			for (int j = 0; j < 3; ++j) {
+				triangle_colors[dst * 3 + j] = triangle_colors[src * 3 + j];
+			}
+		}
+	}
+
+	void triangles_resize(int size) {
+		triangles.resize(size);
+		triangle_normals.resize(size);
+
+		if (_recording) {
+			triangle_sources.resize(size);
+		}
+
+		if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV) != 0) {
+			triangle_uvs.resize(size * 3);
+		}
+
+		if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV2) != 0) {
+			triangle_uv2s.resize(size * 3);
+		}
+
+		if ((_format & VisualServer::ARRAY_FORMAT_COLOR) != 0) {
+			triangle_colors.resize(size * 3);
 		}
 	}
 
@@ -974,32 +2194,214 @@ public:
 			if (!triangles[i].deleted) {
 				Triangle &t = triangles[i];
 
-				triangles[dst++] = t;
-
 				for (int j = 0; j < 3; ++j) {
 					vertices[t.v[j]].tcount = 1;
 				}
+
+				triangle_move(dst++, i);
 			}
 		}
 
-		triangles.resize(dst);
+		triangles_resize(dst);
 		dst = 0;
 		for (unsigned int i = 0; i < vertices.size(); ++i) {
 			if (vertices[i].tcount) {
 				vertices[i].tstart = dst;
 				vertices[dst].p = vertices[i].p;
+				vertices[dst].seam = vertices[i].seam;
+				vertices[dst].foldover = vertices[i].foldover;
+				vertices[dst].welded = vertices[i].welded;
+
+				if (_recording) {
+					vertex_sources[dst] = vertex_sources[i];
+				}
+
 				dst++;
 			}
 		}
 
-		for (unsigned int i = 0; i < triangles.size(); ++i) {
-			Triangle &t = triangles[i];
+		for (unsigned int i = 0; i < triangles.size(); ++i) {
+			Triangle &t = triangles[i];
+
+			for (int j = 0; j < 3; ++j) {
+				t.v[j] = vertices[t.v[j]].tstart;
+			}
+		}
+		vertices.resize(dst);
+
+		if (_recording) {
+			vertex_sources.resize(dst);
+		}
+	}
+
+	//
+	// Attribute quadrics (Hoppe, "New quadric metric for simplifying meshes with appearance attributes")
+	//
+	// Every triangle has a linear gradient for each attribute channel (u, v, r, g, b, ...), and adds
+	// w * (g.p + d - s)^2 to its vertices, where s is the value of the channel at the vertex. As s is free,
+	// it is solved for, which leaves a 4x4 quadric for the position, like the plane quadrics:
+	//
+	// sum(w * (g, d)(g, d)^T) - sum(w * c c^T / count), c = sum((g, d)), count = triangle count
+	//
+	// Per vertex this stores the first sum, count, then c for every channel.
+	// The weights are relative to the bounding box diagonal, like the max error of simplify_mesh_to_error().
+	//
+
+	void attribute_quadrics_update() {
+		attribute_weights.clear();
+
+		double scale = _error_scale * _error_scale;
+
+		if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV) != 0 && _uv_weight > 0) {
+			attribute_weights.resize(attribute_weights.size() + 2, _uv_weight * scale);
+		}
+
+		if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV2) != 0 && _uv2_weight > 0) {
+			attribute_weights.resize(attribute_weights.size() + 2, _uv2_weight * scale);
+		}
+
+		if ((_format & VisualServer::ARRAY_FORMAT_COLOR) != 0 && _color_weight > 0) {
+			attribute_weights.resize(attribute_weights.size() + 4, _color_weight * scale);
+		}
+
+		int channel_count = attribute_weights.size();
+
+		if (channel_count == 0) {
+			attribute_stride = 0;
+			attribute_quadrics.clear();
+			return;
+		}
+
+		attribute_stride = 11 + channel_count * 4;
+		attribute_quadrics.assign(vertices.size() * attribute_stride, 0);
+
+		std::vector<double> values(channel_count * 3);
+
+		for (unsigned int i = 0; i < triangles.size(); ++i) {
+			const Triangle &t = triangles[i];
+
+			if (t.deleted)
+				continue;
+
+			const vec3f &p0 = vertices[t.v[0]].p;
+			vec3f e1 = vertices[t.v[1]].p - p0;
+			vec3f e2 = vertices[t.v[2]].p - p0;
+
+			double d11 = e1.dot(e1);
+			double d12 = e1.dot(e2);
+			double d22 = e2.dot(e2);
+			double denom = d11 * d22 - d12 * d12;
+
+			// No gradient for degenerate triangles
+			if (denom <= 0)
+				continue;
+
+			int channel = 0;
+
+			if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV) != 0 && _uv_weight > 0) {
+				for (int j = 0; j < 3; ++j) {
+					const vec3f &uv = triangle_uvs[i * 3 + j];
+					values[j * channel_count + channel] = uv.x;
+					values[j * channel_count + channel + 1] = uv.y;
+				}
+
+				channel += 2;
+			}
+
+			if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV2) != 0 && _uv2_weight > 0) {
+				for (int j = 0; j < 3; ++j) {
+					const vec3f &uv2 = triangle_uv2s[i * 3 + j];
+					values[j * channel_count + channel] = uv2.x;
+					values[j * channel_count + channel + 1] = uv2.y;
+				}
+
+				channel += 2;
+			}
+
+			if ((_format & VisualServer::ARRAY_FORMAT_COLOR) != 0 && _color_weight > 0) {
+				for (int j = 0; j < 3; ++j) {
+					const Color &c = triangle_colors[i * 3 + j];
+					values[j * channel_count + channel] = c.r;
+					values[j * channel_count + channel + 1] = c.g;
+					values[j * channel_count + channel + 2] = c.b;
+					values[j * channel_count + channel + 3] = c.a;
+				}
+			}
+
+			for (int j = 0; j < 3; ++j) {
+				attribute_quadrics[t.v[j] * attribute_stride + 10] += 1;
+			}
+
+			for (int k = 0; k < channel_count; ++k) {
+				double s0 = values[k];
+				double s1 = values[channel_count + k];
+				double s2 = values[channel_count * 2 + k];
+
+				// g is in the plane of the triangle, with g.e1 = s1 - s0, and g.e2 = s2 - s0
+				double a = (d22 * (s1 - s0) - d12 * (s2 - s0)) / denom;
+				double b = (d11 * (s2 - s0) - d12 * (s1 - s0)) / denom;
+				vec3f g = e1 * a + e2 * b;
+				double d = s0 - g.dot(p0);
+
+				SymetricMatrix gq(g.x, g.y, g.z, d);
+				double w = attribute_weights[k];
+
+				for (int j = 0; j < 3; ++j) {
+					double *aq = &attribute_quadrics[t.v[j] * attribute_stride];
+
+					for (int l = 0; l < 10; ++l) {
+						aq[l] += w * gq[l];
+					}
+
+					double *c = aq + 11 + k * 4;
+					c[0] += g.x;
+					c[1] += g.y;
+					c[2] += g.z;
+					c[3] += d;
+				}
+			}
+		}
+	}
+
+	void attribute_quadrics_merge(int i0, int i1) {
+		double *a0 = &attribute_quadrics[i0 * attribute_stride];
+		const double *a1 = &attribute_quadrics[i1 * attribute_stride];
+
+		for (int k = 0; k < attribute_stride; ++k) {
+			a0[k] += a1[k];
+		}
+	}
+
+	// The attribute part of the quadric of an edge, with the attribute values solved for
+
+	SymetricMatrix attribute_quadric(int i0, int i1) const {
+		const double *a0 = &attribute_quadrics[i0 * attribute_stride];
+		const double *a1 = &attribute_quadrics[i1 * attribute_stride];
+
+		SymetricMatrix q;
+
+		for (int k = 0; k < 10; ++k) {
+			q.m[k] = a0[k] + a1[k];
+		}
+
+		double count = a0[10] + a1[10];
+
+		if (count <= 0)
+			return q;
+
+		for (unsigned int k = 0; k < attribute_weights.size(); ++k) {
+			const double *c0 = a0 + 11 + k * 4;
+			const double *c1 = a1 + 11 + k * 4;
+
+			SymetricMatrix cq(c0[0] + c1[0], c0[1] + c1[1], c0[2] + c1[2], c0[3] + c1[3]);
+			double w = attribute_weights[k] / count;
 
-			for (int j = 0; j < 3; ++j) {
-				t.v[j] = vertices[t.v[j]].tstart;
+			for (int l = 0; l < 10; ++l) {
+				q.m[l] -= w * cq[l];
 			}
 		}
-		vertices.resize(dst);
+
+		return q;
 	}
 
 	// Error between vertex and Quadric
@@ -1008,16 +2410,35 @@ public:
 		return q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x + q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y + q[7] * z * z + 2 * q[8] * z + q[9];
 	}
 
+	// Error of collapsing an edge into p, without the attribute quadrics. This is the one
+	// simplify_mesh_to_error() limits, and get_achieved_error() reports.
+
+	double geometric_error(int id_v1, int id_v2, const vec3f &p) {
+		return vertex_error(vertices[id_v1].q + vertices[id_v2].q, p.x, p.y, p.z);
+	}
+
 	// Error for one edge
 
 	double calculate_error(int id_v1, int id_v2, vec3f &p_result) {
 		// compute interpolated vertex
 
 		SymetricMatrix q = vertices[id_v1].q + vertices[id_v2].q;
+
+		if (attribute_stride)
+			q += attribute_quadric(id_v1, id_v2);
+
 		bool border = vertices[id_v1].border & vertices[id_v2].border;
 		double error = 0;
 		double det = q.det(0, 1, 2, 1, 4, 5, 2, 5, 7);
-		if (det != 0 && !border) {
+		if (_recording) {
+			// Collapse into one of the vertices, so the progressive mesh can keep every position as is
+			vec3f p1 = vertices[id_v1].p;
+			vec3f p2 = vertices[id_v2].p;
+			double error1 = vertex_error(q, p1.x, p1.y, p1.z);
+			double error2 = vertex_error(q, p2.x, p2.y, p2.z);
+			error = min(error1, error2);
+			p_result = error1 == error ? p1 : p2;
+		} else if (det != 0 && !border) {
 
 			// q_delta is invertible
 			p_result.x = -1 / det * (q.det(1, 2, 3, 4, 5, 6, 5, 7, 8)); // vx = A41/det(q_delta)
@@ -1041,7 +2462,37 @@ public:
 		return error;
 	}
 
+	// Drops the mesh, but keeps the memory of the arrays, so the same FQMS can be reused for many meshes
+	// without reallocating them every time. The settings are kept.
+
+	void reset() {
+		triangles.clear();
+		vertices.clear();
+		refs.clear();
+		triangle_normals.clear();
+		triangle_uvs.clear();
+		triangle_uv2s.clear();
+		triangle_colors.clear();
+
+		attribute_quadrics.clear();
+		attribute_weights.clear();
+		attribute_stride = 0;
+
+		_max_collapse_error = 0;
+		_error_scale = 1;
+
+		_record_input = Array();
+		_recording = false;
+		_linked = false;
+		collapse_records.clear();
+		vertex_sources.clear();
+		triangle_sources.clear();
+		triangle_removals.clear();
+	}
+
 	void initialize(const Array &arrays) {
+		reset();
+
 		ERR_FAIL_COND(arrays.size() != ArrayMesh::ARRAY_MAX);
 
 		PoolVector<Vector3> pvertices = arrays.get(ArrayMesh::ARRAY_VERTEX);
@@ -1049,6 +2500,11 @@ public:
 		PoolVector<Color> pcolors = arrays.get(ArrayMesh::ARRAY_COLOR);
 		PoolVector<Vector2> puvs = arrays.get(ArrayMesh::ARRAY_TEX_UV);
 		PoolVector<Vector2> puv2s = arrays.get(ArrayMesh::ARRAY_TEX_UV2);
+		PoolVector<int> pindices = arrays.get(ArrayMesh::ARRAY_INDEX);
+
+		if ((pindices.size() % 3) != 0) {
+			ERR_FAIL_MSG("The index array length must be a multiple of 3 in order to represent triangles.");
+		}
 
 		_format = 0;
 
@@ -1064,7 +2520,21 @@ public:
 		if (puv2s.size() > 0)
 			_format |= VisualServer::ARRAY_FORMAT_TEX_UV2;
 
-		//_vertices.resize(vertices.size());
+		int triangle_count = pindices.size() / 3;
+
+		vertices.reserve(pvertices.size());
+		triangles.reserve(triangle_count);
+		triangle_normals.reserve(triangle_count);
+
+		if ((_format & VisualServer::ARRAY_FORMAT_COLOR) != 0)
+			triangle_colors.reserve(triangle_count * 3);
+
+		if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV) != 0)
+			triangle_uvs.reserve(triangle_count * 3);
+
+		if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV2) != 0)
+			triangle_uv2s.reserve(triangle_count * 3);
+
 		for (int i = 0; i < pvertices.size(); ++i) {
 			Vector3 v3 = pvertices[i];
 
@@ -1072,29 +2542,15 @@ public:
 			vert.p.x = v3.x;
 			vert.p.y = v3.y;
 			vert.p.z = v3.z;
+			vert.border = 0;
+			vert.seam = false;
+			vert.foldover = false;
+			vert.welded = false;
+			vert.locked = false;
 
 			vertices.push_back(vert);
 		}
 
-		std::vector<vec3f> uvs;
-
-		for (int i = 0; i < puvs.size(); ++i) {
-			Vector2 v2 = puvs[i];
-
-			vec3f uv;
-			uv.x = v2.x;
-			uv.y = v2.y;
-			uv.z = 0;
-
-			uvs.push_back(uv);
-		}
-
-		PoolVector<int> pindices = arrays.get(ArrayMesh::ARRAY_INDEX);
-
-		if ((pindices.size() % 3) != 0) {
-			ERR_FAIL_MSG("The index array length must be a multiple of 3 in order to represent triangles.");
-		}
-
 		//std::vector<std::vector<int> > uvMap;
 
 		for (int i = 0; i < pindices.size(); i += 3) {
@@ -1107,11 +2563,13 @@ public:
 			t.v[0] = i0;
 			t.v[1] = i1;
 			t.v[2] = i2;
+			t.deleted = 0;
+			t.dirty = 0;
 
 			if ((_format & VisualServer::ARRAY_FORMAT_COLOR) != 0) {
-				t.color[0] = pcolors[i0];
-				t.color[1] = pcolors[i1];
-				t.color[2] = pcolors[i2];
+				triangle_colors.push_back(pcolors[i0]);
+				triangle_colors.push_back(pcolors[i1]);
+				triangle_colors.push_back(pcolors[i2]);
 			}
 
 			if ((_format & VisualServer::ARRAY_FORMAT_NORMAL) != 0) {
@@ -1119,7 +2577,9 @@ public:
 
 				vec3f vn(v.x, v.y, v.z);
 
-				t.n = vn;
+				triangle_normals.push_back(vn);
+			} else {
+				triangle_normals.push_back(vec3f(0, 0, 0));
 			}
 
 			if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV) != 0) {
@@ -1127,19 +2587,19 @@ public:
 				Vector2 tv1 = puvs[i1];
 				Vector2 tv2 = puvs[i2];
 
-				t.uvs[0] = vec3f(tv0.x, tv0.y, 0);
-				t.uvs[1] = vec3f(tv1.x, tv1.y, 0);
-				t.uvs[2] = vec3f(tv2.x, tv2.y, 0);
+				triangle_uvs.push_back(vec3f(tv0.x, tv0.y, 0));
+				triangle_uvs.push_back(vec3f(tv1.x, tv1.y, 0));
+				triangle_uvs.push_back(vec3f(tv2.x, tv2.y, 0));
 			}
 
 			if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV2) != 0) {
-				Vector2 tv0 = puvs[i0];
-				Vector2 tv1 = puvs[i1];
-				Vector2 tv2 = puvs[i2];
+				Vector2 tv0 = puv2s[i0];
+				Vector2 tv1 = puv2s[i1];
+				Vector2 tv2 = puv2s[i2];
 
-				t.uv2s[0] = vec3f(tv0.x, tv0.y, 0);
-				t.uv2s[1] = vec3f(tv1.x, tv1.y, 0);
-				t.uv2s[2] = vec3f(tv2.x, tv2.y, 0);
+				triangle_uv2s.push_back(vec3f(tv0.x, tv0.y, 0));
+				triangle_uv2s.push_back(vec3f(tv1.x, tv1.y, 0));
+				triangle_uv2s.push_back(vec3f(tv2.x, tv2.y, 0));
 			}
 
 			//std::vector<int> indices;
@@ -1148,7 +2608,6 @@ public:
 			//indices.push_back(pindices[i + 2]);
 			//uvMap.push_back(indices);
 
-			t.material = 0;
 			triangles.push_back(t);
 		}
 
@@ -1158,6 +2617,49 @@ public:
 		//			triangles[i].uvs[j] = uvs[uvMap[i][j]];
 		//	}
 		//}
+
+		// Collapse errors are squared distances, so their root is compared to the size of the mesh
+		if (vertices.size() > 0) {
+			vec3f min_p = vertices[0].p;
+			vec3f max_p = vertices[0].p;
+
+			for (unsigned int i = 1; i < vertices.size(); ++i) {
+				const vec3f &p = vertices[i].p;
+
+				min_p.x = MIN(min_p.x, p.x);
+				min_p.y = MIN(min_p.y, p.y);
+				min_p.z = MIN(min_p.z, p.z);
+				max_p.x = MAX(max_p.x, p.x);
+				max_p.y = MAX(max_p.y, p.y);
+				max_p.z = MAX(max_p.z, p.z);
+			}
+
+			vec3f size = max_p - min_p;
+			_error_scale = sqrt(size.dot(size));
+		}
+
+		if (_error_scale <= 0) {
+			_error_scale = 1;
+		}
+
+		_recording = _record_collapses;
+
+		if (_recording) {
+			//packed arrays are copy on write, so this is cheap
+			_record_input = arrays.duplicate();
+
+			vertex_sources.resize(vertices.size());
+			for (unsigned int i = 0; i < vertices.size(); ++i) {
+				vertex_sources[i] = i;
+			}
+
+			triangle_sources.resize(triangles.size());
+			for (unsigned int i = 0; i < triangles.size(); ++i) {
+				triangle_sources[i] = i;
+			}
+
+			triangle_removals.resize(triangles.size(), -1);
+		}
 	}
 
 	Array get_arrays() {
@@ -1172,10 +2674,14 @@ public:
 		PoolVector<Vector2> puv2s;
 		PoolVector<int> pindices;
 
-		pvertices.resize(vertices.size());
+		std::vector<int> corners;
+		std::vector<int> sources;
+		output_vertices_build(corners, sources);
+
+		pvertices.resize(sources.size());
 		for (int i = 0; i < pvertices.size(); ++i) {
 			Vector3 v;
-			vec3f vf = vertices[i].p;
+			vec3f vf = vertices[sources[i]].p;
 			v.x = vf.x;
 			v.y = vf.y;
 			v.z = vf.z;
@@ -1187,12 +2693,14 @@ public:
 			pcolors.resize(pvertices.size());
 
 			for (unsigned int i = 0; i < triangles.size(); ++i) {
-				Triangle t = triangles[i];
+				const Triangle &t = triangles[i];
 
 				if (!t.deleted) {
-					pcolors.set(t.v[0], t.color[0]);
-					pcolors.set(t.v[1], t.color[1]);
-					pcolors.set(t.v[2], t.color[2]);
+					const Color *colors = &triangle_colors[i * 3];
+
+					pcolors.set(corners[i * 3 + 0], colors[0]);
+					pcolors.set(corners[i * 3 + 1], colors[1]);
+					pcolors.set(corners[i * 3 + 2], colors[2]);
 				}
 			}
 
@@ -1203,14 +2711,15 @@ public:
 			pnormals.resize(pvertices.size());
 
 			for (unsigned int i = 0; i < triangles.size(); ++i) {
-				Triangle t = triangles[i];
+				const Triangle &t = triangles[i];
 
 				if (!t.deleted) {
-					Vector3 v(t.n.x, t.n.y, t.n.z);
+					const vec3f &n = triangle_normals[i];
+					Vector3 v(n.x, n.y, n.z);
 
-					pnormals.set(t.v[0], v);
-					pnormals.set(t.v[1], v);
-					pnormals.set(t.v[2], v);
+					pnormals.set(corners[i * 3 + 0], v);
+					pnormals.set(corners[i * 3 + 1], v);
+					pnormals.set(corners[i * 3 + 2], v);
 				}
 			}
 
@@ -1221,16 +2730,18 @@ public:
 			puvs.resize(pvertices.size());
 
 			for (unsigned int i = 0; i < triangles.size(); ++i) {
-				Triangle t = triangles[i];
+				const Triangle &t = triangles[i];
 
 				if (!t.deleted) {
-					Vector2 v1(t.uvs[0].x, t.uvs[0].y);
-					Vector2 v2(t.uvs[1].x, t.uvs[1].y);
-					Vector2 v3(t.uvs[2].x, t.uvs[2].y);
+					const vec3f *uvs = &triangle_uvs[i * 3];
 
-					puvs.set(t.v[0], v1);
-					puvs.set(t.v[1], v2);
-					puvs.set(t.v[2], v3);
+					Vector2 v1(uvs[0].x, uvs[0].y);
+					Vector2 v2(uvs[1].x, uvs[1].y);
+					Vector2 v3(uvs[2].x, uvs[2].y);
+
+					puvs.set(corners[i * 3 + 0], v1);
+					puvs.set(corners[i * 3 + 1], v2);
+					puvs.set(corners[i * 3 + 2], v3);
 				}
 			}
 
@@ -1241,16 +2752,18 @@ public:
 			puv2s.resize(pvertices.size());
 
 			for (unsigned int i = 0; i < triangles.size(); ++i) {
-				Triangle t = triangles[i];
+				const Triangle &t = triangles[i];
 
 				if (!t.deleted) {
-					Vector2 v1(t.uv2s[0].x, t.uv2s[0].y);
-					Vector2 v2(t.uv2s[1].x, t.uv2s[1].y);
-					Vector2 v3(t.uv2s[2].x, t.uv2s[2].y);
+					const vec3f *uv2s = &triangle_uv2s[i * 3];
+
+					Vector2 v1(uv2s[0].x, uv2s[0].y);
+					Vector2 v2(uv2s[1].x, uv2s[1].y);
+					Vector2 v3(uv2s[2].x, uv2s[2].y);
 
-					puv2s.set(t.v[0], v1);
-					puv2s.set(t.v[1], v2);
-					puv2s.set(t.v[2], v3);
+					puv2s.set(corners[i * 3 + 0], v1);
+					puv2s.set(corners[i * 3 + 1], v2);
+					puv2s.set(corners[i * 3 + 2], v3);
 				}
 			}
 
@@ -1259,12 +2772,12 @@ public:
 
 		//pindices.resize(_mu_triangles.size() * 3);
 		for (unsigned int i = 0; i < triangles.size(); ++i) {
-			Triangle t = triangles[i];
+			const Triangle &t = triangles[i];
 
 			if (!t.deleted) {
-				pindices.push_back(t.v[0]);
-				pindices.push_back(t.v[1]);
-				pindices.push_back(t.v[2]);
+				pindices.push_back(corners[i * 3 + 0]);
+				pindices.push_back(corners[i * 3 + 1]);
+				pindices.push_back(corners[i * 3 + 2]);
 
 				//print_error(String::num(t.v[0]) + " " + String::num(t.v[1]) + " " + String::num(t.v[2]) + " ");
 			}
@@ -1276,6 +2789,453 @@ public:
 		return arr;
 	}
 
+	// Makes the LODs (get_arrays() results, one per level) use the same vertex arrays, with only their
+	// index arrays differing. Vertices that are the same in more than one level are only stored once.
+
+	void lod_vertices_share(Array &r_lods) {
+		int stride = 3;
+
+		if ((_format & VisualServer::ARRAY_FORMAT_NORMAL) != 0)
+			stride += 3;
+
+		if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV) != 0)
+			stride += 2;
+
+		if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV2) != 0)
+			stride += 2;
+
+		if ((_format & VisualServer::ARRAY_FORMAT_COLOR) != 0)
+			stride += 4;
+
+		std::vector<real_t> keys;
+		std::vector<int> offsets(r_lods.size() + 1, 0);
+
+		for (int i = 0; i < r_lods.size(); ++i) {
+			Array arr = r_lods[i];
+
+			PoolVector<Vector3> pvertices = arr.get(ArrayMesh::ARRAY_VERTEX);
+			PoolVector<Vector3> pnormals = arr.get(ArrayMesh::ARRAY_NORMAL);
+			PoolVector<Vector2> puvs = arr.get(ArrayMesh::ARRAY_TEX_UV);
+			PoolVector<Vector2> puv2s = arr.get(ArrayMesh::ARRAY_TEX_UV2);
+			PoolVector<Color> pcolors = arr.get(ArrayMesh::ARRAY_COLOR);
+
+			offsets[i + 1] = offsets[i] + pvertices.size();
+
+			for (int j = 0; j < pvertices.size(); ++j) {
+				Vector3 v = pvertices[j];
+
+				keys.push_back(v.x);
+				keys.push_back(v.y);
+				keys.push_back(v.z);
+
+				if ((_format & VisualServer::ARRAY_FORMAT_NORMAL) != 0) {
+					Vector3 n = pnormals[j];
+
+					keys.push_back(n.x);
+					keys.push_back(n.y);
+					keys.push_back(n.z);
+				}
+
+				if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV) != 0) {
+					Vector2 uv = puvs[j];
+
+					keys.push_back(uv.x);
+					keys.push_back(uv.y);
+				}
+
+				if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV2) != 0) {
+					Vector2 uv2 = puv2s[j];
+
+					keys.push_back(uv2.x);
+					keys.push_back(uv2.y);
+				}
+
+				if ((_format & VisualServer::ARRAY_FORMAT_COLOR) != 0) {
+					Color c = pcolors[j];
+
+					keys.push_back(c.r);
+					keys.push_back(c.g);
+					keys.push_back(c.b);
+					keys.push_back(c.a);
+				}
+			}
+		}
+
+		int vertex_count = offsets[r_lods.size()];
+
+		// Sorting by hash keeps equal vertices next to each other, with cheap comparisons
+		std::vector<std::pair<uint64_t, int>> hashes(vertex_count);
+
+		for (int i = 0; i < vertex_count; ++i) {
+			hashes[i].first = vertex_key_hash(&keys[i * stride], stride);
+			hashes[i].second = i;
+		}
+
+		std::sort(hashes.begin(), hashes.end());
+
+		// The first of the equal vertices, runs are sorted by index so it comes first in its run
+		std::vector<int> firsts(vertex_count);
+
+		int run_start = 0;
+		for (int i = 0; i < vertex_count; ++i) {
+			if (hashes[i].first != hashes[run_start].first) {
+				run_start = i;
+			}
+
+			int index = hashes[i].second;
+			int found = index;
+
+			// Collisions are rare, so the runs are short
+			for (int j = run_start; j < i && found == index; ++j) {
+				int other = hashes[j].second;
+
+				if (firsts[other] == other && vertex_keys_equal(&keys[index * stride], &keys[other * stride], stride)) {
+					found = other;
+				}
+			}
+
+			firsts[index] = found;
+		}
+
+		// Numbered in the order they are first used, level by level, to keep the locality of each level
+		std::vector<int> shared(vertex_count);
+		std::vector<int> sources;
+
+		for (int i = 0; i < vertex_count; ++i) {
+			if (firsts[i] == i) {
+				shared[i] = sources.size();
+				sources.push_back(i);
+			} else {
+				shared[i] = shared[firsts[i]];
+			}
+		}
+
+		PoolVector<Vector3> pvertices;
+		PoolVector<Vector3> pnormals;
+		PoolVector<Vector2> puvs;
+		PoolVector<Vector2> puv2s;
+		PoolVector<Color> pcolors;
+
+		pvertices.resize(sources.size());
+
+		if ((_format & VisualServer::ARRAY_FORMAT_NORMAL) != 0)
+			pnormals.resize(sources.size());
+
+		if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV) != 0)
+			puvs.resize(sources.size());
+
+		if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV2) != 0)
+			puv2s.resize(sources.size());
+
+		if ((_format & VisualServer::ARRAY_FORMAT_COLOR) != 0)
+			pcolors.resize(sources.size());
+
+		for (unsigned int i = 0; i < sources.size(); ++i) {
+			const real_t *k = &keys[sources[i] * stride];
+
+			pvertices.set(i, Vector3(k[0], k[1], k[2]));
+			k += 3;
+
+			if ((_format & VisualServer::ARRAY_FORMAT_NORMAL) != 0) {
+				pnormals.set(i, Vector3(k[0], k[1], k[2]));
+				k += 3;
+			}
+
+			if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV) != 0) {
+				puvs.set(i, Vector2(k[0], k[1]));
+				k += 2;
+			}
+
+			if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV2) != 0) {
+				puv2s.set(i, Vector2(k[0], k[1]));
+				k += 2;
+			}
+
+			if ((_format & VisualServer::ARRAY_FORMAT_COLOR) != 0) {
+				pcolors.set(i, Color(k[0], k[1], k[2], k[3]));
+			}
+		}
+
+		for (int i = 0; i < r_lods.size(); ++i) {
+			Array arr = r_lods[i];
+
+			PoolVector<int> pindices = arr.get(ArrayMesh::ARRAY_INDEX);
+
+			for (int j = 0; j < pindices.size(); ++j) {
+				pindices.set(j, shared[offsets[i] + pindices[j]]);
+			}
+
+			arr.set(ArrayMesh::ARRAY_VERTEX, pvertices);
+
+			if ((_format & VisualServer::ARRAY_FORMAT_NORMAL) != 0)
+				arr.set(ArrayMesh::ARRAY_NORMAL, pnormals);
+
+			if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV) != 0)
+				arr.set(ArrayMesh::ARRAY_TEX_UV, puvs);
+
+			if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV2) != 0)
+				arr.set(ArrayMesh::ARRAY_TEX_UV2, puv2s);
+
+			if ((_format & VisualServer::ARRAY_FORMAT_COLOR) != 0)
+				arr.set(ArrayMesh::ARRAY_COLOR, pcolors);
+
+			arr.set(ArrayMesh::ARRAY_INDEX, pindices);
+
+			r_lods.set(i, arr);
+		}
+	}
+
+	// Exports the recorded collapses as a progressive mesh, which uses the input vertices as they are.
+	// Vertices and triangles are ordered so the ones removed last come first. The mesh with n vertices
+	// is the first r_triangle_counts[n] triangles, with every index i >= n replaced by r_collapse_map[i]
+	// until it is below n. r_collapse_map[i] < i for every removed vertex.
+
+	void get_progressive_mesh(Array &r_arrays, PoolVector<int> &r_collapse_map, PoolVector<int> &r_triangle_counts) {
+		ERR_FAIL_COND_MSG(!_recording || _record_input.size() != ArrayMesh::ARRAY_MAX, "Collapses are only recorded if record_collapses is enabled before initialize().");
+
+		PoolVector<Vector3> pvertices = _record_input.get(ArrayMesh::ARRAY_VERTEX);
+		PoolVector<int> pindices = _record_input.get(ArrayMesh::ARRAY_INDEX);
+
+		int vertex_count = pvertices.size();
+		int triangle_count = pindices.size() / 3;
+		int record_count = collapse_records.size();
+
+		std::vector<int> vertex_removals(vertex_count, -1);
+		for (int i = 0; i < record_count; ++i) {
+			vertex_removals[collapse_records[i].removed] = i;
+		}
+
+		// Vertices that stay first, then the removed ones in reverse order
+		std::vector<int> order;
+		order.reserve(vertex_count);
+
+		for (int i = 0; i < vertex_count; ++i) {
+			if (vertex_removals[i] == -1) {
+				order.push_back(i);
+			}
+		}
+
+		int base_vertex_count = order.size();
+
+		for (int i = record_count - 1; i >= 0; --i) {
+			order.push_back(collapse_records[i].removed);
+		}
+
+		std::vector<int> new_ids(vertex_count);
+		for (int i = 0; i < vertex_count; ++i) {
+			new_ids[order[i]] = i;
+		}
+
+		r_collapse_map.resize(vertex_count);
+		for (int i = 0; i < vertex_count; ++i) {
+			if (i < base_vertex_count) {
+				r_collapse_map.set(i, i);
+			} else {
+				r_collapse_map.set(i, new_ids[collapse_records[vertex_removals[order[i]]].kept]);
+			}
+		}
+
+		// Triangles that stay first, then the removed ones bucketed by their collapse in reverse order.
+		// offsets[i] is where the triangles removed by collapse i start.
+		std::vector<int> offsets(record_count + 1, 0);
+		int base_triangle_count = 0;
+
+		for (int i = 0; i < triangle_count; ++i) {
+			int removal = triangle_removals[i];
+
+			if (removal == -1) {
+				++base_triangle_count;
+			} else {
+				++offsets[removal];
+			}
+		}
+
+		int offset = base_triangle_count;
+		for (int i = record_count - 1; i >= 0; --i) {
+			int count = offsets[i];
+			offsets[i] = offset;
+			offset += count;
+		}
+
+		// The mesh with base_vertex_count + k vertices has everything before the last k collapses undone
+		r_triangle_counts.resize(vertex_count + 1);
+		for (int i = 0; i <= vertex_count; ++i) {
+			int undone = i - base_vertex_count;
+
+			if (undone <= 0) {
+				r_triangle_counts.set(i, base_triangle_count);
+			} else if (undone == record_count) {
+				r_triangle_counts.set(i, triangle_count);
+			} else {
+				r_triangle_counts.set(i, offsets[record_count - undone - 1]);
+			}
+		}
+
+		PoolVector<int> pnew_indices;
+		pnew_indices.resize(triangle_count * 3);
+		int base_offset = 0;
+
+		for (int i = 0; i < triangle_count; ++i) {
+			int removal = triangle_removals[i];
+			int dst = removal == -1 ? base_offset++ : offsets[removal]++;
+
+			for (int j = 0; j < 3; ++j) {
+				pnew_indices.set(dst * 3 + j, new_ids[pindices[i * 3 + j]]);
+			}
+		}
+
+		r_arrays.resize(ArrayMesh::ARRAY_MAX);
+
+		r_arrays.set(ArrayMesh::ARRAY_VERTEX, progressive_vertices_reorder(pvertices, order));
+		r_arrays.set(ArrayMesh::ARRAY_INDEX, pnew_indices);
+
+		PoolVector<Vector3> pnormals = _record_input.get(ArrayMesh::ARRAY_NORMAL);
+		PoolVector<Color> pcolors = _record_input.get(ArrayMesh::ARRAY_COLOR);
+		PoolVector<Vector2> puvs = _record_input.get(ArrayMesh::ARRAY_TEX_UV);
+		PoolVector<Vector2> puv2s = _record_input.get(ArrayMesh::ARRAY_TEX_UV2);
+
+		if (pnormals.size() == vertex_count)
+			r_arrays.set(ArrayMesh::ARRAY_NORMAL, progressive_vertices_reorder(pnormals, order));
+
+		if (pcolors.size() == vertex_count)
+			r_arrays.set(ArrayMesh::ARRAY_COLOR, progressive_vertices_reorder(pcolors, order));
+
+		if (puvs.size() == vertex_count)
+			r_arrays.set(ArrayMesh::ARRAY_TEX_UV, progressive_vertices_reorder(puvs, order));
+
+		if (puv2s.size() == vertex_count)
+			r_arrays.set(ArrayMesh::ARRAY_TEX_UV2, progressive_vertices_reorder(puv2s, order));
+	}
+
+	template <class T>
+	static PoolVector<T> progressive_vertices_reorder(const PoolVector<T> &p_values, const std::vector<int> &p_order) {
+		PoolVector<T> values;
+		values.resize(p_order.size());
+
+		for (unsigned int i = 0; i < p_order.size(); ++i) {
+			values.set(i, p_values[p_order[i]]);
+		}
+
+		return values;
+	}
+
+	static uint64_t vertex_key_hash(const real_t *p_key, const int p_stride) {
+		uint64_t h = 14695981039346656037ULL;
+
+		for (int i = 0; i < p_stride; ++i) {
+			uint32_t bits;
+			float f = p_key[i];
+			memcpy(&bits, &f, sizeof(bits));
+
+			h = (h ^ bits) * 1099511628211ULL;
+		}
+
+		return h;
+	}
+
+	static bool vertex_keys_equal(const real_t *p_a, const real_t *p_b, const int p_stride) {
+		for (int i = 0; i < p_stride; ++i) {
+			if (p_a[i] != p_b[i])
+				return false;
+		}
+
+		return true;
+	}
+
+	// Maps every triangle corner to an output vertex. With smart link, welded vertices
+	// are split again where the uvs, uv2s or colors of their corners differ.
+
+	void output_vertices_build(std::vector<int> &r_corners, std::vector<int> &r_sources) {
+		r_corners.resize(triangles.size() * 3);
+		r_sources.resize(vertices.size());
+
+		for (unsigned int i = 0; i < vertices.size(); ++i) {
+			r_sources[i] = i;
+		}
+
+		bool split = _enable_smart_link && (_format & (VisualServer::ARRAY_FORMAT_TEX_UV | VisualServer::ARRAY_FORMAT_TEX_UV2 | VisualServer::ARRAY_FORMAT_COLOR)) != 0;
+
+		// A corner using each output vertex, and the next copy of the same vertex
+		std::vector<int> first_corners;
+		std::vector<int> next_copies;
+
+		if (split) {
+			first_corners.resize(vertices.size(), -1);
+			next_copies.resize(vertices.size(), -1);
+		}
+
+		for (unsigned int i = 0; i < triangles.size(); ++i) {
+			const Triangle &t = triangles[i];
+
+			if (t.deleted)
+				continue;
+
+			for (int j = 0; j < 3; ++j) {
+				int corner = i * 3 + j;
+				int index = t.v[j];
+
+				if (!split || !vertices[index].welded) {
+					r_corners[corner] = index;
+					continue;
+				}
+
+				int out = index;
+				int last = -1;
+
+				while (out != -1) {
+					if (first_corners[out] == -1) {
+						first_corners[out] = corner;
+						break;
+					}
+
+					if (corner_attributes_equal(first_corners[out], corner))
+						break;
+
+					last = out;
+					out = next_copies[out];
+				}
+
+				if (out == -1) {
+					out = r_sources.size();
+					r_sources.push_back(index);
+					first_corners.push_back(corner);
+					next_copies.push_back(-1);
+					next_copies[last] = out;
+				}
+
+				r_corners[corner] = out;
+			}
+		}
+	}
+
+	bool corner_attributes_equal(int c0, int c1) const {
+		if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV) != 0) {
+			const vec3f &a = triangle_uvs[c0];
+			const vec3f &b = triangle_uvs[c1];
+
+			if (fabs(a.x - b.x) > CORNER_ATTRIBUTE_EPSILON || fabs(a.y - b.y) > CORNER_ATTRIBUTE_EPSILON)
+				return false;
+		}
+
+		if ((_format & VisualServer::ARRAY_FORMAT_TEX_UV2) != 0) {
+			const vec3f &a = triangle_uv2s[c0];
+			const vec3f &b = triangle_uv2s[c1];
+
+			if (fabs(a.x - b.x) > CORNER_ATTRIBUTE_EPSILON || fabs(a.y - b.y) > CORNER_ATTRIBUTE_EPSILON)
+				return false;
+		}
+
+		if ((_format & VisualServer::ARRAY_FORMAT_COLOR) != 0) {
+			const Color &a = triangle_colors[c0];
+			const Color &b = triangle_colors[c1];
+
+			if (fabs(a.r - b.r) > CORNER_ATTRIBUTE_EPSILON || fabs(a.g - b.g) > CORNER_ATTRIBUTE_EPSILON || fabs(a.b - b.b) > CORNER_ATTRIBUTE_EPSILON || fabs(a.a - b.a) > CORNER_ATTRIBUTE_EPSILON)
+				return false;
+		}
+
+		return true;
+	}
+
 	FQMS() {
 		_max_iteration_count = 100;
 		_max_lossless_iteration_count = 9990;
@@ -1283,14 +3243,36 @@ public:
 		_preserve_border_dges = false;
 		_preserve_uv_seam_edges = false;
 		_preserve_uv_foldover_edges = false;
+		_enable_collapse_queue = false;
 		_format = 0;
 		_vertex_link_distance = sqrt(DBL_EPSILON);
+		_cluster_count = 1;
+		_use_threads = true;
+		_record_collapses = false;
+		_recording = false;
+		_linked = false;
+		_uv_weight = 0;
+		_uv2_weight = 0;
+		_color_weight = 0;
+		attribute_stride = 0;
+		_error_scale = 1;
+		_max_collapse_error = 0;
 	}
 
 	~FQMS() {
 		triangles.clear();
 		vertices.clear();
 		refs.clear();
+		triangle_normals.clear();
+		triangle_uvs.clear();
+		triangle_uv2s.clear();
+		triangle_colors.clear();
+		collapse_records.clear();
+		vertex_sources.clear();
+		triangle_sources.clear();
+		triangle_removals.clear();
+		attribute_quadrics.clear();
+		attribute_weights.clear();
 	}
 }; // namespace Simplify
 
@@ -0,0 +1,85 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "uv_unwrap_progress.h"
+
+#include "core/os/thread.h"
+
+UVUnwrapProgress::ProgressCategory UVUnwrapProgress::get_category() const {
+	return static_cast<ProgressCategory>(_category.get());
+}
+
+int UVUnwrapProgress::get_progress() const {
+	return _progress.get();
+}
+
+void UVUnwrapProgress::cancel() {
+	_cancelled.set();
+}
+
+bool UVUnwrapProgress::is_cancelled() const {
+	return _cancelled.is_set();
+}
+
+void UVUnwrapProgress::reset() {
+	_category.set(PROGRESS_CATEGORY_ADD_MESH);
+	_progress.set(0);
+	_cancelled.clear();
+}
+
+bool UVUnwrapProgress::report(const ProgressCategory p_category, const int p_progress) {
+	_category.set(p_category);
+	_progress.set(p_progress);
+
+	if (Thread::get_caller_id() == Thread::get_main_id()) {
+		emit_signal("progress_changed", p_category, p_progress);
+	} else {
+		call_deferred("emit_signal", "progress_changed", p_category, p_progress);
+	}
+
+	return !_cancelled.is_set();
+}
+
+UVUnwrapProgress::UVUnwrapProgress() {
+	_category.set(PROGRESS_CATEGORY_ADD_MESH);
+	_progress.set(0);
+}
+
+UVUnwrapProgress::~UVUnwrapProgress() {
+}
+
+void UVUnwrapProgress::_bind_methods() {
+	ADD_SIGNAL(MethodInfo("progress_changed", PropertyInfo(Variant::INT, "category"), PropertyInfo(Variant::INT, "progress")));
+
+	ClassDB::bind_method(D_METHOD("get_category"), &UVUnwrapProgress::get_category);
+	ClassDB::bind_method(D_METHOD("get_progress"), &UVUnwrapProgress::get_progress);
+
+	ClassDB::bind_method(D_METHOD("cancel"), &UVUnwrapProgress::cancel);
+	ClassDB::bind_method(D_METHOD("is_cancelled"), &UVUnwrapProgress::is_cancelled);
+
+	ClassDB::bind_method(D_METHOD("reset"), &UVUnwrapProgress::reset);
+
+	BIND_ENUM_CONSTANT(PROGRESS_CATEGORY_ADD_MESH);
+	BIND_ENUM_CONSTANT(PROGRESS_CATEGORY_COMPUTE_CHARTS);
+	BIND_ENUM_CONSTANT(PROGRESS_CATEGORY_PACK_CHARTS);
+	BIND_ENUM_CONSTANT(PROGRESS_CATEGORY_BUILD_OUTPUT_MESHES);
+}
@@ -0,0 +1,67 @@
+#ifndef UV_UNWRAP_PROGRESS_H
+#define UV_UNWRAP_PROGRESS_H
+
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "core/object/ref_counted.h"
+#include "core/templates/safe_refcount.h"
+
+// Passed to MeshUtils.uv_unwrap() to observe, and cancel an unwrap.
+// The unwrap can run on any thread, progress_changed is always emitted on the main thread.
+class UVUnwrapProgress : public RefCounted {
+	GDCLASS(UVUnwrapProgress, RefCounted);
+
+public:
+	enum ProgressCategory {
+		PROGRESS_CATEGORY_ADD_MESH = 0,
+		PROGRESS_CATEGORY_COMPUTE_CHARTS,
+		PROGRESS_CATEGORY_PACK_CHARTS,
+		PROGRESS_CATEGORY_BUILD_OUTPUT_MESHES,
+	};
+
+	ProgressCategory get_category() const;
+	int get_progress() const;
+
+	void cancel();
+	bool is_cancelled() const;
+
+	void reset();
+
+	//Called by the unwrapper, returns false if the unwrap should stop
+	bool report(const ProgressCategory p_category, const int p_progress);
+
+	UVUnwrapProgress();
+	~UVUnwrapProgress();
+
+protected:
+	static void _bind_methods();
+
+private:
+	SafeNumeric<int> _category;
+	SafeNumeric<int> _progress;
+	SafeFlag _cancelled;
+};
+
+VARIANT_ENUM_CAST(UVUnwrapProgress::ProgressCategory);
+
+#endif
@@ -169,8 +169,11 @@ typedef uint64_t Duration;
 #define XA_PROFILE_END(var) internal::s_profile.var += uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - var##Start).count());
 #define XA_PROFILE_PRINT_AND_RESET(label, var)                                                                                                          \
 	XA_PRINT("%s%.2f seconds (%g ms)\n", label, internal::durationToSeconds(internal::s_profile.var), internal::durationToMs(internal::s_profile.var)); \
+	internal::profileRecord(#var, internal::s_profile.var);                                                                                            \
 	internal::s_profile.var = 0u;
+#ifndef XA_PROFILE_ALLOC
 #define XA_PROFILE_ALLOC 0
+#endif
 
 struct ProfileData {
 #if XA_PROFILE_ALLOC
@@ -234,10 +237,36 @@ static double durationToMs(Duration c) {
 static double durationToSeconds(Duration c) {
 	return (double)c * 0.000001;
 }
+
+// Values reported by XA_PROFILE_PRINT_AND_RESET since the last Create(), see GetLastProfile().
+struct ProfileRecord {
+	const char *name;
+	Duration value;
+};
+
+static const uint32_t kMaxProfileRecords = 64;
+static ProfileRecord s_profileLast[kMaxProfileRecords];
+static uint32_t s_profileLastCount = 0;
+
+static void profileRecord(const char *name, Duration value) {
+	// Some values (alloc) are reported by every phase, sum them.
+	for (uint32_t i = 0; i < s_profileLastCount; i++) {
+		if (strcmp(s_profileLast[i].name, name) == 0) {
+			s_profileLast[i].value += value;
+			return;
+		}
+	}
+	if (s_profileLastCount == kMaxProfileRecords)
+		return;
+	s_profileLast[s_profileLastCount].name = name;
+	s_profileLast[s_profileLastCount].value = value;
+	s_profileLastCount++;
+}
 #else
 #define XA_PROFILE_START(var)
 #define XA_PROFILE_END(var)
 #define XA_PROFILE_PRINT_AND_RESET(label, var)
+#undef XA_PROFILE_ALLOC
 #define XA_PROFILE_ALLOC 0
 #endif
 
@@ -7287,6 +7316,9 @@ struct Context {
 };
 
 Atlas *Create() {
+#if XA_PROFILE
+	internal::s_profileLastCount = 0;
+#endif
 	Context *ctx = XA_NEW(internal::MemTag::Default, Context);
 	memset(&ctx->atlas, 0, sizeof(Atlas));
 	ctx->taskScheduler = XA_NEW(internal::MemTag::Default, internal::TaskScheduler);
@@ -8254,6 +8286,20 @@ void SetProgressCallback(Atlas *atlas, ProgressFunc progressFunc, void *progress
 	ctx->progressUserData = progressUserData;
 }
 
+bool GetLastProfile(ProfileFunc profileFunc, void *profileUserData) {
+#if XA_PROFILE
+	if (profileFunc) {
+		for (uint32_t i = 0; i < internal::s_profileLastCount; i++)
+			profileFunc(internal::s_profileLast[i].name, internal::s_profileLast[i].value, profileUserData);
+	}
+	return true;
+#else
+	XA_UNUSED(profileFunc);
+	XA_UNUSED(profileUserData);
+	return false;
+#endif
+}
+
 void SetAlloc(ReallocFunc reallocFunc, FreeFunc freeFunc) {
 	internal::s_realloc = reallocFunc;
 	internal::s_free = freeFunc;
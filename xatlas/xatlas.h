@@ -241,6 +241,13 @@ typedef bool (*ProgressFunc)(ProgressCategory category, int progress, void *user
 
 void SetProgressCallback(Atlas *atlas, ProgressFunc progressFunc = nullptr, void *progressUserData = nullptr);
 
+// Profiling. Only available if xatlas was built with XA_PROFILE.
+// Called once for every timing recorded since the last Create(), name is the ProfileData member, value is in microseconds.
+typedef void (*ProfileFunc)(const char *name, uint64_t value, void *userData);
+
+// Returns false if profiling is compiled out.
+bool GetLastProfile(ProfileFunc profileFunc, void *profileUserData = nullptr);
+
 // Custom memory allocation.
 typedef void *(*ReallocFunc)(void *, size_t);
 typedef void (*FreeFunc)(void *);
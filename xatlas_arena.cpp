@@ -0,0 +1,303 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "xatlas_arena.h"
+
+#include "core/os/memory.h"
+
+#include "xatlas/xatlas.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+thread_local XatlasArena *XatlasArena::_current = nullptr;
+
+XatlasArena *XatlasArena::Scope::get_arena() const {
+	return _arena;
+}
+
+XatlasArena::Scope::Scope() {
+	_arena = memnew(XatlasArena);
+	_previous = _current;
+	_current = _arena;
+}
+
+XatlasArena::Scope::~Scope() {
+	_current = _previous;
+	_arena->_release();
+}
+
+void XatlasArena::install() {
+	xatlas_mu::SetAlloc(realloc_func, free_func);
+}
+
+void XatlasArena::uninstall() {
+	xatlas_mu::SetAlloc(realloc, free);
+}
+
+void *XatlasArena::realloc_func(void *p_ptr, size_t p_size) {
+	if (p_size == 0) {
+		free_func(p_ptr);
+		return nullptr;
+	}
+
+	if (!p_ptr) {
+		if (_current) {
+			return _current->_allocate(p_size);
+		}
+
+		BlockHeader *h = reinterpret_cast<BlockHeader *>(memalloc(sizeof(BlockHeader) + p_size));
+		ERR_FAIL_COND_V(!h, nullptr);
+
+		h->arena = nullptr;
+		h->size = p_size;
+
+		return h + 1;
+	}
+
+	BlockHeader *h = _get_header(p_ptr);
+
+	if (h->arena) {
+		return h->arena->_reallocate(p_ptr, p_size);
+	}
+
+	h = reinterpret_cast<BlockHeader *>(memrealloc(h, sizeof(BlockHeader) + p_size));
+	ERR_FAIL_COND_V(!h, nullptr);
+
+	h->size = p_size;
+
+	return h + 1;
+}
+
+void XatlasArena::free_func(void *p_ptr) {
+	if (!p_ptr) {
+		return;
+	}
+
+	BlockHeader *h = _get_header(p_ptr);
+
+	if (h->arena) {
+		h->arena->_free(p_ptr);
+		return;
+	}
+
+	memfree(h);
+}
+
+uint64_t XatlasArena::get_allocation_count() const {
+	MutexLock lock(_mutex);
+
+	return _allocation_count;
+}
+
+uint64_t XatlasArena::get_peak_usage() const {
+	MutexLock lock(_mutex);
+
+	return _peak_usage;
+}
+
+void *XatlasArena::_allocate(const uint64_t p_size) {
+	MutexLock lock(_mutex);
+
+	return _allocate_locked(p_size);
+}
+
+void *XatlasArena::_reallocate(void *p_ptr, const uint64_t p_size) {
+	MutexLock lock(_mutex);
+
+	BlockHeader *h = _get_header(p_ptr);
+	uint64_t size = _align(p_size);
+	uint64_t old_size = h->size & ~LARGE_BLOCK_BIT;
+
+	if (h->size & LARGE_BLOCK_BIT) {
+		if (size >= LARGE_BLOCK_SIZE) {
+			h = reinterpret_cast<BlockHeader *>(memrealloc(h, sizeof(BlockHeader) + size));
+			ERR_FAIL_COND_V(!h, nullptr);
+
+			_large_used = _large_used - old_size + size;
+			h->size = size | LARGE_BLOCK_BIT;
+			_update_peak();
+
+			return h + 1;
+		}
+	} else {
+		if (size <= old_size) {
+			return p_ptr;
+		}
+
+		// Growing the last block of the chunk is the common case for arrays that get pushed into
+		if (size < LARGE_BLOCK_SIZE && _is_top_block(h) && _chunk->used + (size - old_size) <= _chunk->size) {
+			_chunk->used += size - old_size;
+			h->size = size;
+
+			return p_ptr;
+		}
+	}
+
+	void *mem = _allocate_locked(size);
+	ERR_FAIL_COND_V(!mem, nullptr);
+
+	memcpy(mem, p_ptr, MIN(old_size, size));
+	_free_locked(p_ptr);
+
+	return mem;
+}
+
+void XatlasArena::_free(void *p_ptr) {
+	bool destroy;
+
+	{
+		MutexLock lock(_mutex);
+
+		_free_locked(p_ptr);
+
+		destroy = _released && _live_count == 0;
+	}
+
+	if (destroy) {
+		memdelete(this);
+	}
+}
+
+// The Scope is done with the arena. If blocks are still alive (something outlived
+// xatlas_mu::Destroy()), the last free deletes it instead.
+void XatlasArena::_release() {
+	bool destroy;
+
+	{
+		MutexLock lock(_mutex);
+
+		_released = true;
+
+		destroy = _live_count == 0;
+	}
+
+	if (destroy) {
+		memdelete(this);
+	}
+}
+
+void *XatlasArena::_allocate_locked(const uint64_t p_size) {
+	uint64_t size = _align(p_size);
+
+	if (size >= LARGE_BLOCK_SIZE) {
+		BlockHeader *h = reinterpret_cast<BlockHeader *>(memalloc(sizeof(BlockHeader) + size));
+		ERR_FAIL_COND_V(!h, nullptr);
+
+		h->arena = this;
+		h->size = size | LARGE_BLOCK_BIT;
+
+		++_live_count;
+		++_allocation_count;
+		_large_used += size;
+		_update_peak();
+
+		return h + 1;
+	}
+
+	uint64_t needed = sizeof(BlockHeader) + size;
+
+	if (!_chunk || _chunk->used + needed > _chunk->size) {
+		_add_chunk(needed);
+	}
+
+	BlockHeader *h = reinterpret_cast<BlockHeader *>(_get_chunk_data(_chunk) + _chunk->used);
+	_chunk->used += needed;
+
+	h->arena = this;
+	h->size = size;
+
+	++_live_count;
+	++_allocation_count;
+
+	return h + 1;
+}
+
+void XatlasArena::_free_locked(void *p_ptr) {
+	BlockHeader *h = _get_header(p_ptr);
+
+	--_live_count;
+
+	if (h->size & LARGE_BLOCK_BIT) {
+		_large_used -= h->size & ~LARGE_BLOCK_BIT;
+		memfree(h);
+		return;
+	}
+
+	// Only the last block can be given back, everything else is freed with the arena
+	if (_is_top_block(h)) {
+		_chunk->used -= sizeof(BlockHeader) + h->size;
+	}
+}
+
+void XatlasArena::_add_chunk(const uint64_t p_min_size) {
+	uint64_t size = MAX(_next_chunk_size, p_min_size);
+
+	Chunk *chunk = reinterpret_cast<Chunk *>(memalloc(sizeof(Chunk) + size));
+	ERR_FAIL_COND(!chunk);
+
+	chunk->next = _chunk;
+	chunk->size = size;
+	chunk->used = 0;
+
+	_chunk = chunk;
+	_next_chunk_size = MIN(_next_chunk_size * 2, MAX_CHUNK_SIZE);
+
+	_reserved += size;
+	_update_peak();
+}
+
+bool XatlasArena::_is_top_block(BlockHeader *p_header) const {
+	if (!_chunk) {
+		return false;
+	}
+
+	return reinterpret_cast<uint8_t *>(p_header + 1) + p_header->size == _get_chunk_data(_chunk) + _chunk->used;
+}
+
+void XatlasArena::_update_peak() {
+	uint64_t usage = _reserved + _large_used;
+
+	if (usage > _peak_usage) {
+		_peak_usage = usage;
+	}
+}
+
+XatlasArena::XatlasArena() {
+	_chunk = nullptr;
+	_next_chunk_size = MIN_CHUNK_SIZE;
+
+	_live_count = 0;
+	_allocation_count = 0;
+	_reserved = 0;
+	_large_used = 0;
+	_peak_usage = 0;
+	_released = false;
+}
+
+XatlasArena::~XatlasArena() {
+	while (_chunk) {
+		Chunk *next = _chunk->next;
+		memfree(_chunk);
+		_chunk = next;
+	}
+}
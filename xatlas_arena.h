@@ -0,0 +1,119 @@
+#ifndef XATLAS_ARENA_H
+#define XATLAS_ARENA_H
+
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "core/os/mutex.h"
+#include "core/typedefs.h"
+
+// Bump allocator for xatlas_mu.
+// install() routes every xatlas allocation through realloc_func / free_func.
+// While a Scope is alive, allocations made on its thread come from its arena,
+// everything else goes to the heap. Every block remembers where it came from,
+// so it can be reallocated / freed from any thread.
+// Arena memory is given back in one go, when the Scope ends (after xatlas_mu::Destroy()).
+class XatlasArena {
+public:
+	class Scope {
+	public:
+		XatlasArena *get_arena() const;
+
+		Scope();
+		~Scope();
+
+	private:
+		XatlasArena *_arena;
+		XatlasArena *_previous;
+	};
+
+	static void install();
+	static void uninstall();
+
+	static void *realloc_func(void *p_ptr, size_t p_size);
+	static void free_func(void *p_ptr);
+
+	uint64_t get_allocation_count() const;
+	uint64_t get_peak_usage() const;
+
+	XatlasArena();
+	~XatlasArena();
+
+private:
+	struct BlockHeader {
+		XatlasArena *arena;
+		uint64_t size;
+	};
+
+	struct Chunk {
+		Chunk *next;
+		uint64_t size;
+		uint64_t used;
+		uint64_t padding;
+	};
+
+	static const uint64_t ALIGNMENT = 16;
+	static const uint64_t LARGE_BLOCK_BIT = uint64_t(1) << 63;
+	// Allocations this big get their own heap block, so they can be given back right away
+	static const uint64_t LARGE_BLOCK_SIZE = 64 * 1024;
+	static const uint64_t MIN_CHUNK_SIZE = 256 * 1024;
+	static const uint64_t MAX_CHUNK_SIZE = 8 * 1024 * 1024;
+
+	static _FORCE_INLINE_ uint64_t _align(const uint64_t p_size) {
+		return (p_size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+	}
+
+	static _FORCE_INLINE_ BlockHeader *_get_header(void *p_ptr) {
+		return reinterpret_cast<BlockHeader *>(p_ptr) - 1;
+	}
+
+	static _FORCE_INLINE_ uint8_t *_get_chunk_data(Chunk *p_chunk) {
+		return reinterpret_cast<uint8_t *>(p_chunk + 1);
+	}
+
+	void *_allocate(const uint64_t p_size);
+	void *_reallocate(void *p_ptr, const uint64_t p_size);
+	void _free(void *p_ptr);
+	void _release();
+
+	void *_allocate_locked(const uint64_t p_size);
+	void _free_locked(void *p_ptr);
+	void _add_chunk(const uint64_t p_min_size);
+	bool _is_top_block(BlockHeader *p_header) const;
+	void _update_peak();
+
+	static thread_local XatlasArena *_current;
+
+	mutable Mutex _mutex;
+
+	Chunk *_chunk;
+	uint64_t _next_chunk_size;
+
+	uint64_t _live_count;
+	uint64_t _allocation_count;
+	uint64_t _reserved;
+	uint64_t _large_used;
+	uint64_t _peak_usage;
+	bool _released;
+};
+
+#endif